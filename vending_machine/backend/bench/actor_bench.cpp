@@ -0,0 +1,197 @@
+// Compares request latency of the direct-call model, where client threads
+// call into shared machines and meet on their locks, with the actor model,
+// where each machine's commands run one at a time on an Executor worker.
+// Clients hammer a small set of hot machines; each request inserts money
+// and buys one item. Reports p50/p99/p999/max per mode and exits non-zero
+// if stock, revenue and purchases disagree afterwards.
+//
+// Then the same comparison against one journaled machine, as the server's
+// default machine runs with VENDING_DATA_DIR set: every request waits for
+// its records to reach disk, so throughput depends on how many requests
+// share each group commit.
+#include "fleet.hpp"
+#include "executor.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kMachines = 16;
+constexpr int kClients = 8;
+constexpr int kRequestsPerClient = 20000;
+constexpr int kStock = 1000000;
+constexpr int kJournaledRequestsPerClient = 500;
+constexpr const char* kJournalPath = "actor_bench.journal";
+
+const Item kCatalog[] = {
+    Item::beverage("Coke", Money::fromCents(150), kStock, 330),
+    Item::beverage("Water", Money::fromCents(100), kStock, 500),
+    Item::snack("Chips", Money::fromCents(180), kStock, 50),
+    Item::snack("Candy", Money::fromCents(100), kStock, 30),
+};
+
+// Runs one request on `machine`; true if the item was bought.
+bool buy(VendingMachine& machine, const std::string& session, const Item& item) {
+    machine.insertMoney(session, item.price);
+    if (machine.purchaseItem(session, item.name)) {
+        return true;
+    }
+    machine.returnChange(session);
+    return false;
+}
+
+bool run(const char* mode, Executor* executor) {
+    Fleet fleet(FleetOptions(), executor);
+    for (std::size_t m = 0; m < kMachines; ++m) {
+        VendingMachine& machine = fleet.addMachine(std::to_string(m));
+        for (const Item& item : kCatalog) {
+            machine.addItem(item);
+        }
+    }
+
+    std::vector<std::vector<double>> latencies(kClients);
+    std::atomic<long> purchased{0};
+    std::atomic<std::int64_t> spentCents{0};
+    std::vector<std::thread> clients;
+    const auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < kClients; ++c) {
+        clients.emplace_back([&, c]() {
+            std::mt19937 rng(static_cast<unsigned>(c) * 7919u + 1);
+            std::uniform_int_distribution<std::size_t> pickMachine(0, kMachines - 1);
+            std::uniform_int_distribution<std::size_t> pickItem(0, std::size(kCatalog) - 1);
+            const std::string session = "bench-" + std::to_string(c);
+            std::vector<double>& samples = latencies[c];
+            samples.reserve(kRequestsPerClient);
+            long local = 0;
+            std::int64_t localCents = 0;
+            for (int i = 0; i < kRequestsPerClient; ++i) {
+                MachineHandle machine = *fleet.handle(std::to_string(pickMachine(rng)));
+                const Item& item = kCatalog[pickItem(rng)];
+                const auto begin = std::chrono::steady_clock::now();
+                const bool bought = machine.call([&](VendingMachine& m) { return buy(m, session, item); });
+                samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+                if (bought) {
+                    ++local;
+                    localCents += item.price.toCents();
+                }
+            }
+            purchased.fetch_add(local);
+            spentCents.fetch_add(localCents);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    for (const auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all[static_cast<std::size_t>(p * (all.size() - 1))]; };
+    std::printf("%-6s requests/s=%.0f p50=%.1f us p99=%.1f us p999=%.1f us max=%.1f us\n", mode,
+                all.size() / elapsed.count(), percentile(0.50), percentile(0.99), percentile(0.999), all.back());
+
+    long sold = 0;
+    std::int64_t revenueCents = 0;
+    fleet.forEach([&](const std::string&, const VendingMachine& machine) {
+        machine.visitItems([&sold](const ItemView& item) { sold += kStock - item.quantity; });
+        revenueCents += machine.getTotalRevenue().toCents();
+    });
+    const bool ok = sold == purchased.load() && revenueCents == spentCents.load();
+    if (!ok) {
+        std::printf("%-6s sold=%ld purchased=%ld -> MISMATCH\n", mode, sold, purchased.load());
+    }
+    return ok;
+}
+
+bool runJournaled(const char* mode, Executor* executor) {
+    std::remove(kJournalPath);
+    JournalOptions options;
+    options.path = kJournalPath;
+    auto owned = std::make_unique<Journal>(options);
+    Journal& journal = *owned;
+    Fleet fleet(FleetOptions(), executor);
+    VendingMachine& machine = fleet.addMachine(
+        "default", std::make_unique<VendingMachine>(std::make_unique<CashPayment>(), std::make_unique<Inventory>(),
+                                                    std::make_unique<TransactionLog>(), std::move(owned)));
+    for (const Item& item : kCatalog) {
+        machine.addItem(item);
+    }
+    const std::uint64_t batchesBefore = journal.batchesWritten();
+    const std::uint64_t lsnBefore = journal.durableLsn();
+
+    std::vector<std::vector<double>> latencies(kClients);
+    std::atomic<long> purchased{0};
+    std::vector<std::thread> clients;
+    const auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < kClients; ++c) {
+        clients.emplace_back([&, c]() {
+            MachineHandle handle = *fleet.handle("default");
+            const std::string session = "bench-" + std::to_string(c);
+            const Item& item = kCatalog[static_cast<std::size_t>(c) % std::size(kCatalog)];
+            long local = 0;
+            for (int i = 0; i < kJournaledRequestsPerClient; ++i) {
+                const auto begin = std::chrono::steady_clock::now();
+                local += handle.call([&](VendingMachine& m) { return buy(m, session, item); });
+                latencies[c].push_back(
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+            }
+            purchased.fetch_add(local);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const std::uint64_t batches = journal.batchesWritten() - batchesBefore;
+    const std::uint64_t records = journal.durableLsn() - lsnBefore;
+
+    std::vector<double> all;
+    for (const auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all[static_cast<std::size_t>(p * (all.size() - 1))]; };
+    std::printf("%-6s requests/s=%.0f batches=%llu records/batch=%.1f p50=%.1f us p99=%.1f us\n", mode,
+                all.size() / elapsed.count(), static_cast<unsigned long long>(batches),
+                batches ? static_cast<double>(records) / batches : 0.0, percentile(0.50), percentile(0.99));
+
+    long sold = 0;
+    machine.visitItems([&sold](const ItemView& item) { sold += kStock - item.quantity; });
+    const bool ok = sold == purchased.load() && machine.getTransactionCount() == static_cast<std::uint64_t>(sold);
+    if (!ok) {
+        std::printf("%-6s sold=%ld purchased=%ld -> MISMATCH\n", mode, sold, purchased.load());
+    }
+    std::remove(kJournalPath);
+    return ok;
+}
+
+}  // namespace
+
+int main() {
+    bool ok = run("direct", nullptr);
+    {
+        Executor executor;
+        ok = run("actor", &executor) && ok;
+        std::printf("actor  workers=%zu steals=%llu\n", executor.threadCount(),
+                    static_cast<unsigned long long>(executor.steals()));
+    }
+    std::printf("\njournaled machine, %d clients\n", kClients);
+    ok = runJournaled("direct", nullptr) && ok;
+    {
+        Executor executor;
+        ok = runJournaled("actor", &executor) && ok;
+    }
+    std::printf("%s\n", ok ? "balanced" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Full-catalog scans over the structure-of-arrays Inventory against the
+// previous layout of heap-allocated IItem objects behind virtual getters, at
+// 10k and 1M SKUs. Exits non-zero if the two disagree.
+#include "inventory.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The previous item model: one heap object per item, read through virtual
+// calls, with the type reported as a string.
+class IItem {
+public:
+    virtual ~IItem() = default;
+    virtual std::string getName() const = 0;
+    virtual Money getPrice() const = 0;
+    virtual int getQuantity() const = 0;
+    virtual std::string getType() const = 0;
+};
+
+class BaseItem : public IItem {
+public:
+    BaseItem(const std::string& name, Money price, int quantity) : name(name), price(price), quantity(quantity) {}
+    std::string getName() const override { return name; }
+    Money getPrice() const override { return price; }
+    int getQuantity() const override { return quantity; }
+
+private:
+    std::string name;
+    Money price;
+    int quantity;
+};
+
+class Beverage : public BaseItem {
+public:
+    Beverage(const std::string& name, Money price, int quantity, int volume)
+        : BaseItem(name, price, quantity), volume(volume) {}
+    std::string getType() const override { return "Beverage"; }
+
+private:
+    int volume;
+};
+
+class Snack : public BaseItem {
+public:
+    Snack(const std::string& name, Money price, int quantity, int weight)
+        : BaseItem(name, price, quantity), weight(weight) {}
+    std::string getType() const override { return "Snack"; }
+
+private:
+    int weight;
+};
+
+template <typename Scan>
+double bestOfMs(Scan&& scan) {
+    double best = 1e300;
+    for (int round = 0; round < 5; ++round) {
+        auto begin = std::chrono::steady_clock::now();
+        scan();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}  // namespace
+
+int main() {
+    bool ok = true;
+    std::printf("%9s %16s %16s %16s\n", "skus", "virtual value ms", "soa value ms", "soa visit ms");
+    for (std::size_t skus : {std::size_t(10000), std::size_t(1000000)}) {
+        std::vector<std::unique_ptr<IItem>> objects;
+        Inventory inventory;
+        objects.reserve(skus);
+        for (std::size_t i = 0; i < skus; ++i) {
+            const std::string name = "sku-" + std::to_string(i);
+            const Money price = Money::fromCents(100 + static_cast<std::int64_t>(i % 200));
+            const int quantity = static_cast<int>(i % 40);
+            if (i % 2 == 0) {
+                objects.push_back(std::make_unique<Beverage>(name, price, quantity, 330));
+                inventory.addItem(Item::beverage(name, price, quantity, 330));
+            } else {
+                objects.push_back(std::make_unique<Snack>(name, price, quantity, 50));
+                inventory.addItem(Item::snack(name, price, quantity, 50));
+            }
+        }
+
+        // Stock value of beverages: the kind of question analytics asks.
+        std::int64_t virtualCents = 0;
+        const double virtualMs = bestOfMs([&]() {
+            virtualCents = 0;
+            for (const auto& item : objects) {
+                if (item->getType() == "Beverage") {
+                    virtualCents += item->getQuantity() * item->getPrice().toCents();
+                }
+            }
+        });
+        std::int64_t soaCents = 0;
+        const double soaMs = bestOfMs([&]() {
+            soaCents = inventory.stockByType()[static_cast<std::size_t>(ItemType::Beverage)].value.toCents();
+        });
+        std::int64_t visitedUnits = 0;
+        const double visitMs = bestOfMs([&]() {
+            visitedUnits = 0;
+            inventory.visit([&visitedUnits](const ItemView& item) { visitedUnits += item.quantity; });
+        });
+
+        std::printf("%9zu %16.2f %16.2f %16.2f\n", skus, virtualMs, soaMs, visitMs);
+        const auto stock = inventory.stockByType();
+        const std::int64_t units = stock[static_cast<std::size_t>(ItemType::Beverage)].units +
+                                   stock[static_cast<std::size_t>(ItemType::Snack)].units;
+        if (virtualCents != soaCents || visitedUnits != units) {
+            std::printf("FAIL: scans disagree at %zu SKUs\n", skus);
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
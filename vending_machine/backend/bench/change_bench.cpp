@@ -0,0 +1,115 @@
+// Measures change computation with the standard denominations: millions of
+// requests served from the precomputed table, then requests whose table
+// row the coin stock cannot cover, which fall back to the bounded search.
+// Both paths are first checked against the bounded search on random amounts
+// and stock; exits non-zero if any answer is wrong or uses more coins.
+#include "change_maker.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kRequests = 5000000;
+constexpr int kFallbackRequests = 20000;
+constexpr int kChecks = 2000;
+
+int coinsUsed(const std::vector<int>& counts) {
+    int total = 0;
+    for (int count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+// True if `counts` pays exactly `cents` within `stock`.
+bool pays(const ChangeMaker& maker, std::int64_t cents, const std::vector<int>& stock, const std::vector<int>& counts) {
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] < 0 || counts[i] > stock[i]) {
+            return false;
+        }
+        sum += counts[i] * maker.denomination(i).toCents();
+    }
+    return sum == cents;
+}
+
+}  // namespace
+
+int main() {
+    const ChangeMaker& maker = ChangeMaker::standard();
+    const std::size_t d = maker.denominationCount();
+    std::mt19937 rng(42);
+    std::vector<int> stock(d);
+    std::vector<int> fast(d);
+    std::vector<int> exact(d);
+
+    // Random stock, often short of some denominations, so both paths run.
+    int mismatches = 0;
+    std::uniform_int_distribution<std::int64_t> smallAmount(0, 5000);
+    std::uniform_int_distribution<int> stockDraw(0, 6);
+    for (int i = 0; i < kChecks; ++i) {
+        for (auto& count : stock) {
+            count = stockDraw(rng);
+        }
+        const std::int64_t cents = smallAmount(rng);
+        const bool fastOk = maker.makeChange(cents, stock.data(), fast.data());
+        const bool exactOk = maker.searchChange(cents, stock.data(), exact.data());
+        if (fastOk != exactOk || (fastOk && (!pays(maker, cents, stock, fast) ||
+                                             coinsUsed(fast) != coinsUsed(exact)))) {
+            ++mismatches;
+        }
+    }
+    std::printf("checked=%d mismatches=%d\n", kChecks, mismatches);
+
+    // Ample stock: every request is one table row.
+    std::fill(stock.begin(), stock.end(), 1 << 20);
+    std::uniform_int_distribution<std::int64_t> amount(0, 5000);
+    std::vector<std::int64_t> amounts(1 << 16);
+    for (auto& cents : amounts) {
+        cents = amount(rng);
+    }
+    long coins = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRequests; ++i) {
+        maker.makeChange(amounts[i & (amounts.size() - 1)], stock.data(), fast.data());
+        coins += fast[0];
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("table path:    requests=%d ns/request=%.1f (checksum %ld)\n", kRequests,
+                elapsed.count() / kRequests, coins);
+
+    // No quarters or dimes left: most rows cannot be covered.
+    stock[2] = 0;
+    stock[3] = 0;
+    start = std::chrono::steady_clock::now();
+    int failed = 0;
+    for (int i = 0; i < kFallbackRequests; ++i) {
+        failed += !maker.makeChange(amounts[i & (amounts.size() - 1)], stock.data(), fast.data());
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("search path:   requests=%d ns/request=%.1f failed=%d\n", kFallbackRequests,
+                elapsed.count() / kFallbackRequests, failed);
+
+    // A machine paying out and taking in through its coin inventory; the
+    // amount goes in as the fewest coins that make it up.
+    CoinInventory inventory(50);
+    std::vector<int> pieces(maker.denominationCount());
+    start = std::chrono::steady_clock::now();
+    int refused = 0;
+    for (int i = 0; i < kRequests / 10; ++i) {
+        const std::int64_t cents = amounts[i & (amounts.size() - 1)] % 2000;
+        maker.split(cents, pieces.data());
+        for (std::size_t j = 0; j < pieces.size(); ++j) {
+            for (int piece = 0; piece < pieces[j]; ++piece) {
+                inventory.deposit(maker.denomination(j));
+            }
+        }
+        refused += !inventory.dispense(Money::fromCents(cents));
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("coin inventory: deposit+dispense=%d ns/pair=%.1f refused=%d\n", kRequests / 10,
+                elapsed.count() / (kRequests / 10), refused);
+    return mismatches == 0 && failed == 0 && refused == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Hosts 100k machines with the default 12-item catalog in one Fleet, reports
+// resident memory per machine, then runs purchases spread over random
+// machines from several threads and reports aggregate throughput. Exits
+// non-zero if stock, revenue and purchases disagree afterwards.
+#include "fleet.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::size_t kMachines = 100000;
+constexpr int kThreads = 8;
+constexpr int kPurchasesPerThread = 200000;
+
+const Item kCatalog[] = {
+    Item::beverage("Coke", Money::fromCents(150), 10, 330),
+    Item::beverage("Pepsi", Money::fromCents(120), 8, 330),
+    Item::beverage("Water", Money::fromCents(100), 15, 500),
+    Item::snack("Chips", Money::fromCents(180), 12, 50),
+    Item::snack("Candy", Money::fromCents(100), 20, 30),
+    Item::beverage("Sprite", Money::fromCents(150), 10, 330),
+    Item::beverage("Fanta", Money::fromCents(150), 10, 330),
+    Item::beverage("Mountain Dew", Money::fromCents(120), 8, 330),
+    Item::snack("Doritos", Money::fromCents(180), 12, 50),
+    Item::snack("Snickers", Money::fromCents(120), 15, 45),
+    Item::snack("Twix", Money::fromCents(120), 15, 45),
+    Item::snack("KitKat", Money::fromCents(120), 15, 45),
+};
+
+// Resident set size in bytes, or 0 where it cannot be read.
+std::size_t residentBytes() {
+#ifdef __linux__
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    const int read = std::fscanf(statm, "%lu %lu", &pages, &resident);
+    std::fclose(statm);
+    return read == 2 ? resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+}  // namespace
+
+int main() {
+    const std::size_t before = residentBytes();
+    auto start = std::chrono::steady_clock::now();
+    Fleet fleet;
+    int stockUnits = 0;
+    for (const Item& item : kCatalog) {
+        stockUnits += item.quantity;
+    }
+    for (std::size_t m = 0; m < kMachines; ++m) {
+        VendingMachine& machine = fleet.addMachine(std::to_string(m));
+        for (const Item& item : kCatalog) {
+            machine.addItem(item);
+        }
+    }
+    std::chrono::duration<double, std::milli> setup = std::chrono::steady_clock::now() - start;
+    const std::size_t after = residentBytes();
+    std::printf("machines=%zu setup=%.0f ms rss=%.1f MiB bytes/machine=%.0f\n", fleet.size(), setup.count(),
+                (after - before) / 1048576.0, static_cast<double>(after - before) / kMachines);
+
+    // Every thread buys from random machines, with its own session per
+    // machine so balances stay per thread.
+    std::atomic<long> purchased{0};
+    std::atomic<std::int64_t> spentCents{0};
+    std::vector<std::thread> workers;
+    start = std::chrono::steady_clock::now();
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&fleet, &purchased, &spentCents, t]() {
+            std::mt19937 rng(static_cast<unsigned>(t) * 7919u + 1);
+            std::uniform_int_distribution<std::size_t> pickMachine(0, kMachines - 1);
+            std::uniform_int_distribution<std::size_t> pickItem(0, std::size(kCatalog) - 1);
+            const std::string session = "bench-" + std::to_string(t);
+            long local = 0;
+            std::int64_t localCents = 0;
+            for (int i = 0; i < kPurchasesPerThread; ++i) {
+                VendingMachine* machine = fleet.find(std::to_string(pickMachine(rng)));
+                const Item& item = kCatalog[pickItem(rng)];
+                machine->insertMoney(session, item.price);
+                if (machine->purchaseItem(session, item.name)) {
+                    ++local;
+                    localCents += item.price.toCents();
+                } else {
+                    machine->returnChange(session);
+                }
+            }
+            purchased.fetch_add(local);
+            spentCents.fetch_add(localCents);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("threads=%d purchases=%ld purchases/s=%.0f\n", kThreads, purchased.load(),
+                kThreads * kPurchasesPerThread / elapsed.count());
+
+    long sold = 0;
+    std::int64_t revenueCents = 0;
+    fleet.forEach([&](const std::string&, const VendingMachine& machine) {
+        long units = 0;
+        machine.visitItems([&units](const ItemView& item) { units += item.quantity; });
+        sold += stockUnits - units;
+        revenueCents += machine.getTotalRevenue().toCents();
+    });
+    const bool ok = sold == purchased.load() && revenueCents == spentCents.load();
+    std::printf("sold=%ld revenue=%.2f -> %s\n", sold, revenueCents / 100.0, ok ? "balanced" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// Memory per transaction of the columnar history, and the cost of paging
+// through it against copying the whole history out. Exits non-zero if the
+// history takes 16 bytes or more per transaction or retention loses totals.
+#include "transaction.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kTransactions = 5000000;
+const char* const kItems[] = {"Coke", "Pepsi", "Water", "Chips", "Candy", "Sprite",
+                              "Fanta", "Mountain Dew", "Doritos", "Snickers", "Twix", "KitKat"};
+
+// Purchases arrive a few seconds apart, in bursts within the same second.
+void fill(TransactionLog& log, std::size_t count, std::int64_t& expectedCents) {
+    std::time_t now = 1700000000;
+    for (std::size_t i = 0; i < count; ++i) {
+        now += static_cast<std::time_t>(i % 7 == 0 ? 3 : 0);
+        const std::int64_t cents = 100 + static_cast<std::int64_t>(i % 5) * 10;
+        log.logTransaction(kItems[i % 12], Money::fromCents(cents), now);
+        expectedCents += cents;
+    }
+}
+
+double msSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    TransactionLog log;
+    std::int64_t expectedCents = 0;
+    fill(log, kTransactions, expectedCents);
+
+    const double bytesPerTransaction = static_cast<double>(log.memoryUsage()) / log.retainedCount();
+    // What the previous vector of {name, price, timestamp} needed, before
+    // heap name copies.
+    const std::size_t rowBytes = sizeof(std::string) + sizeof(Money) + sizeof(std::time_t);
+    std::printf("transactions:         %zu\n", log.retainedCount());
+    std::printf("bytes/transaction:    %.2f (was %zu)\n", bytesPerTransaction, rowBytes);
+    if (bytesPerTransaction >= 16.0) {
+        std::printf("FAIL: history should take under 16 bytes per transaction\n");
+        ok = false;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::size_t pages = 0;
+    std::int64_t seenCents = 0;
+    for (std::size_t offset = kTransactions / 2; pages < 1000; offset += 100, ++pages) {
+        log.visit(offset, 100, [&seenCents](const TransactionView& t) { seenCents += t.price.toCents(); });
+    }
+    std::printf("page of 100 (mid):    %.3f ms\n", msSince(begin) / pages);
+
+    begin = std::chrono::steady_clock::now();
+    std::vector<Transaction> copy = log.getHistory();
+    std::printf("full getHistory copy: %.1f ms\n", msSince(begin));
+
+    if (log.totalRevenue().toCents() != expectedCents || copy.size() != kTransactions || seenCents == 0) {
+        std::printf("FAIL: history lost transactions\n");
+        ok = false;
+    }
+
+    // Bounded retention keeps memory flat while the totals stay exact.
+    TransactionLogOptions options;
+    options.retention = 100000;
+    TransactionLog bounded(options);
+    std::int64_t boundedCents = 0;
+    fill(bounded, kTransactions, boundedCents);
+    std::printf("retained (bounded):   %zu of %llu, %zu bytes\n", bounded.retainedCount(),
+                static_cast<unsigned long long>(bounded.transactionCount()), bounded.memoryUsage());
+    if (bounded.transactionCount() != kTransactions || bounded.totalRevenue().toCents() != boundedCents ||
+        bounded.retainedCount() < options.retention ||
+        bounded.retainedCount() >= options.retention + 2 * 4096) {
+        std::printf("FAIL: retention did not bound the history or lost totals\n");
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+// Measures stock reservations. First the timer wheel alone against an
+// ordered set (what a deadline-sorted index would cost) at up to four
+// million timers: scheduling, cancelling half, then firing the rest. Then
+// a fleet holding a million reservations across a thousand machines:
+// reserving, confirming and cancelling some, a sweep with nothing due, and
+// the expiry of everything left, with the memory the holds took. Exits
+// non-zero if a timer fires early, late or twice, or if expiry does not
+// return every held unit to stock.
+#include "fleet.hpp"
+#include "timer_wheel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int kMachines = 1000;
+constexpr int kHoldsPerMachine = 1000;
+constexpr int kItemsPerMachine = 16;
+
+struct BenchTimer : TimerWheel::Timer {
+    std::uint64_t firedAt = 0;
+    int fired = 0;
+};
+
+template <typename Op>
+double nsPer(std::size_t count, Op op) {
+    const auto start = std::chrono::steady_clock::now();
+    op();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(count);
+}
+
+// Resident set size in bytes, or zero where /proc is missing.
+std::size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0;
+    std::size_t resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * 4096;
+}
+
+int benchWheel(std::size_t count) {
+    std::mt19937_64 rng(count);
+    // Up to twenty minutes at the machines' 10 ms tick.
+    std::uniform_int_distribution<std::uint64_t> expiryDist(1, 120000);
+    std::vector<std::uint64_t> expiries(count);
+    for (auto& expiry : expiries) {
+        expiry = expiryDist(rng);
+    }
+
+    TimerWheel wheel;
+    std::vector<BenchTimer> timers(count);
+    const double schedule = nsPer(count, [&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            wheel.schedule(timers[i], expiries[i]);
+        }
+    });
+    const double cancel = nsPer(count / 2, [&] {
+        for (std::size_t i = 0; i < count; i += 2) {
+            wheel.cancel(timers[i]);
+        }
+    });
+    // Advanced in 100 ms steps, as the server's sweep does.
+    std::uint64_t now = 0;
+    const double fire = nsPer(count - count / 2, [&] {
+        while (wheel.size() > 0) {
+            now += 10;
+            wheel.advance(now, [now](TimerWheel::Timer& timer) {
+                auto& fired = static_cast<BenchTimer&>(timer);
+                fired.firedAt = now;
+                ++fired.fired;
+            });
+        }
+    });
+
+    std::set<std::pair<std::uint64_t, std::size_t>> ordered;
+    const double setSchedule = nsPer(count, [&] {
+        for (std::size_t i = 0; i < count; ++i) {
+            ordered.emplace(expiries[i], i);
+        }
+    });
+    const double setCancel = nsPer(count / 2, [&] {
+        for (std::size_t i = 0; i < count; i += 2) {
+            ordered.erase({expiries[i], i});
+        }
+    });
+
+    std::size_t wrong = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const BenchTimer& timer = timers[i];
+        const bool cancelled = i % 2 == 0;
+        // Fired by the first step reaching its expiry, exactly once.
+        if (cancelled ? timer.fired != 0
+                      : timer.fired != 1 || timer.firedAt < expiries[i] || timer.firedAt >= expiries[i] + 10) {
+            ++wrong;
+        }
+    }
+    std::printf("%-10zu %12.1f %12.1f %12.1f %14.1f %14.1f\n", count, schedule, cancel, fire, setSchedule,
+                setCancel);
+    if (wrong > 0) {
+        std::printf("  %zu timers fired wrongly\n", wrong);
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    std::printf("%-10s %12s %12s %12s %14s %14s\n", "timers", "schedule ns", "cancel ns", "fire ns",
+                "set insert ns", "set erase ns");
+    for (std::size_t count : {std::size_t(100000), std::size_t(1000000), std::size_t(4000000)}) {
+        failures += benchWheel(count);
+    }
+
+    Fleet fleet;
+    std::vector<VendingMachine*> machines;
+    for (int m = 0; m < kMachines; ++m) {
+        VendingMachine& machine = fleet.addMachine(std::to_string(m));
+        for (int i = 0; i < kItemsPerMachine; ++i) {
+            machine.addItem(Item::snack("item-" + std::to_string(i), Money::fromCents(100), 1000000, 50));
+        }
+        machine.insertMoney("customer", Money::fromCents(1000000));
+        machines.push_back(&machine);
+    }
+    const std::size_t holds = static_cast<std::size_t>(kMachines) * kHoldsPerMachine;
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<std::uint64_t>> ids(kMachines);
+    const std::size_t before = residentBytes();
+    std::size_t refused = 0;
+    const double reserve = nsPer(holds, [&] {
+        for (int h = 0; h < kHoldsPerMachine; ++h) {
+            for (int m = 0; m < kMachines; ++m) {
+                // TTLs between one and ten minutes.
+                const auto ttl = std::chrono::seconds(60 + (h * 7 + m) % 540);
+                const std::uint64_t id = machines[m]->reserveItem(
+                    "customer", "item-" + std::to_string(h % kItemsPerMachine), 1, ttl, start);
+                refused += id == 0;
+                ids[m].push_back(id);
+            }
+        }
+    });
+    const std::size_t after = residentBytes();
+
+    // A tenth of the holds is bought and another tenth given up.
+    std::size_t declined = 0;
+    const double confirm = nsPer(holds / 10, [&] {
+        for (int m = 0; m < kMachines; ++m) {
+            for (int h = 0; h < kHoldsPerMachine; h += 10) {
+                declined += !machines[m]->confirmHold("customer", ids[m][h], start);
+            }
+        }
+    });
+    std::size_t unknown = 0;
+    const double cancel = nsPer(holds / 10, [&] {
+        for (int m = 0; m < kMachines; ++m) {
+            for (int h = 5; h < kHoldsPerMachine; h += 10) {
+                unknown += !machines[m]->cancelHold("customer", ids[m][h], start);
+            }
+        }
+    });
+    // Half a minute in, nothing expires but the wheels move holds down a
+    // level; swept again at once, no wheel has anything to do.
+    auto sweep = [&](std::chrono::steady_clock::time_point now) {
+        return nsPer(kMachines, [&] {
+            fleet.forEach([&](const std::string&, VendingMachine& machine) { machine.expireHolds(now); });
+        });
+    };
+    const double movingSweep = sweep(start + std::chrono::seconds(30));
+    const double idleSweep = sweep(start + std::chrono::seconds(30));
+    const double expire = nsPer(holds - holds / 5, [&] {
+        for (int minute = 1; minute <= 11; ++minute) {
+            fleet.forEach([&](const std::string&, VendingMachine& machine) {
+                machine.expireHolds(start + std::chrono::minutes(minute));
+            });
+        }
+    });
+
+    std::size_t left = 0;
+    std::int64_t reserved = 0;
+    std::int64_t units = 0;
+    for (VendingMachine* machine : machines) {
+        left += machine->getHoldCount();
+        machine->visitItems([&](const ItemView& item) {
+            reserved += item.reserved;
+            units += item.quantity;
+        });
+    }
+    const std::int64_t expectedUnits =
+        static_cast<std::int64_t>(kMachines) * (kItemsPerMachine * 1000000LL - kHoldsPerMachine / 10);
+
+    std::printf("\n%zu holds on %d machines\n", holds, kMachines);
+    std::printf("%-28s %10s\n", "operation", "ns/op");
+    std::printf("%-28s %10.1f\n", "reserve", reserve);
+    std::printf("%-28s %10.1f\n", "confirm", confirm);
+    std::printf("%-28s %10.1f\n", "cancel", cancel);
+    std::printf("%-28s %10.1f\n", "sweep per machine, moving", movingSweep);
+    std::printf("%-28s %10.1f\n", "sweep per machine, idle", idleSweep);
+    std::printf("%-28s %10.1f\n", "expire", expire);
+    if (before > 0 && after > 0) {
+        std::printf("memory: %.1f bytes per hold\n", static_cast<double>(after - before) / holds);
+    }
+    std::printf("refused=%zu declined=%zu unknown=%zu holds left=%zu reserved units=%lld\n", refused, declined,
+                unknown, left, static_cast<long long>(reserved));
+    if (refused > 0 || declined > 0 || unknown > 0 || left > 0 || reserved != 0 || units != expectedUnits) {
+        std::printf("  stock was not restored: %lld units, expected %lld\n", static_cast<long long>(units),
+                    static_cast<long long>(expectedUnits));
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Measures what Idempotency-Key costs. First the cache alone at several
+// thread counts: a first request (begin + complete) and a retry (a
+// replayed hit). Then whole POST /api/insert-money requests through
+// VendingApi without a key, with a fresh key and as a retry. Last, a
+// cache much smaller than the key stream, which must stay within its byte
+// budget while keeping recently retried keys, and the same cache filled
+// with keys still in progress, which must refuse new ones rather than grow.
+// Exits non-zero if it grows past the budget or a replay returns the wrong
+// response.
+#include "fleet.hpp"
+#include "idempotency_cache.hpp"
+#include "metrics.hpp"
+#include "vending_api.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kOpsPerThread = 200000;
+constexpr int kApiRequests = 200000;
+
+class BenchRequest : public ApiRequest {
+public:
+    std::string_view method() const override { return "POST"; }
+    std::string_view path() const override { return "/api/insert-money"; }
+    const std::string& body() const override { return requestBody; }
+    std::string header(const std::string& name) const override {
+        if (name == "Idempotency-Key") {
+            return key;
+        }
+        return name == "X-Session-Id" ? std::string("bench") : std::string();
+    }
+    std::optional<std::string> param(const std::string&) const override { return std::nullopt; }
+
+    std::string requestBody = "{\"amount\":1}";
+    std::string key;
+};
+
+template <typename Op>
+double nsPerOp(int threads, int opsPerThread, Op op) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < opsPerThread; ++i) {
+                op(t, i);
+            }
+        });
+    }
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(threads) * opsPerThread);
+}
+
+std::string keyFor(int thread, int i) {
+    return "machine\ninsert-money\nsession-" + std::to_string(thread) + "\nkey-" + std::to_string(i);
+}
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    auto stored = std::make_shared<const ApiResponse>(ApiResponse{200, "text/plain", "Money inserted successfully", {}});
+
+    std::printf("%-28s %8s %10s\n", "cache operation", "threads", "ns/op");
+    for (int threads : {1, 2, 4, 8}) {
+        // Room for every key, so the retries all replay.
+        IdempotencyCacheOptions options;
+        options.capacityBytes = std::size_t(1) << 30;
+        IdempotencyCache cache(options);
+        // Keys are built up front so the timings are the cache's alone.
+        std::vector<std::vector<std::string>> keys(threads);
+        for (int t = 0; t < threads; ++t) {
+            for (int i = 0; i < kOpsPerThread / 4; ++i) {
+                keys[t].push_back(keyFor(t, i));
+            }
+        }
+        const int perThread = static_cast<int>(keys[0].size());
+        const double first = nsPerOp(threads, perThread, [&](int t, int i) {
+            std::shared_ptr<const ApiResponse> replay;
+            if (cache.begin(keys[t][i], 1, replay) == IdempotencyCache::Outcome::Started) {
+                cache.complete(keys[t][i], stored);
+            }
+        });
+        std::atomic<int> wrong{0};
+        const double retry = nsPerOp(threads, kOpsPerThread, [&](int t, int i) {
+            std::shared_ptr<const ApiResponse> replay;
+            if (cache.begin(keys[t][i % perThread], 1, replay) != IdempotencyCache::Outcome::Replayed ||
+                replay != stored) {
+                wrong.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        std::printf("%-28s %8d %10.1f\n", "first request", threads, first);
+        std::printf("%-28s %8d %10.1f\n", "retry (replayed)", threads, retry);
+        if (wrong.load() > 0) {
+            std::printf("  %d retries were not replayed\n", wrong.load());
+            ++failures;
+        }
+    }
+
+    {
+        Fleet fleet;
+        seedDefaultItems(fleet.addMachine("default"));
+        MetricsRegistry metrics;
+        AdmissionOptions admission;
+        admission.target = std::chrono::milliseconds(0);
+        IdempotencyCacheOptions idempotency;
+        idempotency.capacityBytes = std::size_t(1) << 30;
+        VendingApi api(fleet, metrics, admission, idempotency);
+        BenchRequest request;
+        auto time = [&](auto&& prepare) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kApiRequests; ++i) {
+                prepare(i);
+                ApiResponse response;
+                api.handle(request, response);
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / kApiRequests;
+        };
+        const double none = time([&](int) { request.key.clear(); });
+        const double fresh = time([&](int i) { request.key = "fresh-" + std::to_string(i); });
+        const double replayed = time([&](int i) { request.key = "fresh-" + std::to_string(i); });
+        std::printf("\n%-28s %10s %10s\n", "POST /api/insert-money", "ns/req", "overhead");
+        std::printf("%-28s %10.1f %10s\n", "no key", none, "-");
+        std::printf("%-28s %10.1f %+9.1f\n", "fresh key", fresh, fresh - none);
+        std::printf("%-28s %10.1f %+9.1f\n", "retry (replayed)", replayed, replayed - none);
+    }
+
+    {
+        // A 256 KiB cache fed a million keys, retrying every key once
+        // right after its first request.
+        IdempotencyCacheOptions options;
+        options.capacityBytes = 256 * 1024;
+        IdempotencyCache cache(options);
+        int missedRetries = 0;
+        std::size_t peak = 0;
+        for (int i = 0; i < 1000000; ++i) {
+            const std::string key = keyFor(0, i);
+            std::shared_ptr<const ApiResponse> replay;
+            if (cache.begin(key, 1, replay) == IdempotencyCache::Outcome::Started) {
+                cache.complete(key, stored);
+            }
+            if (cache.begin(key, 1, replay) != IdempotencyCache::Outcome::Replayed || replay != stored) {
+                ++missedRetries;
+            }
+            if (i % 1000 == 0) {
+                peak = std::max(peak, cache.bytes());
+            }
+        }
+        std::printf("\nbounded cache: budget=%zu B peak=%zu B keys=%zu evictions=%llu missed retries=%d\n",
+                    options.capacityBytes, peak, cache.size(), static_cast<unsigned long long>(cache.evictions()),
+                    missedRetries);
+        if (peak > options.capacityBytes || missedRetries > 0) {
+            ++failures;
+        }
+    }
+
+    {
+        // The same cache with keys that never complete: once they fill it,
+        // new keys are refused instead of growing it.
+        IdempotencyCacheOptions options;
+        options.capacityBytes = 256 * 1024;
+        IdempotencyCache cache(options);
+        int started = 0;
+        int refused = 0;
+        for (int i = 0; i < 100000; ++i) {
+            std::shared_ptr<const ApiResponse> replay;
+            const auto outcome = cache.begin(keyFor(0, i), 1, replay);
+            started += outcome == IdempotencyCache::Outcome::Started;
+            refused += outcome == IdempotencyCache::Outcome::Full;
+        }
+        std::printf("in-progress keys: budget=%zu B bytes=%zu B started=%d refused=%d\n", options.capacityBytes,
+                    cache.bytes(), started, refused);
+        if (cache.bytes() > options.capacityBytes || refused == 0) {
+            ++failures;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+// Contention benchmark: purchases against the sharded Inventory versus the
+// previous single-mutex implementation at increasing thread counts.
+#include "inventory.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The original Inventory: one mutex around the whole map.
+class SingleLockInventory {
+public:
+    void addItem(const Item& item) {
+        std::lock_guard<std::mutex> lock(mtx);
+        items[item.name] = { item.quantity, item.price.toDouble() };
+    }
+
+    bool purchaseItem(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (items.count(name) && items[name].first > 0) {
+            items[name].first--;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::map<std::string, std::pair<int, double>> items;
+    std::mutex mtx;
+};
+
+constexpr int kItems = 64;
+constexpr int kOpsPerThread = 200000;
+
+template <typename InventoryT>
+double run(int threads) {
+    InventoryT inventory;
+    std::vector<std::string> names;
+    for (int i = 0; i < kItems; ++i) {
+        names.push_back("item-" + std::to_string(i));
+        inventory.addItem(Item{names.back(), Money::fromCents(100), kOpsPerThread * threads});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&inventory, &names, t]() {
+            // Each thread sticks to its own item so we measure lock
+            // contention rather than contention on a single stock counter.
+            const std::string& name = names[t % kItems];
+            for (int i = 0; i < kOpsPerThread; ++i) {
+                inventory.purchaseItem(name);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(kOpsPerThread) * threads / elapsed.count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %18s %18s\n", "threads", "single-lock ops/s", "sharded ops/s");
+    for (int threads : {1, 4, 16, 64}) {
+        double legacy = run<SingleLockInventory>(threads);
+        double sharded = run<Inventory>(threads);
+        std::printf("%8d %18.0f %18.0f\n", threads, legacy, sharded);
+    }
+    return 0;
+}
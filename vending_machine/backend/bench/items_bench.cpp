@@ -0,0 +1,69 @@
+// Compares /api/items handler throughput with and without the serialized
+// catalog cache, wrk-style: fixed-duration polling from several threads.
+#include "catalog_cache.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kThreads = 4;
+constexpr auto kDuration = std::chrono::milliseconds(500);
+
+double requestsPerSecond(const std::function<std::size_t()>& handler) {
+    std::atomic<bool> stop{false};
+    std::atomic<long> requests{0};
+    std::atomic<std::size_t> bytes{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&]() {
+            long local = 0;
+            std::size_t localBytes = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                localBytes += handler();
+                ++local;
+            }
+            requests += local;
+            bytes += localBytes;
+        });
+    }
+    std::this_thread::sleep_for(kDuration);
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return requests / std::chrono::duration<double>(kDuration).count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %14s %14s %14s\n", "items", "rebuild req/s", "cached req/s", "304 req/s");
+    for (int catalogSize : {12, 1000}) {
+        VendingMachine machine(std::make_unique<CashPayment>(),
+                               std::make_unique<Inventory>(),
+                               std::make_unique<TransactionLog>());
+        for (int i = 0; i < catalogSize; ++i) {
+            machine.addItem(Item::snack("snack-" + std::to_string(i), Money::fromCents(120), 15, 45));
+        }
+        CatalogCache cache(machine);
+        const std::string etag = cache.get()->etag;
+
+        double rebuild = requestsPerSecond([&machine]() {
+            return CatalogCache::serialize(machine).size();
+        });
+        double cached = requestsPerSecond([&cache]() {
+            std::string body = cache.get()->body;
+            return body.size();
+        });
+        double notModified = requestsPerSecond([&cache, &etag]() {
+            return static_cast<std::size_t>(cache.get()->etag == etag);
+        });
+        std::printf("%8d %14.0f %14.0f %14.0f\n", catalogSize, rebuild, cached, notModified);
+    }
+    return 0;
+}
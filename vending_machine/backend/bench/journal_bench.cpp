@@ -0,0 +1,78 @@
+// Group commit benchmark: concurrent purchase commits against the journal at
+// several group-commit windows, reporting commits/s, the batch size that
+// actually formed and commit latency percentiles.
+#include "journal.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr const char* kPath = "journal_bench.journal";
+constexpr int kCommitsPerThread = 200;
+
+void run(int threads, std::chrono::microseconds flushInterval) {
+    std::remove(kPath);
+    JournalOptions options;
+    options.path = kPath;
+    options.flushInterval = flushInterval;
+    options.maxBatchRecords = static_cast<std::size_t>(threads);
+
+    std::vector<std::vector<double>> latencies(threads);
+    std::chrono::duration<double> elapsed{};
+    std::uint64_t batches = 0;
+    {
+        Journal journal(options);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&journal, &latencies, t]() {
+                JournalRecord record;
+                record.type = JournalRecordType::Purchase;
+                record.item = "Coke";
+                record.session = "session-" + std::to_string(t);
+                record.amount = Money::fromCents(150);
+                record.quantity = 1;
+                latencies[t].reserve(kCommitsPerThread);
+                for (int i = 0; i < kCommitsPerThread; ++i) {
+                    auto begin = std::chrono::steady_clock::now();
+                    journal.commit(record);
+                    std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - begin;
+                    latencies[t].push_back(took.count());
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        batches = journal.batchesWritten();
+    }
+    std::remove(kPath);
+
+    std::vector<double> all;
+    for (const auto& perThread : latencies) {
+        all.insert(all.end(), perThread.begin(), perThread.end());
+    }
+    std::sort(all.begin(), all.end());
+    const double commits = static_cast<double>(all.size());
+    std::printf("%8d %10lld %12.0f %10.1f %10.0f %10.0f\n", threads,
+                static_cast<long long>(flushInterval.count()), commits / elapsed.count(),
+                commits / static_cast<double>(batches), all[all.size() / 2],
+                all[static_cast<std::size_t>(all.size() * 0.99)]);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %10s %12s %10s %10s %10s\n", "threads", "window us", "commits/s",
+                "avg batch", "p50 us", "p99 us");
+    for (int threads : {1, 8, 64}) {
+        for (auto window : {0, 200, 1000}) {
+            run(threads, std::chrono::microseconds(window));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Counts heap allocations and time per VendingMachine::purchaseItem call at
+// several catalog sizes. Exits non-zero if the purchase path allocates.
+// Only the purchasing thread is counted: the transaction log's background
+// drainer builds history chunks off the purchase path.
+#include "vending_machine.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+std::atomic<long> allocations{0};
+thread_local bool counted = false;
+}
+
+void* operator new(std::size_t size) {
+    if (counted) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+int main() {
+    constexpr int kPurchases = 200000;
+    counted = true;
+    bool allocated = false;
+
+    // A queue that holds the whole run keeps the purchasing thread off the
+    // full-queue slow path, which grows the history inline.
+    TransactionLogOptions logOptions;
+    logOptions.queueCapacity = 1 << 18;
+
+    std::printf("%10s %12s %14s\n", "catalog", "ns/purchase", "allocs/purchase");
+    for (int catalogSize : {12, 10000, 1000000}) {
+        VendingMachine machine(std::make_unique<CashPayment>(Money::fromCents(1000000000000)),
+                               std::make_unique<Inventory>(),
+                               std::make_unique<TransactionLog>(logOptions));
+        for (int i = 0; i < catalogSize; ++i) {
+            machine.addItem(Item::snack("snack-" + std::to_string(i), Money::fromCents(100), kPurchases, 50));
+        }
+        const std::string name = "snack-" + std::to_string(catalogSize / 2);
+
+        long before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kPurchases; ++i) {
+            machine.purchaseItem(name);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        long allocs = allocations.load() - before;
+
+        std::printf("%10d %12.1f %14.3f\n", catalogSize, elapsed.count() / kPurchases,
+                    static_cast<double>(allocs) / kPurchases);
+        allocated = allocated || allocs != 0;
+    }
+    return allocated ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+// Stress benchmark for per-session balances: 64 threads insert money, buy and
+// cash out on a shared pool of sessions, then the books are checked for lost
+// updates. Exits non-zero if money or stock does not add up.
+#include "vending_machine.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    constexpr int kThreads = 64;
+    constexpr int kSessions = 16;
+    constexpr int kRounds = 20000;
+    constexpr int kStock = kThreads * kRounds;
+
+    VendingMachine machine(std::make_unique<CashPayment>(),
+                           std::make_unique<Inventory>(),
+                           std::make_unique<TransactionLog>());
+    machine.addItem(Item::snack("Chips", Money::fromCents(100), kStock, 50));
+
+    std::vector<std::string> sessions;
+    for (int i = 0; i < kSessions; ++i) {
+        sessions.push_back("session-" + std::to_string(i));
+    }
+
+    // Totals are tracked in cents.
+    std::atomic<long> inserted{0};
+    std::atomic<long> purchased{0};
+    std::atomic<long> returned{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&, t]() {
+            long localInserted = 0, localPurchased = 0, localReturned = 0;
+            for (int i = 0; i < kRounds; ++i) {
+                const std::string& session = sessions[(t + i) % kSessions];
+                machine.insertMoney(session, Money::fromCents(200));
+                localInserted += 200;
+                if (machine.purchaseItem(session, "Chips")) {
+                    ++localPurchased;
+                }
+                if (i % 16 == 0) {
+                    localReturned += machine.returnChange(session).toCents();
+                }
+            }
+            inserted += localInserted;
+            purchased += localPurchased;
+            returned += localReturned;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    long remaining = 0;
+    for (const auto& session : sessions) {
+        remaining += machine.getBalance(session).toCents();
+    }
+    long stockLeft = machine.getAvailableItems().front().quantity;
+    long logged = static_cast<long>(machine.getTransactionHistory().size());
+
+    bool moneyBalanced = inserted == machine.getTotalRevenue().toCents() + returned + remaining;
+    bool stockBalanced = kStock - stockLeft == purchased && logged == purchased;
+
+    std::printf("threads=%d sessions=%d ops/s=%.0f\n", kThreads, kSessions,
+                3.0 * kThreads * kRounds / elapsed.count());
+    std::printf("cents inserted=%ld spent=%lld returned=%ld remaining=%ld -> %s\n",
+                inserted.load(), static_cast<long long>(machine.getTotalRevenue().toCents()),
+                returned.load(), remaining,
+                moneyBalanced ? "balanced" : "LOST UPDATES");
+    std::printf("stock sold=%ld logged=%ld -> %s\n", kStock - stockLeft, logged,
+                stockBalanced ? "balanced" : "LOST UPDATES");
+    return moneyBalanced && stockBalanced ? 0 : 1;
+}
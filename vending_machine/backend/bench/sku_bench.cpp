@@ -0,0 +1,142 @@
+// Measures what keying items by interned SKU ids buys. For several catalog
+// sizes: the SKU table's name lookup alone, then single-purchase latency
+// through VendingMachine by name (a lookup per call) and by id (resolved
+// once, as the HTTP handlers now do), as p50/p99/mean. Then the
+// transaction history: bytes per logged transaction, and the cost of
+// logging by name against by id. Exits non-zero if purchases by id and by
+// name sell different counts or the history does not name what was sold.
+#include "sku_table.hpp"
+#include "transaction.hpp"
+#include "vending_machine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kPurchases = 200000;
+constexpr int kLogged = 2000000;
+
+std::string itemName(int catalog, int i) {
+    return "sku-bench-" + std::to_string(catalog) + "-item-" + std::to_string(i);
+}
+
+struct Latency {
+    double p50 = 0;
+    double p99 = 0;
+    double mean = 0;
+};
+
+// Times each call of `op(i)` separately.
+template <typename Op>
+Latency measure(int count, Op op) {
+    std::vector<std::uint32_t> samples;
+    samples.reserve(count);
+    double total = 0;
+    for (int i = 0; i < count; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        op(i);
+        const auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        samples.push_back(static_cast<std::uint32_t>(took));
+        total += static_cast<double>(took);
+    }
+    std::sort(samples.begin(), samples.end());
+    return {static_cast<double>(samples[samples.size() / 2]),
+            static_cast<double>(samples[static_cast<std::size_t>(samples.size() * 0.99)]), total / count};
+}
+
+std::unique_ptr<VendingMachine> makeMachine(int catalog) {
+    auto machine = std::make_unique<VendingMachine>(std::make_unique<CashPayment>(), std::make_unique<Inventory>(),
+                                                    std::make_unique<TransactionLog>());
+    for (int i = 0; i < catalog; ++i) {
+        machine->addItem(Item::snack(itemName(catalog, i), Money::fromCents(100), 1000000, 50));
+    }
+    machine->insertMoney("customer", Money::fromCents(1000000000000));
+    return machine;
+}
+
+}  // namespace
+
+int main() {
+    int failures = 0;
+    SkuTable& table = SkuTable::global();
+
+    std::printf("%-8s %-20s %9s %9s %9s\n", "catalog", "purchase", "p50 ns", "p99 ns", "mean ns");
+    for (int catalog : {12, 1000, 100000}) {
+        auto byName = makeMachine(catalog);
+        auto byId = makeMachine(catalog);
+        std::mt19937 rng(catalog);
+        std::uniform_int_distribution<int> pick(0, catalog - 1);
+        std::vector<std::string> names(4096);
+        std::vector<std::uint32_t> skus(4096);
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            names[i] = itemName(catalog, pick(rng));
+            skus[i] = table.find(names[i]);
+        }
+
+        volatile std::uint32_t sink = 0;
+        const Latency lookup = measure(kPurchases, [&](int i) { sink = table.find(names[i & 4095]); });
+        int soldByName = 0;
+        int soldById = 0;
+        const Latency name = measure(kPurchases, [&](int i) {
+            soldByName += byName->purchaseItem("customer", names[i & 4095]);
+        });
+        const Latency id = measure(kPurchases, [&](int i) {
+            soldById += byId->purchaseItem("customer", skus[i & 4095]);
+        });
+        std::printf("%-8d %-20s %9.0f %9.0f %9.1f\n", catalog, "SkuTable::find", lookup.p50, lookup.p99,
+                    lookup.mean);
+        std::printf("%-8d %-20s %9.0f %9.0f %9.1f\n", catalog, "by name", name.p50, name.p99, name.mean);
+        std::printf("%-8d %-20s %9.0f %9.0f %9.1f\n", catalog, "by id", id.p50, id.p99, id.mean);
+        if (soldByName != kPurchases || soldById != kPurchases) {
+            std::printf("  sold %d by name and %d by id of %d\n", soldByName, soldById, kPurchases);
+            ++failures;
+        }
+    }
+
+    // Twelve items, as on a real machine.
+    std::vector<std::string> names;
+    std::vector<std::uint32_t> skus;
+    for (int i = 0; i < 12; ++i) {
+        names.push_back(itemName(12, i));
+        skus.push_back(table.intern(names.back()));
+    }
+    TransactionLog byName;
+    TransactionLog byId;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLogged; ++i) {
+        byName.logTransaction(names[i % 12], Money::fromCents(150), 1700000000 + i / 4);
+    }
+    const auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLogged; ++i) {
+        byId.logTransaction(skus[i % 12], Money::fromCents(150), 1700000000 + i / 4);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::nano> loggedByName = middle - start;
+    const std::chrono::duration<double, std::nano> loggedById = end - middle;
+    // Reading drains the queues, so the memory is the history's alone.
+    const std::size_t retained = byId.retainedCount();
+    const double bytes = static_cast<double>(byId.memoryUsage()) / static_cast<double>(retained);
+    // A row used to hold the name as a std::string.
+    const std::size_t rowBytes = sizeof(std::string) + sizeof(Money) + sizeof(std::time_t);
+    std::printf("\nhistory of %d transactions\n", kLogged);
+    std::printf("%-28s %10.1f\n", "logTransaction by name, ns", loggedByName.count() / kLogged);
+    std::printf("%-28s %10.1f\n", "logTransaction by id, ns", loggedById.count() / kLogged);
+    std::printf("%-28s %10.2f (row was %zu, now %zu)\n", "bytes/transaction", bytes, rowBytes,
+                sizeof(Transaction));
+
+    std::size_t misnamed = 0;
+    byId.visit(0, SIZE_MAX, [&](const TransactionView& t) {
+        const auto i = std::find(skus.begin(), skus.end(), t.itemId) - skus.begin();
+        misnamed += i == static_cast<std::ptrdiff_t>(skus.size()) || t.itemName != names[i];
+    });
+    if (retained != static_cast<std::size_t>(kLogged) || byName.retainedCount() != retained || misnamed > 0) {
+        std::printf("  history lost or misnamed transactions\n");
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Enqueue latency of TransactionLog::logTransaction under contention,
+// against the previous design of a mutex-guarded vector push_back.
+#include "transaction.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The previous TransactionLog: every purchase thread appends under one lock.
+class LockedLog {
+public:
+    void logTransaction(const std::string& itemName, Money price) {
+        std::lock_guard<std::mutex> lock(mtx);
+        history.push_back({itemName, price, std::time(nullptr)});
+    }
+
+private:
+    // Transactions then carried a copy of the item name.
+    struct Entry {
+        std::string itemName;
+        Money price;
+        std::time_t timestamp;
+    };
+    std::vector<Entry> history;
+    std::mutex mtx;
+};
+
+constexpr int kOpsPerThread = 50000;
+
+template <typename Log>
+void run(const char* name, int threads) {
+    Log log;
+    std::vector<std::vector<std::uint32_t>> samples(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&log, &samples, t]() {
+            const std::string item = "Snickers";
+            samples[t].reserve(kOpsPerThread);
+            for (int i = 0; i < kOpsPerThread; ++i) {
+                auto begin = std::chrono::steady_clock::now();
+                log.logTransaction(item, Money::fromCents(120));
+                auto took = std::chrono::steady_clock::now() - begin;
+                samples[t].push_back(static_cast<std::uint32_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(took).count()));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::vector<std::uint32_t> all;
+    for (const auto& perThread : samples) {
+        all.insert(all.end(), perThread.begin(), perThread.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::printf("%-14s %8d %10u %10u %10u\n", name, threads, all[all.size() / 2],
+                all[static_cast<std::size_t>(all.size() * 0.99)], all.back());
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%-14s %8s %10s %10s %10s\n", "log", "threads", "p50 ns", "p99 ns", "max ns");
+    for (int threads : {1, 4, 16, 64}) {
+        run<LockedLog>("mutex+vector", threads);
+        run<TransactionLog>("mpsc queue", threads);
+    }
+    return 0;
+}
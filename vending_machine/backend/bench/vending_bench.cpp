@@ -0,0 +1,310 @@
+// HTTP load generator for a running vending_machine_server. Every
+// connection is a thread with its own httplib client and session that sends
+// a weighted mix of /api/items, /api/insert-money, /api/purchase and
+// /api/return-change requests over loopback, back to back, for a fixed
+// duration after a warmup. Reports throughput and p50/p99/p999/max latency
+// per endpoint from log-linear histograms.
+//
+//   vending_bench [--host=127.0.0.1] [--port=8080] [--connections=8]
+//                 [--duration=10] [--warmup=2] [--keep-alive=1]
+//                 [--mix=items:50,insert:20,purchase:20,return:10]
+//                 [--machine=<id>] [--idle=0]
+//
+// --idle=N opens N more connections that send nothing and holds them for
+// the whole run, the way a fleet of kiosks between purchases would, and
+// reports how many the server kept open.
+//
+// Exits non-zero if the server cannot be reached or a request fails at the
+// transport level (non-2xx answers, such as sold-out purchases, are counted
+// but do not fail the run).
+#include "histogram.hpp"
+#include "httplib.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum Endpoint { kItems, kInsert, kPurchase, kReturn, kEndpointCount };
+const char* const kEndpointNames[kEndpointCount] = {"items", "insert", "purchase", "return"};
+
+struct Config {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 8;
+    double duration = 10;
+    double warmup = 2;
+    bool keepAlive = true;
+    int mix[kEndpointCount] = {50, 20, 20, 10};
+    std::string prefix = "/api";
+    int idle = 0;
+};
+
+struct Result {
+    Histogram latency[kEndpointCount];
+    std::uint64_t non2xx[kEndpointCount] = {};
+    std::uint64_t transportErrors = 0;
+};
+
+bool parseMix(const std::string& text, int* mix) {
+    std::fill(mix, mix + kEndpointCount, 0);
+    std::stringstream in(text);
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        const auto colon = part.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        const std::string name = part.substr(0, colon);
+        int e = 0;
+        while (e < kEndpointCount && name != kEndpointNames[e]) {
+            ++e;
+        }
+        if (e == kEndpointCount) {
+            return false;
+        }
+        mix[e] = std::atoi(part.c_str() + colon + 1);
+    }
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, Config& config) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--host") {
+            config.host = value;
+        } else if (key == "--port") {
+            config.port = std::atoi(value.c_str());
+        } else if (key == "--connections") {
+            config.connections = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--duration") {
+            config.duration = std::atof(value.c_str());
+        } else if (key == "--warmup") {
+            config.warmup = std::atof(value.c_str());
+        } else if (key == "--keep-alive") {
+            config.keepAlive = value != "0" && value != "false";
+        } else if (key == "--mix") {
+            if (!parseMix(value, config.mix)) {
+                return false;
+            }
+        } else if (key == "--machine") {
+            config.prefix = "/api/machines/" + value;
+#ifndef _WIN32
+        } else if (key == "--idle") {
+            config.idle = std::max(0, std::atoi(value.c_str()));
+#endif
+        } else {
+            return false;
+        }
+    }
+    int weight = 0;
+    for (int w : config.mix) {
+        weight += w;
+    }
+    return weight > 0;
+}
+
+void runConnection(const Config& config, const std::vector<std::string>& items, int id,
+                   const std::atomic<int>& phase, Result& result) {
+    httplib::Client client(config.host, config.port);
+    client.set_keep_alive(config.keepAlive);
+    client.set_tcp_nodelay(true);
+    const httplib::Headers headers = {{"X-Session-Id", "bench-" + std::to_string(id)}};
+    std::mt19937 rng(static_cast<unsigned>(id) * 7919u + 1);
+    std::discrete_distribution<int> pickEndpoint(config.mix, config.mix + kEndpointCount);
+    std::uniform_int_distribution<std::size_t> pickItem(0, items.size() - 1);
+
+    const std::string itemsPath = config.prefix + "/items";
+    const std::string insertPath = config.prefix + "/insert-money";
+    const std::string purchasePath = config.prefix + "/purchase";
+    const std::string returnPath = config.prefix + "/return-change";
+    const std::string insertBody = "{\"amount\":5}";
+
+    // Phase 0 is warmup, 1 is measured, 2 means stop.
+    while (phase.load(std::memory_order_relaxed) < 2) {
+        const int endpoint = pickEndpoint(rng);
+        const auto start = std::chrono::steady_clock::now();
+        httplib::Result response;
+        switch (endpoint) {
+        case kItems:
+            response = client.Get(itemsPath, headers);
+            break;
+        case kInsert:
+            response = client.Post(insertPath, headers, insertBody, "application/json");
+            break;
+        case kPurchase:
+            response = client.Post(purchasePath, headers, "{\"item\":\"" + items[pickItem(rng)] + "\"}",
+                                   "application/json");
+            break;
+        default:
+            response = client.Post(returnPath, headers, "", "application/json");
+            break;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (phase.load(std::memory_order_relaxed) != 1) {
+            continue;
+        }
+        if (!response) {
+            ++result.transportErrors;
+            continue;
+        }
+        result.latency[endpoint].record(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        if (response->status < 200 || response->status >= 300) {
+            ++result.non2xx[endpoint];
+        }
+    }
+}
+
+#ifndef _WIN32
+// Connects `count` sockets that never send a request; stops early if the
+// client runs out of descriptors.
+std::vector<int> openIdle(const Config& config, int count) {
+    std::vector<int> sockets;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(config.port));
+    inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr);
+    for (int i = 0; i < count; ++i) {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            break;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(fd);
+            break;
+        }
+        sockets.push_back(fd);
+    }
+    return sockets;
+}
+
+// Closes the sockets and returns how many the server had not closed.
+int closeIdle(const std::vector<int>& sockets) {
+    int open = 0;
+    for (int fd : sockets) {
+        char byte;
+        if (recv(fd, &byte, 1, MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++open;
+        }
+        close(fd);
+    }
+    return open;
+}
+#endif
+
+void report(const char* name, const Histogram& latency, std::uint64_t non2xx, double seconds) {
+    std::printf("%-9s %10llu %10.0f %9.1f %9.1f %9.1f %9.1f %9llu\n", name,
+                static_cast<unsigned long long>(latency.count()), latency.count() / seconds,
+                latency.percentile(0.50) / 1000.0, latency.percentile(0.99) / 1000.0,
+                latency.percentile(0.999) / 1000.0, latency.max() / 1000.0,
+                static_cast<unsigned long long>(non2xx));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        std::fprintf(stderr,
+                     "usage: %s [--host=H] [--port=P] [--connections=N] [--duration=S] [--warmup=S]\n"
+                     "          [--keep-alive=0|1] [--mix=items:W,insert:W,purchase:W,return:W] [--machine=ID]\n"
+                     "          [--idle=N]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    // The purchase mix draws from whatever the server is selling.
+    std::vector<std::string> items;
+    {
+        httplib::Client client(config.host, config.port);
+        auto response = client.Get(config.prefix + "/items");
+        if (!response || response->status != 200) {
+            std::fprintf(stderr, "cannot reach %s:%d%s/items\n", config.host.c_str(), config.port,
+                         config.prefix.c_str());
+            return 1;
+        }
+        for (const auto& item : nlohmann::json::parse(response->body)) {
+            items.push_back(item["name"].get<std::string>());
+        }
+        if (items.empty()) {
+            std::fprintf(stderr, "the server has no items to buy\n");
+            return 1;
+        }
+    }
+
+#ifndef _WIN32
+    const std::vector<int> idle = openIdle(config, config.idle);
+#endif
+    std::atomic<int> phase{0};
+    std::vector<Result> results(config.connections);
+    std::vector<std::thread> connections;
+    for (int c = 0; c < config.connections; ++c) {
+        connections.emplace_back(runConnection, std::cref(config), std::cref(items), c, std::cref(phase),
+                                 std::ref(results[c]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.warmup));
+    phase.store(1);
+    const auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.duration));
+    phase.store(2);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& connection : connections) {
+        connection.join();
+    }
+
+    Result total;
+    Histogram all;
+    for (const auto& result : results) {
+        for (int e = 0; e < kEndpointCount; ++e) {
+            total.latency[e].merge(result.latency[e]);
+            total.non2xx[e] += result.non2xx[e];
+        }
+        total.transportErrors += result.transportErrors;
+    }
+    std::uint64_t allNon2xx = 0;
+    for (int e = 0; e < kEndpointCount; ++e) {
+        all.merge(total.latency[e]);
+        allNon2xx += total.non2xx[e];
+    }
+
+    std::printf("connections=%d duration=%.1f s keep-alive=%s\n", config.connections, seconds,
+                config.keepAlive ? "on" : "off");
+#ifndef _WIN32
+    if (config.idle > 0) {
+        const int opened = static_cast<int>(idle.size());
+        std::printf("idle connections=%d opened=%d still open=%d\n", config.idle, opened, closeIdle(idle));
+    }
+#endif
+    std::printf("%-9s %10s %10s %9s %9s %9s %9s %9s\n", "endpoint", "requests", "req/s", "p50 us", "p99 us",
+                "p999 us", "max us", "non-2xx");
+    for (int e = 0; e < kEndpointCount; ++e) {
+        if (config.mix[e] > 0) {
+            report(kEndpointNames[e], total.latency[e], total.non2xx[e], seconds);
+        }
+    }
+    report("all", all, allNon2xx, seconds);
+    if (total.transportErrors > 0) {
+        std::printf("transport errors=%llu\n", static_cast<unsigned long long>(total.transportErrors));
+        return 1;
+    }
+    return 0;
+}
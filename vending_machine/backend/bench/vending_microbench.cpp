@@ -0,0 +1,401 @@
+// In-process microbenchmarks for the core classes and metrics instruments. Every case runs at each
+// thread count (and, where the catalog matters, each catalog size) with all
+// threads released together, and reports wall-clock ns/op over all threads,
+// heap allocations per op made by the measuring threads, and the speedup
+// over one thread, which traces the scaling curve.
+//
+//   vending_microbench [--json] [--quick] [--threads=1,2,4,8]
+//                      [--catalogs=12,1000,100000] [--filter=substring]
+//
+// --json prints one JSON document instead of the table, so runs from two
+// commits can be diffed case by case.
+#include "vending_machine.h"
+#include "metrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::atomic<long> allocations{0};
+thread_local bool counted = false;
+
+// Every replaceable allocation function below comes through here, so the
+// counts include array and over-aligned allocations, and everything is
+// released with std::free whichever form allocated it.
+void* allocate(std::size_t size, std::size_t alignment) {
+    if (counted) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size ? size : 1);
+    }
+    // aligned_alloc wants a non-zero multiple of the alignment.
+    return std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) / alignment * alignment);
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+    if (void* p = allocate(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+}  // namespace
+
+void* operator new(std::size_t size) {
+    return allocateOrThrow(size, 0);
+}
+void* operator new[](std::size_t size) {
+    return allocateOrThrow(size, 0);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Enough that no case sells out.
+constexpr int kStock = 1 << 30;
+
+struct Options {
+    bool json = false;
+    bool quick = false;
+    std::vector<int> threads = {1, 2, 4, 8};
+    std::vector<int> catalogs = {12, 1000, 100000};
+    std::string filter;
+};
+
+struct Result {
+    std::string name;
+    int catalog = 0;
+    int threads = 0;
+    long ops = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double speedup = 1;
+};
+
+// op(thread, i) is called `opsPerThread` times on each of `threads` threads.
+using Op = std::function<void(int, long)>;
+
+Result measure(const std::string& name, int catalog, int threads, long opsPerThread, const Op& op) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            counted = true;
+            for (long i = 0; i < opsPerThread; ++i) {
+                op(t, i);
+            }
+            counted = false;
+        });
+    }
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+    const long before = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    const long ops = opsPerThread * threads;
+    return {name, catalog, threads, ops, elapsed.count() / ops,
+            static_cast<double>(allocations.load() - before) / ops};
+}
+
+std::string itemName(int i) {
+    return "snack-" + std::to_string(i);
+}
+
+std::unique_ptr<Inventory> makeInventory(int catalog) {
+    auto inventory = std::make_unique<Inventory>();
+    for (int i = 0; i < catalog; ++i) {
+        inventory->addItem(Item::snack(itemName(i), Money::fromCents(100 + i % 400), kStock, 50));
+    }
+    return inventory;
+}
+
+std::unique_ptr<VendingMachine> makeMachine(int catalog) {
+    return std::make_unique<VendingMachine>(std::make_unique<CashPayment>(), makeInventory(catalog),
+                                            std::make_unique<TransactionLog>());
+}
+
+// Each thread cycles through its own random sequence of existing names, so
+// threads contend only where their picks collide.
+std::vector<std::vector<const std::string*>> pickNames(const std::vector<std::string>& names, int threads) {
+    std::vector<std::vector<const std::string*>> picks(threads);
+    for (int t = 0; t < threads; ++t) {
+        std::mt19937 rng(t + 1);
+        std::uniform_int_distribution<std::size_t> pick(0, names.size() - 1);
+        picks[t].resize(4096);
+        for (auto& name : picks[t]) {
+            name = &names[pick(rng)];
+        }
+    }
+    return picks;
+}
+
+std::vector<std::string> catalogNames(int catalog) {
+    std::vector<std::string> names;
+    for (int i = 0; i < catalog; ++i) {
+        names.push_back(itemName(i));
+    }
+    return names;
+}
+
+std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        if (std::atoi(part.c_str()) > 0) {
+            values.push_back(std::atoi(part.c_str()));
+        }
+    }
+    return values;
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--json") {
+            options.json = true;
+        } else if (key == "--quick") {
+            options.quick = true;
+        } else if (key == "--threads") {
+            options.threads = parseList(value);
+        } else if (key == "--catalogs") {
+            options.catalogs = parseList(value);
+        } else if (key == "--filter") {
+            options.filter = value;
+        } else {
+            return false;
+        }
+    }
+    return !options.threads.empty() && !options.catalogs.empty();
+}
+
+class Suite {
+public:
+    explicit Suite(const Options& options) : options(options) {}
+
+    // Runs `name` at every thread count; setup(threads) builds the op.
+    template <typename Setup>
+    void run(const std::string& name, int catalog, long opsPerThread, Setup&& setup) {
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        if (options.quick) {
+            opsPerThread = std::max(1L, opsPerThread / 10);
+        }
+        double first = 0;
+        for (int threads : options.threads) {
+            const Op op = setup(threads);
+            Result result = measure(name, catalog, threads, opsPerThread, op);
+            if (first == 0) {
+                first = result.nsPerOp;
+            }
+            // Throughput relative to the first (usually one-thread) run.
+            result.speedup = first / result.nsPerOp;
+            if (!options.json) {
+                std::printf("%-36s %9d %8d %11ld %10.1f %11.3f %8.2f\n", result.name.c_str(), result.catalog,
+                            result.threads, result.ops, result.nsPerOp, result.allocsPerOp, result.speedup);
+            }
+            results.push_back(result);
+        }
+    }
+
+    void printJson() const {
+        std::printf("{\"results\":[\n");
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            std::printf("  {\"name\":\"%s\",\"catalog\":%d,\"threads\":%d,\"ops\":%ld,"
+                        "\"ns_per_op\":%.2f,\"allocs_per_op\":%.4f,\"speedup\":%.3f}%s\n",
+                        r.name.c_str(), r.catalog, r.threads, r.ops, r.nsPerOp, r.allocsPerOp, r.speedup,
+                        i + 1 < results.size() ? "," : "");
+        }
+        std::printf("]}\n");
+    }
+
+private:
+    const Options& options;
+    std::vector<Result> results;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "usage: %s [--json] [--quick] [--threads=1,2,4,8] [--catalogs=12,1000,100000]"
+                     " [--filter=substring]\n",
+                     argv[0]);
+        return 2;
+    }
+    if (!options.json) {
+        std::printf("%-36s %9s %8s %11s %10s %11s %8s\n", "benchmark", "catalog", "threads", "ops", "ns/op",
+                    "allocs/op", "speedup");
+    }
+    Suite suite(options);
+
+    for (int catalog : options.catalogs) {
+        const std::vector<std::string> names = catalogNames(catalog);
+        auto inventory = makeInventory(catalog);
+        suite.run("Inventory::purchaseItem", catalog, 200000, [&](int threads) {
+            auto picks = pickNames(names, threads);
+            return Op([&inventory, picks](int t, long i) {
+                inventory->purchaseItem(*picks[t][i & 4095]);
+            });
+        });
+        // What GET /api/items does before serializing: one pass over the
+        // whole catalog.
+        suite.run("Inventory::visit", catalog, std::max(10L, 5000000L / catalog), [&](int) {
+            return Op([&inventory](int, long) {
+                long units = 0;
+                inventory->visit([&units](const ItemView& item) { units += item.quantity; });
+                if (units < 0) {
+                    std::abort();
+                }
+            });
+        });
+
+        auto machine = makeMachine(catalog);
+        suite.run("VendingMachine::purchaseItem", catalog, 100000, [&](int threads) {
+            auto picks = pickNames(names, threads);
+            std::vector<std::string> sessions;
+            for (int t = 0; t < threads; ++t) {
+                sessions.push_back("session-" + std::to_string(t));
+                machine->insertMoney(sessions.back(), Money::fromCents(1000000000000));
+            }
+            return Op([&machine, picks, sessions](int t, long i) {
+                machine->purchaseItem(sessions[t], *picks[t][i & 4095]);
+            });
+        });
+        suite.run("VendingMachine::getAvailableItems", catalog, std::max(5L, 500000L / catalog), [&](int) {
+            return Op([&machine](int, long) {
+                if (machine->getAvailableItems().empty()) {
+                    std::abort();
+                }
+            });
+        });
+    }
+
+    {
+        TransactionLog log;
+        const std::vector<std::string> names = catalogNames(12);
+        suite.run("TransactionLog::logTransaction", 0, 300000, [&](int) {
+            return Op([&log, &names](int, long i) {
+                log.logTransaction(names[i % names.size()], Money::fromCents(150), 1700000000 + i);
+            });
+        });
+    }
+
+    {
+        // One customer's balance shared by every thread: each op inserts a
+        // coin and pays for an item with it.
+        CashPayment payment;
+        suite.run("CashPayment::addMoney+processPayment", 0, 500000, [&](int) {
+            return Op([&payment](int, long) {
+                payment.addMoney(Money::fromCents(100));
+                payment.processPayment(Money::fromCents(100));
+            });
+        });
+        suite.run("CashPayment::getBalance", 0, 1000000, [&](int) {
+            return Op([&payment](int, long) {
+                if (payment.getBalance() < Money()) {
+                    std::abort();
+                }
+            });
+        });
+    }
+
+    {
+        // What every request pays for /metrics: one shared counter and one
+        // shared latency histogram.
+        MetricsRegistry registry;
+        Counter& counter = registry.counter("bench_total", "Counter under test.");
+        LatencyHistogram& latency = registry.histogram("bench_seconds", "Histogram under test.");
+        suite.run("Counter::add", 0, 2000000, [&](int) {
+            return Op([&counter](int, long) { counter.add(); });
+        });
+        suite.run("LatencyHistogram::record", 0, 2000000, [&](int) {
+            return Op([&latency](int, long i) { latency.record(std::chrono::nanoseconds(i * 37 % 5000000)); });
+        });
+    }
+
+    if (options.json) {
+        suite.printJson();
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+struct AdmissionOptions {
+    // Queueing delay the server aims to stay under. Zero turns delay-based
+    // shedding off.
+    std::chrono::milliseconds target{5};
+    // How long the delay must stay above `target` before the server counts
+    // as overloaded, and the most any request may wait.
+    std::chrono::milliseconds interval{100};
+    // Requests in handlers at once; zero for no limit.
+    std::size_t maxInFlight = 0;
+    // Fraction of maxInFlight low-priority requests may take, keeping the
+    // rest for money in, purchases and change.
+    double lowPriorityShare = 0.75;
+};
+
+// CoDel-style admission control in front of the request handlers. Each
+// request is judged by how long it queued before reaching a handler (its
+// sojourn). When even the shortest sojourn over an interval exceeds the
+// target, the server is overloaded: low-priority requests that queued for
+// longer than the target are refused at once, so the queue drains instead
+// of every request getting slow. High-priority requests are only refused
+// after queueing for a full interval, and an in-flight limit keeps part of
+// the capacity for them.
+class AdmissionController {
+public:
+    enum class Priority { Low, High };
+
+    // Holds an in-flight slot until destroyed; false if refused.
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept : owner(other.owner) { other.owner = nullptr; }
+        Ticket& operator=(Ticket&&) = delete;
+        ~Ticket() {
+            if (owner) {
+                owner->inFlight.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        explicit operator bool() const { return owner != nullptr; }
+
+    private:
+        friend class AdmissionController;
+        explicit Ticket(AdmissionController* owner) : owner(owner) {}
+        AdmissionController* owner = nullptr;
+    };
+
+    explicit AdmissionController(AdmissionOptions options = AdmissionOptions());
+
+    // `sojourn` is empty when the front end cannot tell how long the
+    // request queued; only the in-flight limit applies to it then.
+    Ticket admit(Priority priority, std::optional<std::chrono::nanoseconds> sojourn,
+                 std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    std::size_t inFlightCount() const { return static_cast<std::size_t>(inFlight.load(std::memory_order_relaxed)); }
+    bool isOverloaded() const { return overloaded.load(std::memory_order_relaxed); }
+    // Seconds a refused client should wait before retrying.
+    int retryAfterSeconds() const;
+
+private:
+    void observe(std::int64_t sojournNanos, std::int64_t nowNanos);
+
+    const AdmissionOptions options;
+    std::atomic<long> inFlight{0};
+    // The current interval's end and shortest sojourn, in nanoseconds.
+    std::atomic<std::int64_t> intervalEnd{0};
+    std::atomic<std::int64_t> minSojourn;
+    std::atomic<bool> overloaded{false};
+};
+
+#endif
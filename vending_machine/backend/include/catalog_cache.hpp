@@ -0,0 +1,35 @@
+#ifndef CATALOG_CACHE_HPP
+#define CATALOG_CACHE_HPP
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "vending_machine.h"
+
+// Serialized /api/items body, rebuilt only when the catalog version moves.
+// Readers share one immutable entry, so a poll that finds the catalog
+// unchanged costs a version check and a copy of the cached bytes.
+class CatalogCache {
+public:
+    struct Entry {
+        std::uint64_t version;
+        std::string etag;
+        std::string body;
+    };
+
+    explicit CatalogCache(const VendingMachine& machine);
+
+    std::shared_ptr<const Entry> get();
+
+    // Builds the JSON listing directly, bypassing the cache.
+    static std::string serialize(const VendingMachine& machine);
+
+private:
+    const VendingMachine& machine;
+    std::mutex rebuildMtx;
+    // Only touched through std::atomic_load/std::atomic_store.
+    std::shared_ptr<const Entry> current;
+};
+
+#endif
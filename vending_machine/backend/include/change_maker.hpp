@@ -0,0 +1,159 @@
+#ifndef CHANGE_MAKER_HPP
+#define CHANGE_MAKER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "money.hpp"
+#include "payment.hpp"
+
+// How many coins or bills of one denomination.
+struct CoinCount {
+    Money denomination;
+    int count = 0;
+};
+// Largest denomination first; denominations not used are left out.
+using ChangeBreakdown = std::vector<CoinCount>;
+
+// Fewest-coins change for a fixed set of denominations. The optimal
+// breakdown of every amount below tableCents() is precomputed once, so with
+// enough coins in stock an answer is one table row: O(denominations). Only
+// when the stock cannot cover that row does makeChange() fall back to a
+// bounded-knapsack search over the coins actually available.
+class ChangeMaker {
+public:
+    // Denominations in any order; must include 1 cent so every amount can
+    // be paid out given enough coins.
+    explicit ChangeMaker(std::vector<Money> denominations);
+
+    // US coins and bills from 1 cent to $20, shared by every machine.
+    static const ChangeMaker& standard();
+
+    std::size_t denominationCount() const;
+    // Index 0 is the smallest denomination.
+    Money denomination(std::size_t index) const;
+    std::int64_t tableCents() const;
+
+    // Writes the fewest-coins breakdown of `cents` (not negative) with
+    // unlimited coins into `counts` (one entry per denomination).
+    void split(std::int64_t cents, int* counts) const;
+    // Same, but using at most `stock[i]` coins of denomination i. Returns
+    // false, leaving `counts` unspecified, if the amount cannot be paid.
+    bool makeChange(std::int64_t cents, const int* stock, int* counts) const;
+    // The bounded search alone, bypassing the table; exposed for checking
+    // and benchmarking the fast path against it.
+    bool searchChange(std::int64_t cents, const int* stock, int* counts) const;
+
+private:
+    // Amounts above this are never searched exhaustively; past it the
+    // largest coins available are taken first.
+    static constexpr std::int64_t kSearchLimitCents = 100000;
+
+    bool greedyChange(std::int64_t cents, const int* stock, int* counts) const;
+
+    std::vector<std::int64_t> cents;
+    std::int64_t limit;
+    // Row a holds the optimal count of each denomination for amount a.
+    std::vector<std::uint16_t> table;
+};
+
+// What one call did to one denomination of a CoinInventory: `stock` pieces
+// into (or out of) the machine and `setAside` into (or out of) the calling
+// session's share. Changes made on behalf of a session are journaled as
+// these deltas; they add up in any order, so recovery reproduces the coins
+// however concurrent calls interleaved in the journal.
+struct CoinDelta {
+    // Index into the inventory's ChangeMaker.
+    std::uint8_t denomination = 0;
+    std::int32_t stock = 0;
+    std::int32_t setAside = 0;
+};
+using CoinDeltas = std::vector<CoinDelta>;
+
+// Thrown when the coins in stock cannot pay out an amount exactly.
+class ChangeUnavailable : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// A machine's coins and bills. Money goes in one coin or bill at a time.
+// Every session's balance is backed by coins set aside for it, so paying
+// it out never depends on what other sessions took meanwhile; the rest of
+// the stock is free. One mutex covers the counts: change is rare next to
+// stock reads, and a payout has to take several denominations at once.
+class CoinInventory {
+public:
+    explicit CoinInventory(int floatPerDenomination = 0, const ChangeMaker& maker = ChangeMaker::standard());
+
+    // Adds one coin or bill to the free stock. Throws std::invalid_argument
+    // for an amount that is not a denomination the machine handles.
+    void deposit(Money amount);
+    // Adds `count` pieces of `denomination`; a negative count takes free
+    // pieces away. Throws std::invalid_argument for a denomination the
+    // machine does not handle. The calls taking `deltas` append what they
+    // changed to it when it is not null.
+    void refill(Money denomination, int count, CoinDeltas* deltas = nullptr);
+    bool canMakeChange(Money amount) const;
+    // Takes the fewest free coins that add up to `amount`, or nothing and
+    // std::nullopt if the free stock cannot make it.
+    std::optional<ChangeBreakdown> dispense(Money amount);
+
+    // The session calls below change `account`, the session's balance,
+    // under the stock lock, so a balance and its coins always move together.
+
+    // Adds one coin or bill, set aside for `session`, and credits it. Throws
+    // std::invalid_argument, crediting nothing, as deposit() does.
+    void deposit(const std::string& session, CashPayment& account, Money amount, CoinDeltas* deltas = nullptr);
+    // Debits `price` if the balance covers it and the change then owed can
+    // be made from the session's coins and the free stock. That change is
+    // set aside for the session and the rest of its coins freed. Returns
+    // false, changing nothing, otherwise.
+    bool charge(const std::string& session, CashPayment& account, Money price, CoinDeltas* deltas = nullptr);
+    // Pays out the session's whole balance, zeroing it, and returns the
+    // coins. A balance with no coins behind it, such as one restored from
+    // an old snapshot, is made from the free stock. Throws ChangeUnavailable,
+    // changing nothing, if the coins cannot make it.
+    ChangeBreakdown payOut(const std::string& session, CashPayment& account, Money& amount,
+                           CoinDeltas* deltas = nullptr);
+    // Re-applies deltas recorded for `session`, as recovery replays them.
+    // Throws std::runtime_error for a denomination the machine lacks.
+    void apply(const std::string& session, const CoinDeltas& deltas);
+
+    // Counts per denomination, smallest first, as snapshots store them.
+    struct State {
+        std::vector<int> stock;
+        std::unordered_map<std::string, std::vector<int>> setAside;
+    };
+    State state() const;
+    // Replaces all counts. Throws std::runtime_error if the state has a
+    // different number of denominations.
+    void restore(State state);
+    // Every denomination with its count, largest first.
+    ChangeBreakdown stock() const;
+    const ChangeMaker& changeMaker() const;
+
+    // Turns per-denomination counts into a breakdown.
+    static ChangeBreakdown breakdown(const ChangeMaker& maker, const int* counts);
+
+private:
+    // Index of `amount`'s denomination, or SIZE_MAX.
+    std::size_t denominationIndex(Money amount) const;
+    // Needs mtx. Free pieces plus those set aside for `mine`, if any.
+    void available(const std::vector<int>* mine, int* pool) const;
+    static void record(CoinDeltas* deltas, std::size_t denomination, int stock, int setAside);
+
+    const ChangeMaker& maker;
+    mutable std::mutex mtx;
+    // Every piece in the machine, free or set aside.
+    std::vector<int> counts;
+    // Pieces set aside for all sessions together, and for each session
+    // whose balance is not zero.
+    std::vector<int> reserved;
+    std::unordered_map<std::string, std::vector<int>> setAside;
+};
+
+#endif
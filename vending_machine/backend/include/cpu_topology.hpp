@@ -0,0 +1,33 @@
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include <string>
+#include <vector>
+
+// How server threads are pinned to CPUs.
+enum class Pinning {
+    // Left to the scheduler.
+    None,
+    // Thread i on the i-th allowed CPU, filling one NUMA node before the
+    // next, so a small pool shares one node's caches and memory.
+    Compact,
+    // Thread i alternating between NUMA nodes, so a pool spreads over every
+    // node's memory bandwidth.
+    Spread,
+};
+
+// Parses "none", "compact" or "spread"; throws std::invalid_argument.
+Pinning parsePinning(const std::string& name);
+
+// CPUs this process may run on, grouped by NUMA node (one group when the
+// node layout is unknown).
+std::vector<std::vector<int>> numaNodes();
+
+// The CPU for each successive thread under `pinning`; empty for None or
+// where pinning is not supported. Thread i goes on order[i % size].
+std::vector<int> pinningOrder(Pinning pinning);
+
+// Pins the calling thread to `cpu`; false where that is not supported.
+bool pinCurrentThread(int cpu);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work the executor can run, such as an actor with messages
+// waiting. A task may be scheduled again once its run() has started.
+class Task {
+public:
+    virtual ~Task() = default;
+    virtual void run() = 0;
+};
+
+struct ExecutorOptions {
+    // Zero starts one worker per hardware thread.
+    std::size_t threads = 0;
+    // Pins worker i to core i modulo the core count (Linux only).
+    bool pinThreads = true;
+};
+
+// Work-stealing thread pool. Every worker owns a run queue: tasks scheduled
+// from a worker go on its own queue, tasks from other threads are spread
+// round-robin. A worker takes from the front of its queue and, when that is
+// empty, steals from the back of the others before going to sleep.
+class Executor {
+public:
+    explicit Executor(ExecutorOptions options = ExecutorOptions());
+    // Runs every task still queued, then stops the workers.
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    void schedule(Task* task);
+    std::size_t threadCount() const;
+    // Tasks a worker took from another worker's queue.
+    std::uint64_t steals() const;
+    // Tasks scheduled but not yet started, over all workers.
+    std::size_t queuedTasks() const;
+
+private:
+    struct alignas(64) Worker {
+        std::mutex mtx;
+        std::deque<Task*> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    Task* take(std::size_t index);
+
+    std::unique_ptr<Worker[]> workers;
+    std::size_t workerCount;
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> nextWorker{0};
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> sleepers{0};
+    std::atomic<std::uint64_t> stealCount{0};
+    std::mutex idleMtx;
+    std::condition_variable idleCv;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef FLEET_HPP
+#define FLEET_HPP
+
+#include <atomic>
+#include <string>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include "machine_actor.hpp"
+#include "vending_machine.h"
+
+// How machines created by the fleet are sized. A fleet holds many machines
+// that each see little traffic, so they default to a single shard, no log
+// queue and a bounded history.
+struct FleetOptions {
+    std::size_t registryShards = 64;
+    std::size_t inventoryShards = 1;
+    std::size_t sessionShards = 1;
+    std::size_t logQueueCapacity = 0;
+    std::size_t historyRetention = 4096;
+    // Coins of each denomination a new machine starts with. Negative leaves
+    // coins untracked, so change is unlimited.
+    int coinFloat = -1;
+    // Most machines the fleet will host; zero for no limit. Machines are
+    // never removed, so this bounds the fleet's memory.
+    std::size_t maxMachines = 0;
+};
+
+// Thrown when adding a machine to a fleet that already holds
+// FleetOptions::maxMachines.
+class FleetFull : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Registry of the vending machines hosted by one process, keyed by machine
+// id. Machines lock their own state, so requests to different machines only
+// meet on a registry shard lock, and only when a machine is being added.
+// Given an executor, the fleet also runs every machine as a MachineActor on
+// it; the executor must outlive the fleet.
+class Fleet {
+public:
+    explicit Fleet(FleetOptions options = FleetOptions(), Executor* executor = nullptr);
+
+    // Builds a machine with the fleet's options without registering it.
+    std::unique_ptr<VendingMachine> createMachine() const;
+    // Creates machine `id` with the fleet's options if it does not exist
+    // yet. Returns the machine either way. Throws FleetFull if it would
+    // exceed the fleet's limit.
+    VendingMachine& addMachine(const std::string& id);
+    // Hosts an already constructed machine under `id`. Throws
+    // std::invalid_argument if the id is taken, FleetFull as above.
+    VendingMachine& addMachine(const std::string& id, std::unique_ptr<VendingMachine> machine);
+    // Machines are never removed, so the pointer stays valid. Null when no
+    // machine has that id.
+    VendingMachine* find(const std::string& id) const;
+    // The machine together with its actor, if the fleet has an executor.
+    std::optional<MachineHandle> handle(const std::string& id) const;
+    std::size_t size() const;
+    // Visits every machine; shards are locked one at a time.
+    template <typename Visitor>
+    void forEach(Visitor&& visit) const;
+    // Same, with each machine's handle, for visits that change machines.
+    template <typename Visitor>
+    void forEachHandle(Visitor&& visit) const;
+
+private:
+    struct Entry {
+        std::unique_ptr<VendingMachine> machine;
+        // Declared last so it stops before its machine is destroyed.
+        std::unique_ptr<MachineActor> actor;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<std::string, Entry> machines;
+    };
+
+    Shard& shardFor(const std::string& id) const;
+    Entry makeEntry(std::unique_ptr<VendingMachine> machine) const;
+    // Counts a machine about to be added against the limit, or throws
+    // FleetFull; an add that does not happen gives its place back.
+    void claim();
+    void unclaim();
+
+    FleetOptions options;
+    Executor* executor;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<std::size_t> claimed{0};
+};
+
+template <typename Visitor>
+void Fleet::forEach(Visitor&& visit) const {
+    for (std::size_t i = 0; i < options.registryShards; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mtx);
+        for (const auto& [id, entry] : shards[i].machines) {
+            visit(id, *entry.machine);
+        }
+    }
+}
+
+template <typename Visitor>
+void Fleet::forEachHandle(Visitor&& visit) const {
+    for (std::size_t i = 0; i < options.registryShards; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mtx);
+        for (const auto& [id, entry] : shards[i].machines) {
+            visit(id, MachineHandle(*entry.machine, entry.actor.get()));
+        }
+    }
+}
+
+#endif
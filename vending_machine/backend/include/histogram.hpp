@@ -0,0 +1,100 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into kSubBuckets / 2 linear buckets, so any recorded value is known
+// to within 1/64 of itself across the full 64-bit range, in a fixed ~3.6k
+// counters. Recording is a couple of shifts and an increment. Not
+// thread-safe: keep one per thread and merge() them.
+class Histogram {
+public:
+    static constexpr unsigned kSubBucketBits = 7;
+    static constexpr std::uint64_t kSubBuckets = std::uint64_t(1) << kSubBucketBits;
+    static constexpr std::size_t kBucketCount = kSubBuckets + (64 - kSubBucketBits) * (kSubBuckets / 2);
+
+    Histogram() : counts(kBucketCount, 0) {}
+
+    static std::size_t bucketOf(std::uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        const unsigned msb = highestBit(value);
+        const unsigned shift = msb - (kSubBucketBits - 1);
+        const std::uint64_t sub = value >> shift;
+        return static_cast<std::size_t>(kSubBuckets + (shift - 1) * (kSubBuckets / 2) + (sub - kSubBuckets / 2));
+    }
+
+    // Largest value that lands in `bucket`.
+    static std::uint64_t bucketUpperBound(std::size_t bucket) {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        const std::uint64_t j = bucket - kSubBuckets;
+        const unsigned shift = static_cast<unsigned>(j / (kSubBuckets / 2)) + 1;
+        const std::uint64_t sub = j % (kSubBuckets / 2) + kSubBuckets / 2;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(std::uint64_t value) {
+        ++counts[bucketOf(value)];
+        ++total;
+        sum += value;
+        maxValue = std::max(maxValue, value);
+    }
+
+    void merge(const Histogram& other) {
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    std::uint64_t count() const { return total; }
+    std::uint64_t max() const { return maxValue; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+
+    // Value at quantile `q` (0..1), to bucket precision and never above max().
+    std::uint64_t percentile(double q) const {
+        if (total == 0) {
+            return 0;
+        }
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * total + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    // Index of the highest set bit; `value` must not be zero.
+    static unsigned highestBit(std::uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+    }
+
+private:
+    std::vector<std::uint64_t> counts;
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t maxValue = 0;
+};
+
+#endif
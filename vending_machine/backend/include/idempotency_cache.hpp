@@ -0,0 +1,90 @@
+#ifndef IDEMPOTENCY_CACHE_HPP
+#define IDEMPOTENCY_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ApiResponse;
+
+struct IdempotencyCacheOptions {
+    // Keys and stored responses are evicted beyond roughly this many bytes.
+    std::size_t capacityBytes = 16 * 1024 * 1024;
+    std::size_t shards = 16;
+};
+
+// Remembers the response to each request made with an Idempotency-Key, so
+// a client retrying after a timeout gets the original answer instead of
+// paying or dispensing twice. Keys are spread over shards, each with its
+// own lock, hash index and CLOCK ring: a hit sets the entry's reference
+// bit, and eviction sweeps the ring clearing bits until it finds an entry
+// nobody asked for since the last sweep. Every operation is O(1) amortized.
+// Keys still in progress count against the budget but cannot be evicted,
+// so once they fill a shard new keys are refused until some complete.
+class IdempotencyCache {
+public:
+    enum class Outcome {
+        // The caller owns the key and must complete() or abandon() it.
+        Started,
+        // `replay` holds the stored response.
+        Replayed,
+        // The first request with this key is still being handled.
+        InProgress,
+        // The key was used before for a request with another body.
+        Mismatch,
+        // Requests still in progress take up the shard's whole budget; the
+        // request must not run.
+        Full,
+    };
+
+    explicit IdempotencyCache(IdempotencyCacheOptions options = IdempotencyCacheOptions());
+
+    IdempotencyCache(const IdempotencyCache&) = delete;
+    IdempotencyCache& operator=(const IdempotencyCache&) = delete;
+
+    // `fingerprint` identifies the request body.
+    Outcome begin(const std::string& key, std::uint64_t fingerprint, std::shared_ptr<const ApiResponse>& replay);
+    // Stores the response for a key begin() returned Started for.
+    void complete(const std::string& key, std::shared_ptr<const ApiResponse> response);
+    // Forgets a started key so the next request with it runs again.
+    void abandon(const std::string& key);
+
+    std::size_t size() const;
+    std::size_t bytes() const;
+    std::uint64_t evictions() const { return evicted.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::string key;
+        std::uint64_t fingerprint = 0;
+        // Null while the first request is in progress.
+        std::shared_ptr<const ApiResponse> response;
+        std::size_t bytes = 0;
+        bool used = false;
+        bool referenced = false;
+    };
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, std::size_t> index;
+        std::vector<Slot> ring;
+        std::vector<std::size_t> freeSlots;
+        std::size_t hand = 0;
+        std::size_t bytes = 0;
+    };
+
+    Shard& shardFor(const std::string& key);
+    void release(Shard& shard, std::size_t slot);
+    // Returns whether `needed` more bytes now fit the budget.
+    bool evictFor(Shard& shard, std::size_t needed);
+
+    const std::size_t shardCapacity;
+    std::vector<Shard> shards;
+    std::atomic<std::uint64_t> evicted{0};
+};
+
+#endif
@@ -2,19 +2,267 @@
 #define INVENTORY_HPP
 
 #include <string>
-#include <map>
+#include <array>
+#include <memory>
+#include <functional>
+#include <string_view>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include "money.hpp"
+#include "item.hpp"
+#include "mpsc_queue.hpp"
+#include "sku_table.hpp"
 
+// One entry of a multi-item order.
+struct CartLine {
+    std::string name;
+    int quantity = 1;
+};
+
+// Current stock of an item reported by the change feed.
+struct ItemChange {
+    std::uint32_t id;
+    int quantity;
+};
+
+// The catalog is split across independently locked shards, each stored as
+// parallel arrays (structure of arrays) indexed by a dense slot number. The
+// shard lock only guards the shape of the arrays (adding items); stock lives
+// in atomics, so purchases of different items never serialize on one mutex,
+// and full-catalog scans walk contiguous columns instead of chasing nodes.
+//
+// Items are keyed by their SkuTable::global() id, which is also the
+// ItemView::id seen by visit(): a lookup hashes and compares integers, never
+// names. The overloads taking a name look its id up first.
 class Inventory {
 public:
-    void addItem(const std::string& name, int quantity, double price);
+    static constexpr std::size_t kDefaultShards = 16;
+
+    // Units and stock value (units x price) of one item type.
+    struct TypeStock {
+        std::size_t skus = 0;
+        std::int64_t units = 0;
+        Money value;
+    };
+    using StockByType = std::array<TypeStock, kItemTypeCount>;
+
+    explicit Inventory(std::size_t shardCount = kDefaultShards);
+
+    // Adds an item, or replaces the stock, price, type and attribute of an
+    // existing item with the same name.
+    void addItem(const Item& item);
+    // Bulk load used by recovery: items are bucketed by shard and every
+    // shard is filled by its own worker under a single lock acquisition.
+    // Names returned by `itemAt` must stay valid until load() returns;
+    // `itemAt` may run on several threads, and what it throws is rethrown.
+    void load(std::size_t count, const std::function<ItemView(std::size_t)>& itemAt);
     bool purchaseItem(const std::string& name);
+    // Takes one unit and hands its price to `charge` within a single lookup.
+    // If `charge` returns false the unit is put back on the same slot.
+    template <typename Charge>
+    bool purchaseItem(std::uint32_t sku, Charge&& charge);
+    template <typename Charge>
+    bool purchaseItem(const std::string& name, Charge&& charge);
+    // All-or-nothing checkout: takes every line's units, then hands the
+    // order total to `charge` once. If a line is short or `charge` returns
+    // false, every unit taken is put back. On success `unitPrices[i]` is the
+    // price line i was sold at. The shards involved stay read-locked for the
+    // whole checkout, so prices cannot change halfway.
+    template <typename Charge>
+    bool purchaseItems(const std::vector<CartLine>& cart, std::vector<Money>& unitPrices, Charge&& charge);
     void refillItem(const std::string& name, int quantity);
-    std::map<std::string, std::pair<int, double>> getItems();
+    void refillItem(std::uint32_t sku, int quantity);
+    // Reservations. reserve() moves units from the item's stock to its
+    // reserved count, where purchases cannot take them; false if the item
+    // is unknown or short. release() moves them back. confirmReserved()
+    // hands the unit price to `charge` and, if it returns true, drops the
+    // units from the reserved count as sold.
+    bool reserve(std::uint32_t sku, int quantity);
+    void release(std::uint32_t sku, int quantity);
+    template <typename Charge>
+    bool confirmReserved(std::uint32_t sku, int quantity, Charge&& charge);
+    // Calls `visitor` with every item, shard by shard, in no particular
+    // order. Each shard is read-locked while it is visited.
+    template <typename Visitor>
+    void visit(Visitor&& visitor) const;
+    std::size_t size() const;
+    StockByType stockByType() const;
+    // Grows after every stock or price change; equal versions mean an
+    // unchanged catalog.
+    std::uint64_t getVersion() const;
+
+    // Shard lock acquisitions that found the lock taken and had to wait,
+    // and how long they waited in total. Uncontended acquisitions only pay
+    // for a try-lock.
+    struct LockWaits {
+        std::uint64_t count = 0;
+        std::uint64_t nanos = 0;
+    };
+    LockWaits lockWaits() const;
+
+    // Change feed: once enabled, every stock change queues the item's SKU
+    // id on a lock-free ring of `capacity`
+    // entries. Enable it before the inventory is shared between threads.
+    void enableChangeFeed(std::size_t capacity);
+    // Single consumer. Appends the current stock of every item changed
+    // since the last call, once per item. Returns false when the feed
+    // cannot describe what changed (the ring overflowed, or items were
+    // added or reloaded) and the whole catalog should be re-read instead.
+    bool drainChanges(std::vector<ItemChange>& out);
 
 private:
-    std::map<std::string, std::pair<int, double>> items;
-    std::mutex mtx;
+    static constexpr std::size_t kNotFound = SIZE_MAX;
+
+    // Each shard counts its own changes so purchases never write a shared
+    // cache line; the catalog version is the sum over shards.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::size_t count = 0;
+        std::size_t capacity = 0;
+        std::unique_ptr<std::atomic<int>[]> quantities;
+        std::unique_ptr<std::atomic<int>[]> reserved;
+        std::vector<std::int64_t> priceCents;
+        std::vector<ItemType> types;
+        std::vector<std::int32_t> attributes;
+        std::vector<std::uint32_t> skus;
+        // Open addressing with linear probing, at most half full. Entries are
+        // (sku << 32) | (slot + 1); zero marks an empty bucket.
+        std::vector<std::uint64_t> index;
+        unsigned indexShift = 64;
+        std::atomic<std::uint64_t> version{0};
+        mutable std::atomic<std::uint64_t> waits{0};
+        mutable std::atomic<std::uint64_t> waitNanos{0};
+
+        std::size_t home(std::uint32_t sku) const;
+        std::size_t find(std::uint32_t sku) const;
+        // Returns the slot for `sku`, appending an empty one if needed.
+        // Requires the exclusive lock.
+        std::size_t findOrInsert(std::uint32_t sku);
+        void reserve(std::size_t items);
+        void rehash(std::size_t buckets);
+    };
+
+    static std::shared_lock<std::shared_mutex> lockShared(const Shard& shard);
+    static std::unique_lock<std::shared_mutex> lockExclusive(Shard& shard);
+    // Slow paths of the two above: block, then record the wait.
+    static void waitShared(std::shared_lock<std::shared_mutex>& lock, const Shard& shard);
+    static void waitExclusive(std::unique_lock<std::shared_mutex>& lock, Shard& shard);
+    Shard& shardFor(std::uint32_t sku) const;
+    void assign(Shard& shard, std::size_t slot, const ItemView& item);
+    // Stock taken for a checkout, line by line, with the locks that keep
+    // its slots in place.
+    struct CartHold {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        std::vector<std::pair<Shard*, std::size_t>> slots;
+    };
+
+    static bool take(std::atomic<int>& quantity, int count);
+    bool takeCart(const std::vector<CartLine>& cart, CartHold& hold);
+    void putBack(const std::vector<CartLine>& cart, const CartHold& hold);
+
+    static void bumpVersion(Shard& shard);
+    // bumpVersion() plus a change feed entry for the slot.
+    void changed(Shard& shard, std::size_t slot);
+    // Tells the feed consumer to re-read everything.
+    void requestResync();
+
+    std::size_t shardCount;
+    std::unique_ptr<Shard[]> shards;
+    std::unique_ptr<MpscQueue<std::uint32_t>> feed;
+    std::atomic<bool> resync{false};
+    std::vector<std::uint32_t> feedScratch;
 };
 
-#endif
\ No newline at end of file
+inline std::shared_lock<std::shared_mutex> Inventory::lockShared(const Shard& shard) {
+    std::shared_lock<std::shared_mutex> lock(shard.mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        waitShared(lock, shard);
+    }
+    return lock;
+}
+
+inline std::unique_lock<std::shared_mutex> Inventory::lockExclusive(Shard& shard) {
+    std::unique_lock<std::shared_mutex> lock(shard.mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        waitExclusive(lock, shard);
+    }
+    return lock;
+}
+
+template <typename Charge>
+bool Inventory::purchaseItem(const std::string& name, Charge&& charge) {
+    const std::uint32_t sku = SkuTable::global().find(name);
+    return sku != SkuTable::kNone && purchaseItem(sku, std::forward<Charge>(charge));
+}
+
+template <typename Charge>
+bool Inventory::purchaseItem(std::uint32_t sku, Charge&& charge) {
+    Shard& shard = shardFor(sku);
+    auto lock = lockShared(shard);
+    const std::size_t slot = shard.find(sku);
+    if (slot == kNotFound || !take(shard.quantities[slot], 1)) {
+        return false;
+    }
+    changed(shard, slot);
+    if (!charge(Money::fromCents(shard.priceCents[slot]))) {
+        shard.quantities[slot].fetch_add(1, std::memory_order_acq_rel);
+        changed(shard, slot);
+        return false;
+    }
+    return true;
+}
+
+template <typename Charge>
+bool Inventory::purchaseItems(const std::vector<CartLine>& cart, std::vector<Money>& unitPrices, Charge&& charge) {
+    CartHold hold;
+    if (!takeCart(cart, hold)) {
+        return false;
+    }
+    unitPrices.clear();
+    Money total;
+    for (std::size_t i = 0; i < cart.size(); ++i) {
+        const auto& [shard, slot] = hold.slots[i];
+        unitPrices.push_back(Money::fromCents(shard->priceCents[slot]));
+        total += unitPrices.back() * cart[i].quantity;
+    }
+    if (!charge(total)) {
+        putBack(cart, hold);
+        return false;
+    }
+    return true;
+}
+
+template <typename Charge>
+bool Inventory::confirmReserved(std::uint32_t sku, int quantity, Charge&& charge) {
+    Shard& shard = shardFor(sku);
+    auto lock = lockShared(shard);
+    const std::size_t slot = shard.find(sku);
+    if (slot == kNotFound || shard.reserved[slot].load(std::memory_order_acquire) < quantity ||
+        !charge(Money::fromCents(shard.priceCents[slot]))) {
+        return false;
+    }
+    shard.reserved[slot].fetch_sub(quantity, std::memory_order_acq_rel);
+    changed(shard, slot);
+    return true;
+}
+
+template <typename Visitor>
+void Inventory::visit(Visitor&& visitor) const {
+    const SkuTable& table = SkuTable::global();
+    for (std::size_t s = 0; s < shardCount; ++s) {
+        const Shard& shard = shards[s];
+        auto lock = lockShared(shard);
+        for (std::size_t i = 0; i < shard.count; ++i) {
+            visitor(ItemView{table.name(shard.skus[i]), Money::fromCents(shard.priceCents[i]),
+                             shard.quantities[i].load(std::memory_order_relaxed),
+                             shard.types[i], shard.attributes[i], shard.skus[i],
+                             shard.reserved[i].load(std::memory_order_relaxed)});
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef INVENTORY_STREAM_HPP
+#define INVENTORY_STREAM_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vending_machine.h"
+
+struct InventoryStreamOptions {
+    // How often the publisher drains the change feed; changes within one
+    // interval go out as a single event.
+    std::chrono::milliseconds interval{50};
+    // Events kept for subscribers that fall behind; a subscriber further
+    // back than this is told to resync instead.
+    std::size_t history = 256;
+    // Change feed ring size; an overflow also turns into a resync.
+    std::size_t feedCapacity = 1 << 16;
+};
+
+// Fans inventory changes out to Server-Sent Events subscribers. A single
+// publisher thread drains the machine's change feed and serializes one
+// event per batch; every subscriber is handed the same immutable string,
+// so a change costs one serialization however many clients listen.
+//
+// Events, in SSE framing:
+//   event: delta   data: {"version":V,"items":[[id,quantity],...]}
+//   event: resync  data: {"version":V}  (re-read /api/items)
+class InventoryStream {
+public:
+    using Event = std::shared_ptr<const std::string>;
+
+    // Enables the machine's change feed, so construct this before the
+    // machine is shared between threads.
+    explicit InventoryStream(VendingMachine& machine, InventoryStreamOptions options = InventoryStreamOptions());
+    ~InventoryStream();
+
+    InventoryStream(const InventoryStream&) = delete;
+    InventoryStream& operator=(const InventoryStream&) = delete;
+
+    // Sequence number of the newest event; new subscribers start after it.
+    std::uint64_t latest() const;
+    // First event for a new subscriber: a resync carrying the current
+    // catalog version.
+    std::string hello() const;
+    // Waits up to `timeout` for events after `after`, appends them to `out`
+    // and moves `after` past them. Returns false once the stream stops.
+    bool wait(std::uint64_t& after, std::chrono::milliseconds timeout, std::vector<Event>& out);
+
+private:
+    void run();
+    void publish(std::string event);
+    std::string resyncEvent() const;
+
+    VendingMachine& machine;
+    InventoryStreamOptions options;
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    // events.back() has sequence number `sequence`.
+    std::deque<Event> events;
+    std::uint64_t sequence = 0;
+    bool stopping = false;
+    std::thread publisher;
+};
+
+#endif
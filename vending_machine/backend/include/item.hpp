@@ -0,0 +1,52 @@
+#ifndef ITEM_HPP
+#define ITEM_HPP
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "money.hpp"
+
+// Stored as a one-byte tag next to each catalog entry.
+enum class ItemType : std::uint8_t {
+    Item = 0,
+    Beverage = 1,
+    Snack = 2,
+};
+
+constexpr std::size_t kItemTypeCount = 3;
+
+const char* itemTypeName(ItemType type);
+
+// A catalog entry passed by value. `attribute` depends on the type: volume
+// in ml for beverages, weight in grams for snacks, unused otherwise.
+struct Item {
+    std::string name;
+    Money price;
+    int quantity = 0;
+    ItemType type = ItemType::Item;
+    std::int32_t attribute = 0;
+    // Set on items read back from an inventory; ignored when adding.
+    std::uint32_t id = 0;
+    // Units set aside by reservations, on top of `quantity`; read back only.
+    int reserved = 0;
+
+    static Item beverage(std::string name, Money price, int quantity, std::int32_t volumeMl);
+    static Item snack(std::string name, Money price, int quantity, std::int32_t weightGrams);
+};
+
+// A catalog entry read in place. `name` points into the catalog and is only
+// valid while the visiting callback runs.
+struct ItemView {
+    std::string_view name;
+    Money price;
+    int quantity;
+    ItemType type;
+    std::int32_t attribute;
+    // Inventory::visit fills in the item's SKU id and reserved units; zero
+    // elsewhere.
+    std::uint32_t id = 0;
+    int reserved = 0;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include "money.hpp"
+#include "item.hpp"
+#include "change_maker.hpp"
+
+enum class JournalRecordType : std::uint8_t {
+    Purchase = 1,
+    AddItem = 2,
+    RefillItem = 3,
+    InsertMoney = 4,
+    ReturnChange = 5,
+    // Opens a group of the next `quantity` records, which read() delivers
+    // all together or not at all.
+    Group = 6,
+    // A change to the coin stock alone; `amount` is the denomination.
+    RefillCoins = 7,
+};
+
+// One logged mutation. Unused fields stay at their defaults.
+struct JournalRecord {
+    JournalRecordType type = JournalRecordType::Purchase;
+    std::uint64_t lsn = 0;
+    std::int64_t timestamp = 0;
+    std::string item;
+    std::string session;
+    Money amount;
+    std::int32_t quantity = 0;
+    // Only set on AddItem records.
+    ItemType itemType = ItemType::Item;
+    std::int32_t attribute = 0;
+    // What the change did to the machine's coins, for `session`.
+    CoinDeltas coins;
+};
+
+struct JournalOptions {
+    std::string path;
+    // How long the flusher waits for more records before writing a batch
+    // that is not yet full. Zero flushes whatever is pending immediately.
+    std::chrono::microseconds flushInterval{0};
+    // A batch is written as soon as it holds this many records.
+    std::size_t maxBatchRecords = 4096;
+    // fdatasync after every batch; turning it off trades durability for speed.
+    bool sync = true;
+};
+
+// Thrown once the journal has failed to write or rotate. The failure is
+// permanent: every later append, wait or rotate throws it too.
+class JournalFailure : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Append-only binary journal with group commit. Producers encode records into
+// a shared buffer and a single flusher thread writes everything pending with
+// one write + fdatasync, so concurrent commits share the cost of a sync.
+//
+// On-disk record: u32 size, u32 crc32, u64 lsn, u8 type, i64 timestamp,
+// i64 cents, i32 quantity, u16 item length, u16 session length, item bytes,
+// session bytes, then for records with coin deltas (flagged by the top bit
+// of the type) u8 count and per delta u8 denomination, i32 stock, i32 set
+// aside, then for typed items u8 item type and i32 attribute. The crc
+// covers everything after itself; a torn tail is detected and ignored by
+// read(), as is a group whose records did not all make it to disk.
+//
+// rotate() closes the active file as an archived segment named
+// "<path>.<last lsn>" (zero-padded, so names sort in LSN order); once a
+// snapshot covers a segment it can be dropped with removeSegmentsThrough().
+class Journal {
+public:
+    // Longest item name or session id a record can hold; append() throws
+    // std::invalid_argument, queuing nothing, for a longer one.
+    static constexpr std::size_t kMaxNameBytes = UINT16_MAX;
+
+    explicit Journal(JournalOptions options);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Queues a record and returns its log sequence number.
+    std::uint64_t append(JournalRecord record);
+    // Queues `records` as one group with consecutive LSNs and returns the
+    // last one. Recovery replays either the whole group or none of it.
+    std::uint64_t append(const std::vector<JournalRecord>& records);
+    // Blocks until every record up to `lsn` is on disk. Throws JournalFailure
+    // if the batch holding it could not be written.
+    void waitDurable(std::uint64_t lsn);
+    // append() followed by waitDurable().
+    std::uint64_t commit(JournalRecord record);
+
+    std::uint64_t durableLsn() const;
+    std::uint64_t batchesWritten() const;
+    // True once a write or rotation has failed. Lock-free, for callers that
+    // check before every change.
+    bool failed() const;
+    const std::string& path() const;
+
+    // Waits for everything pending to reach disk, archives the active file
+    // and starts a new one. Returns the last LSN in the archived segment.
+    std::uint64_t rotate();
+    // Deletes archived segments that only hold records up to `lsn`.
+    void removeSegmentsThrough(std::uint64_t lsn);
+    // Numbers future records after `lsn`; used once a snapshot taken at
+    // `lsn` has been restored and its segments may already be gone.
+    void advancePast(std::uint64_t lsn);
+
+    // Calls `visit` for every intact record in the archived segments and
+    // the active file, in LSN order, and returns the last LSN seen (zero for
+    // an empty or missing journal). Group markers are not visited, and the
+    // records of an incomplete group are skipped.
+    template <typename Visitor>
+    static std::uint64_t read(const std::string& path, Visitor&& visit);
+
+private:
+    // Archived segments in LSN order followed by the active file.
+    static std::vector<std::string> segments(const std::string& path);
+    static std::uint64_t segmentLastLsn(const std::string& path, const std::string& segment);
+    static std::vector<char> load(const std::string& path);
+    static bool decode(const char*& cursor, const char* end, JournalRecord& record);
+    static void checkNames(const JournalRecord& record);
+    static void encode(const JournalRecord& record, std::vector<char>& out);
+    void flushLoop();
+    void writeAll(const std::vector<char>& batch);
+
+    JournalOptions options;
+    int fd;
+
+    mutable std::mutex mtx;
+    std::condition_variable pendingCv;
+    std::condition_variable durableCv;
+    std::vector<char> pending;
+    std::size_t pendingRecords = 0;
+    std::uint64_t nextLsn = 1;
+    std::uint64_t durable = 0;
+    std::atomic<std::uint64_t> batches{0};
+    bool stopping = false;
+    std::string writeError;
+    std::atomic<bool> failure{false};
+
+    std::thread flusher;
+};
+
+template <typename Visitor>
+std::uint64_t Journal::read(const std::string& path, Visitor&& visit) {
+    std::uint64_t last = 0;
+    JournalRecord record;
+    std::vector<JournalRecord> group;
+    std::size_t groupRemaining = 0;
+    for (const auto& segment : segments(path)) {
+        std::vector<char> data = load(segment);
+        const char* cursor = data.data();
+        const char* end = data.data() + data.size();
+        while (decode(cursor, end, record)) {
+            if (record.type == JournalRecordType::Group) {
+                group.clear();
+                groupRemaining = static_cast<std::size_t>(std::max(record.quantity, 0));
+                last = record.lsn;
+                continue;
+            }
+            if (groupRemaining > 0) {
+                group.push_back(record);
+                if (--groupRemaining == 0) {
+                    for (const auto& member : group) {
+                        visit(member);
+                    }
+                    last = record.lsn;
+                }
+                continue;
+            }
+            visit(static_cast<const JournalRecord&>(record));
+            last = record.lsn;
+        }
+    }
+    return last;
+}
+
+#endif
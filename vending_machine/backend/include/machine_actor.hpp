@@ -0,0 +1,153 @@
+#ifndef MACHINE_ACTOR_HPP
+#define MACHINE_ACTOR_HPP
+
+#include <atomic>
+#include <exception>
+#include <future>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "executor.hpp"
+#include "vending_machine.h"
+
+// Runs a VendingMachine as an actor: commands are posted to a lock-free
+// mailbox and executed in order by an Executor worker, never by two threads
+// at once, so the machine's own locks and atomics are never contended.
+// Results come back through futures; exceptions are rethrown by get(). The
+// futures ask() returns are ready once the command's changes are durable;
+// MachineHandle::call() waits for durability off the actor instead.
+class MachineActor : private Task {
+public:
+    // Messages handled per turn before yielding the worker to other actors.
+    static constexpr int kBatch = 64;
+
+    MachineActor(VendingMachine& machine, Executor& executor);
+    // Waits for messages already posted to finish.
+    ~MachineActor() override;
+
+    MachineActor(const MachineActor&) = delete;
+    MachineActor& operator=(const MachineActor&) = delete;
+
+    // Runs `command(machine)` on the actor and returns its result.
+    template <typename Command>
+    auto ask(Command&& command) -> std::future<decltype(command(std::declval<VendingMachine&>()))>;
+
+    std::future<void> insertMoney(const std::string& sessionId, Money amount);
+    std::future<bool> purchaseItem(const std::string& sessionId, const std::string& itemName);
+    std::future<Money> returnChange(const std::string& sessionId);
+    std::future<void> refillItem(const std::string& itemName, int quantity);
+
+    VendingMachine& machine() const;
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+    };
+
+    struct Message : Node {
+        virtual ~Message() = default;
+        virtual void run(VendingMachine& machine) = 0;
+    };
+
+    template <typename Command, typename Result>
+    struct Call : Message {
+        explicit Call(Command command) : command(std::move(command)) {}
+
+        void run(VendingMachine& machine) override {
+            try {
+                if constexpr (std::is_void<Result>::value) {
+                    command(machine);
+                    promise.set_value();
+                } else {
+                    promise.set_value(command(machine));
+                }
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+
+        Command command;
+        std::promise<Result> promise;
+    };
+
+    void post(Message* message);
+    // Mailbox: an intrusive multi-producer/single-consumer list. Producers
+    // swap themselves in at the head; the running actor pops from the tail.
+    void push(Node* node);
+    Message* pop();
+    void run() override;
+
+    VendingMachine& vendingMachine;
+    Executor& executor;
+    std::atomic<Node*> head;
+    Node* tail;
+    Node stub;
+    std::atomic<bool> scheduled{false};
+    std::atomic<int> running{0};
+};
+
+template <typename Command>
+auto MachineActor::ask(Command&& command) -> std::future<decltype(command(std::declval<VendingMachine&>()))> {
+    using Result = decltype(command(std::declval<VendingMachine&>()));
+    auto* call = new Call<std::decay_t<Command>, Result>(std::forward<Command>(command));
+    auto future = call->promise.get_future();
+    post(call);
+    return future;
+}
+
+// A machine reached either directly or through its actor, so request
+// handlers are written once for both execution modes.
+class MachineHandle {
+public:
+    MachineHandle(VendingMachine& machine, MachineActor* actor) : target(machine), actor(actor) {}
+
+    // Runs `command(machine)` on the actor when there is one, otherwise on
+    // the calling thread, and returns its result either way, once the
+    // changes it made are durable. The actor does not wait for the journal
+    // itself: this thread does, so the next message runs meanwhile and its
+    // records join the same group commit.
+    template <typename Command>
+    auto call(Command&& command) -> decltype(command(std::declval<VendingMachine&>())) {
+        using Result = decltype(command(std::declval<VendingMachine&>()));
+        if (!actor) {
+            return command(target);
+        }
+        std::uint64_t lsn = 0;
+        auto deferred = [&command, &lsn](VendingMachine& machine) -> Result {
+            VendingMachine::DeferDurability defer(lsn);
+            return command(machine);
+        };
+        if constexpr (std::is_void<Result>::value) {
+            actor->ask(deferred).get();
+            target.waitDurable(lsn);
+        } else {
+            Result result = actor->ask(deferred).get();
+            target.waitDurable(lsn);
+            return result;
+        }
+    }
+
+    // Like call(), but does not wait for the actor to run it.
+    template <typename Command>
+    void send(Command&& command) {
+        if (actor) {
+            actor->ask(std::forward<Command>(command));
+        } else {
+            command(target);
+        }
+    }
+
+    // For reads only, which bypass the actor even when there is one. The
+    // actor serializes changes so they never contend; the machine keeps its
+    // own locks and atomics regardless, so a read from another thread (the
+    // catalog, coin stock or history) still sees a consistent state and
+    // needs no round trip through the mailbox. Anything that changes the
+    // machine goes through call() or send().
+    VendingMachine& machine() const { return target; }
+
+private:
+    VendingMachine& target;
+    MachineActor* actor;
+};
+
+#endif
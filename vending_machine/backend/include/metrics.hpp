@@ -0,0 +1,165 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "histogram.hpp"
+
+// Instruments are striped and a scrape sums the stripes. A thread leases a
+// stripe of its own on first use and gives it back when it exits; its
+// updates are then a relaxed load and store with no locked instruction.
+// Threads beyond the last private stripe share the final one through
+// relaxed fetch_add.
+namespace metrics_detail {
+
+constexpr std::size_t kStripes = 16;
+
+struct Lease {
+    Lease();
+    ~Lease();
+    std::size_t stripe;
+    bool owned;
+};
+
+inline const Lease& lease() {
+    thread_local const Lease mine;
+    return mine;
+}
+
+inline void bump(std::atomic<std::uint64_t>& cell, std::uint64_t n, bool owned) {
+    if (owned) {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    } else {
+        cell.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace metrics_detail
+
+class Counter {
+public:
+    void add(std::uint64_t n = 1) {
+        const auto& lease = metrics_detail::lease();
+        metrics_detail::bump(cells[lease.stripe].value, n, lease.owned);
+    }
+    std::uint64_t value() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<std::uint64_t> value{0};
+    };
+    std::array<Cell, metrics_detail::kStripes> cells;
+};
+
+// Request latency in microseconds, in log-linear buckets: two per power of
+// two (1, 2, 3, 4, 6, 8, 12, 16, ... us) up to 2^26 us (~67 s), which is
+// within 50% of any latency in ~50 buckets. Slower requests only land in
+// +Inf.
+class LatencyHistogram {
+public:
+    static constexpr std::size_t kBuckets = 52;
+
+    void record(std::chrono::nanoseconds latency) {
+        const auto micros = static_cast<std::uint64_t>(std::max<std::int64_t>(0, latency.count() / 1000));
+        const auto& lease = metrics_detail::lease();
+        Stripe& s = stripes[lease.stripe];
+        metrics_detail::bump(s.buckets[bucketOf(micros)], 1, lease.owned);
+        metrics_detail::bump(s.sumMicros, micros, lease.owned);
+    }
+
+    static std::size_t bucketOf(std::uint64_t micros) {
+        if (micros < 2) {
+            return static_cast<std::size_t>(micros);
+        }
+        const unsigned msb = Histogram::highestBit(micros);
+        const std::size_t bucket = 2 + (msb - 1) * 2 + ((micros >> (msb - 1)) & 1);
+        return std::min(bucket, kBuckets);
+    }
+    // Bucket b holds latencies below this many microseconds.
+    static std::uint64_t bucketLimit(std::size_t bucket);
+
+    struct Snapshot {
+        std::array<std::uint64_t, kBuckets + 1> counts{};
+        std::uint64_t sumMicros = 0;
+    };
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Stripe {
+        // Index kBuckets counts everything past the last bucket.
+        std::array<std::atomic<std::uint64_t>, kBuckets + 1> buckets{};
+        std::atomic<std::uint64_t> sumMicros{0};
+    };
+    std::array<Stripe, metrics_detail::kStripes> stripes;
+};
+
+// Counters by status class and a latency histogram for one route.
+class RouteMetrics {
+public:
+    void observe(int status, std::chrono::nanoseconds elapsed) {
+        const int statusClass = status / 100 - 2;
+        responses[statusClass >= 0 && statusClass < 4 ? statusClass : 3]->add();
+        latency->record(elapsed);
+    }
+
+private:
+    friend class MetricsRegistry;
+    // 2xx, 3xx, 4xx, 5xx.
+    std::array<Counter*, 4> responses{};
+    LatencyHistogram* latency = nullptr;
+};
+
+// Owns every instrument and renders them in the Prometheus text exposition
+// format. Instruments are registered at startup and live as long as the
+// registry; references to them stay valid.
+class MetricsRegistry {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+    // A counter kept elsewhere; `read` is called on every scrape.
+    void counter(const std::string& name, const std::string& help, const Labels& labels,
+                 std::function<double()> read);
+    LatencyHistogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {});
+    // `read` is called on every scrape, so gauges cost nothing in between.
+    void gauge(const std::string& name, const std::string& help, const Labels& labels,
+               std::function<double()> read);
+    // vending_http_requests_total and vending_http_request_duration_seconds
+    // for one method and route pattern.
+    RouteMetrics& route(const std::string& method, const std::string& pattern);
+
+    std::string render() const;
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<LatencyHistogram> histogram;
+        std::function<double()> read;
+    };
+    struct Family {
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::vector<Series> series;
+    };
+
+    void add(const std::string& name, const std::string& help, Kind kind, const Labels& labels, Series series);
+    static std::string formatLabels(const Labels& labels);
+
+    mutable std::mutex mtx;
+    std::vector<Family> families;
+    std::vector<std::unique_ptr<RouteMetrics>> routes;
+};
+
+#endif
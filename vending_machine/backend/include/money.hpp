@@ -0,0 +1,78 @@
+#ifndef MONEY_HPP
+#define MONEY_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+// An exact amount of money stored as integer cents. Doubles only appear at
+// the edges (JSON and display); everything in between adds and compares
+// integers, which also lets balances live in a plain std::atomic<int64_t>.
+class Money {
+public:
+    constexpr Money() : cents(0) {}
+
+    // Largest amount, in either direction, accepted from outside: $10
+    // million. It keeps llround in range and leaves any realistic sum of
+    // amounts far from overflowing.
+    static constexpr std::int64_t kMaxCents = 1'000'000'000;
+
+    static constexpr Money fromCents(std::int64_t cents) { return Money(cents); }
+    // Rounds to the nearest cent. Throws std::invalid_argument for NaN,
+    // infinities and anything beyond kMaxCents.
+    static Money fromDouble(double amount) {
+        if (!std::isfinite(amount) || std::fabs(amount) > kMaxCents / 100.0) {
+            throw std::invalid_argument("Amount out of range");
+        }
+        return Money(std::llround(amount * 100.0));
+    }
+
+    constexpr std::int64_t toCents() const { return cents; }
+    constexpr double toDouble() const { return static_cast<double>(cents) / 100.0; }
+
+    std::string toString() const {
+        char buf[32];
+        std::int64_t magnitude = cents < 0 ? -cents : cents;
+        std::snprintf(buf, sizeof(buf), "%s%lld.%02lld", cents < 0 ? "-" : "",
+                      static_cast<long long>(magnitude / 100),
+                      static_cast<long long>(magnitude % 100));
+        return buf;
+    }
+
+    constexpr Money& operator+=(Money other) { cents += other.cents; return *this; }
+    constexpr Money& operator-=(Money other) { cents -= other.cents; return *this; }
+
+    friend constexpr Money operator-(Money a) { return Money(-a.cents); }
+    friend constexpr Money operator+(Money a, Money b) { return Money(a.cents + b.cents); }
+    friend constexpr Money operator-(Money a, Money b) { return Money(a.cents - b.cents); }
+    friend constexpr Money operator*(Money a, std::int64_t n) { return Money(a.cents * n); }
+    friend constexpr Money operator*(std::int64_t n, Money a) { return Money(a.cents * n); }
+
+    friend constexpr bool operator==(Money a, Money b) { return a.cents == b.cents; }
+    friend constexpr bool operator!=(Money a, Money b) { return a.cents != b.cents; }
+    friend constexpr bool operator<(Money a, Money b) { return a.cents < b.cents; }
+    friend constexpr bool operator<=(Money a, Money b) { return a.cents <= b.cents; }
+    friend constexpr bool operator>(Money a, Money b) { return a.cents > b.cents; }
+    friend constexpr bool operator>=(Money a, Money b) { return a.cents >= b.cents; }
+
+private:
+    explicit constexpr Money(std::int64_t cents) : cents(cents) {}
+
+    std::int64_t cents;
+};
+
+// nlohmann::json picks these up through ADL, so Money serializes as a plain
+// decimal number (1.5) and the frontend sees the same shape as before.
+template <typename BasicJsonType>
+void to_json(BasicJsonType& j, const Money& money) {
+    j = money.toDouble();
+}
+
+template <typename BasicJsonType>
+void from_json(const BasicJsonType& j, Money& money) {
+    money = Money::fromDouble(j.template get<double>());
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+
+// Bounded lock-free multi-producer/single-consumer ring buffer. Every cell
+// carries a sequence number telling producers and the consumer whose turn it
+// is, so a push is one CAS on the tail plus two stores and never blocks.
+// Only one thread may pop at a time.
+template <typename T>
+class MpscQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "queued records must be trivially copyable");
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit MpscQueue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false instead of waiting when the ring is full.
+    bool tryPush(const T& value) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out) {
+        Cell& cell = cells[head & mask];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(head + 1) < 0) {
+            return false;
+        }
+        out = cell.value;
+        cell.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    // Approximate number of queued records; exact when producers are idle.
+    std::size_t size() const {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t h = consumed.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+
+    // Slots producers have claimed so far, filled or not. tryPop stops at a
+    // claimed cell that is not filled yet, so a consumer that must see every
+    // push that has returned pops until popped() reaches this.
+    std::size_t claimed() const { return tail.load(std::memory_order_acquire); }
+    // Records popped so far; consumer only.
+    std::size_t popped() const { return head; }
+
+    // Publishes the consumer position for size(); call after a batch of pops.
+    void publishConsumed() { consumed.store(head, std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::size_t head = 0;
+    std::atomic<std::size_t> consumed{0};
+};
+
+#endif
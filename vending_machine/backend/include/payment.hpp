@@ -2,75 +2,33 @@
 #define PAYMENT_HPP
 
 #include <string>
+#include <atomic>
+#include <cstdint>
+#include "money.hpp"
 
 // Interface for all payment methods
 class IPaymentMethod {
 public:
     virtual ~IPaymentMethod() = default;
-    virtual bool processPayment(double amount) = 0;
+    virtual bool processPayment(Money amount) = 0;
     virtual std::string getPaymentType() const = 0;
 };
 
-// Concrete implementation for cash payment
+// Concrete implementation for cash payment. The balance is an atomic count
+// of cents so one customer's concurrent requests cannot lose updates.
 class CashPayment : public IPaymentMethod {
 public:
-    CashPayment(double initialBalance = 0.0);
-    bool processPayment(double amount) override;
+    CashPayment(Money initialBalance = Money());
+    bool processPayment(Money amount) override;
     std::string getPaymentType() const override;
-    double getBalance() const;
-    void addMoney(double amount);
-    double returnChange();
+    Money getBalance() const;
+    void addMoney(Money amount);
+    Money returnChange();
+    // Applies a signed change without any checks; used when replaying state.
+    void adjustBalance(Money delta);
 
 private:
-    double balance;
-};
-
-// Interface for item types
-class IItem {
-public:
-    virtual ~IItem() = default;
-    virtual std::string getName() const = 0;
-    virtual double getPrice() const = 0;
-    virtual int getQuantity() const = 0;
-    virtual void setQuantity(int quantity) = 0;
-    virtual std::string getType() const = 0;
-};
-
-// Base class for all items
-class BaseItem : public IItem {
-public:
-    BaseItem(const std::string& name, double price, int quantity);
-    std::string getName() const override;
-    double getPrice() const override;
-    int getQuantity() const override;
-    void setQuantity(int quantity) override;
-    std::string getType() const override;
-
-protected:
-    std::string name;
-    double price;
-    int quantity;
-};
-
-// Specific item types
-class Beverage : public BaseItem {
-public:
-    Beverage(const std::string& name, double price, int quantity, int volume);
-    std::string getType() const override;
-    int getVolume() const;
-
-private:
-    int volume; // in ml
-};
-
-class Snack : public BaseItem {
-public:
-    Snack(const std::string& name, double price, int quantity, int weight);
-    std::string getType() const override;
-    int getWeight() const;
-
-private:
-    int weight; // in grams
+    std::atomic<std::int64_t> balanceCents;
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef SESSION_STORE_HPP
+#define SESSION_STORE_HPP
+
+#include <string>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include "payment.hpp"
+
+// Per-customer cash balances keyed by session id. Sessions are spread over
+// hash shards so concurrent customers only meet on a shard lock when a
+// session opens or closes; balance updates themselves are atomic in
+// CashPayment. An account lives only while it holds money or is in use:
+// release() drops one that is back at zero, so session ids that never
+// leave money behind take no memory.
+class SessionStore {
+public:
+    static constexpr std::size_t kDefaultShards = 64;
+
+    explicit SessionStore(std::size_t shardCount = kDefaultShards);
+
+    // Returns the session's account, opening an empty one on first use. The
+    // account stays valid while the pointer is held, even once released.
+    std::shared_ptr<CashPayment> account(const std::string& sessionId);
+    // The session's account, or null if it has none; never opens one.
+    std::shared_ptr<CashPayment> find(const std::string& sessionId) const;
+    // Drops the session's account if its balance is zero and no caller
+    // still holds it.
+    void release(const std::string& sessionId);
+    std::size_t size() const;
+    // Visits every session; shards are locked one at a time.
+    template <typename Visitor>
+    void forEach(Visitor&& visit) const;
+
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<std::string, std::shared_ptr<CashPayment>> accounts;
+    };
+
+    Shard& shardFor(const std::string& sessionId) const;
+
+    std::size_t shardCount;
+    std::unique_ptr<Shard[]> shards;
+};
+
+template <typename Visitor>
+void SessionStore::forEach(Visitor&& visit) const {
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mtx);
+        for (const auto& [id, account] : shards[i].accounts) {
+            visit(id, static_cast<const CashPayment&>(*account));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SKU_TABLE_HPP
+#define SKU_TABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interns item names as dense uint32 SKU ids, from zero. Every inventory,
+// transaction log and hold in the process uses the global table, so an id
+// names the same item on every machine, and a request's item name is
+// resolved once where it enters. Names are never forgotten. Ids depend on
+// the order names were first seen, so anything written to disk keeps the
+// names instead.
+//
+// Lookups are lock-free: the name index is an open-addressing table of
+// atomic entries, and names live in pages that never move. Interning a new
+// name takes a mutex; a full index is copied into one twice the size, and
+// the old one is kept for readers still probing it.
+class SkuTable {
+public:
+    static constexpr std::uint32_t kNone = UINT32_MAX;
+
+    // The table shared by the whole process.
+    static SkuTable& global();
+
+    SkuTable();
+
+    SkuTable(const SkuTable&) = delete;
+    SkuTable& operator=(const SkuTable&) = delete;
+
+    // The name's id, assigned on first sight. Throws std::length_error past
+    // kMaxSkus names.
+    std::uint32_t intern(std::string_view name);
+    // kNone for a name never interned.
+    std::uint32_t find(std::string_view name) const;
+    // `sku` must have come from this table. The view is valid as long as
+    // the table is.
+    std::string_view name(std::uint32_t sku) const {
+        return pages[sku >> kPageBits].load(std::memory_order_acquire)[sku & (kPageSize - 1)];
+    }
+    std::size_t size() const { return count.load(std::memory_order_acquire); }
+    // Grows the index ahead of interning up to `total` names, so a bulk
+    // load copies it at most once.
+    void reserve(std::size_t total);
+
+    static constexpr unsigned kPageBits = 12;
+    static constexpr std::size_t kPageSize = std::size_t(1) << kPageBits;
+    static constexpr std::size_t kMaxPages = 16384;
+    static constexpr std::size_t kMaxSkus = kPageSize * kMaxPages;
+
+private:
+    // At most half full. Entries are (upper hash bits << 32) | (sku + 1);
+    // zero marks an empty bucket.
+    struct Index {
+        explicit Index(std::size_t buckets);
+
+        std::unique_ptr<std::atomic<std::uint64_t>[]> entries;
+        std::size_t mask;
+        unsigned shift;
+    };
+
+    static std::size_t hashName(std::string_view name);
+    std::uint32_t findIn(const Index& index, std::string_view name, std::size_t hash) const;
+    static void insertInto(Index& index, std::size_t hash, std::uint32_t sku);
+    // Replaces the index with one of `buckets`, holding every name so far.
+    void rebuild(std::size_t buckets);
+
+    std::atomic<const Index*> current;
+    std::atomic<std::size_t> count{0};
+    // Slot i of page p names SKU (p << kPageBits) + i.
+    std::unique_ptr<std::atomic<const std::string_view*>[]> pages;
+
+    // Written under writeMtx only.
+    std::mutex writeMtx;
+    std::vector<std::unique_ptr<Index>> indexes;
+    std::vector<std::unique_ptr<std::string_view[]>> ownedPages;
+    std::deque<std::string> names;
+    // Each name's hash, by id, so growing the index rehashes no strings.
+    std::vector<std::size_t> hashes;
+};
+
+#endif
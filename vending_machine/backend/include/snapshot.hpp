@@ -0,0 +1,101 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "money.hpp"
+#include "item.hpp"
+
+// Everything a checkpoint captures. Transactions are reduced to counters;
+// individual records older than the snapshot are not kept.
+struct SnapshotState {
+    struct Session {
+        std::string id;
+        Money balance;
+        // Coins set aside for the session, per denomination; empty for none.
+        std::vector<int> setAside;
+    };
+
+    std::uint64_t lsn = 0;
+    std::vector<Item> items;
+    std::vector<Session> sessions;
+    // Every coin in the machine, per denomination; empty without coin
+    // tracking.
+    std::vector<int> coinStock;
+    std::uint64_t transactionCount = 0;
+    Money revenue;
+};
+
+// Read-only view of a snapshot file. The file is memory-mapped and laid out
+// as fixed-size records plus one string blob, so opening it is O(1) and
+// entries are read in place instead of being parsed.
+//
+// Layout: header, item records, item type records, session records, coin
+// section, string blob. The coin section is a u64 denomination count n,
+// then n i32 stock counts, then n i32 set-aside counts per session. All
+// integers are little-endian as written by the host. Version 1 files,
+// which predate item types, and version 2 files, which predate coins, are
+// still read.
+class Snapshot {
+public:
+    struct SessionView {
+        std::string_view id;
+        Money balance;
+        // coinDenominations() counts, or null when the file has none.
+        const std::int32_t* setAside;
+    };
+
+    // Writes to a temporary file, syncs it and renames it over `path`, so a
+    // crash leaves either the old or the new snapshot.
+    static void write(const std::string& path, const SnapshotState& state);
+
+    // Maps `path`. A missing file gives an empty snapshot; a corrupt one
+    // throws std::runtime_error.
+    explicit Snapshot(const std::string& path);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    bool empty() const;
+    std::uint64_t lsn() const;
+    std::uint64_t transactionCount() const;
+    Money revenue() const;
+
+    std::size_t itemCount() const;
+    ItemView item(std::size_t index) const;
+    std::size_t sessionCount() const;
+    SessionView session(std::size_t index) const;
+    // Zero when the machine did not track coins or the file predates them.
+    std::size_t coinDenominations() const;
+    const std::int32_t* coinStock() const;
+
+private:
+    struct Header;
+    struct ItemRecord;
+    struct ItemTypeRecord;
+    struct SessionRecord;
+
+    // Checks the header and every string range against the file size, and
+    // sets `typed`.
+    bool valid();
+    const Header* header() const;
+    std::size_t itemTypeRecordsSize() const;
+    const char* sessions() const;
+    // The coin section, or the blob for files without one.
+    const char* coins() const;
+    std::size_t coinSectionSize() const;
+    const char* blob() const;
+    std::string_view text(std::uint64_t offset, std::uint64_t length) const;
+    void unmap();
+
+    const char* data = nullptr;
+    std::size_t size = 0;
+    bool typed = false;
+    bool hasCoins = false;
+    std::vector<char> fallback;
+};
+
+#endif
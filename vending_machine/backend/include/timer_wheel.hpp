@@ -0,0 +1,106 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Hierarchical timing wheel. Time is counted in ticks chosen by the caller.
+// Level 0 has one slot per tick for the next 64 ticks; every level above
+// covers 64 times the span of the one below, one slot per 64 of its ticks.
+// A timer sits in the coarsest slot that still tells its tick apart, and
+// moves down a level whenever the clock reaches that slot. Scheduling and
+// cancelling are O(1) whatever the number of timers, and advancing skips
+// empty level-0 slots, so it costs per timer fired and per 64 ticks
+// elapsed, never per timer pending.
+//
+// Not thread-safe; the owner locks around it.
+class TimerWheel {
+public:
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr std::size_t kSlots = std::size_t(1) << kSlotBits;
+    static constexpr unsigned kLevels = 4;
+    // Ticks the wheel can tell apart; later timers wait in the top level and
+    // are placed again as the clock gets closer.
+    static constexpr std::uint64_t kSpan = std::uint64_t(1) << (kSlotBits * kLevels);
+
+    // Embedded in whatever is being timed, which must not move while the
+    // timer is scheduled.
+    struct Timer {
+        Timer* next = nullptr;
+        // The pointer that points at this timer; null while unscheduled.
+        Timer** prev = nullptr;
+        std::uint64_t expiry = 0;
+
+        bool scheduled() const { return prev != nullptr; }
+    };
+
+    // `now` is the first tick advance() will process.
+    explicit TimerWheel(std::uint64_t now = 0);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Fires at the first advance() reaching `expiry`; an expiry already
+    // passed fires at the next advance(). Reschedules a scheduled timer.
+    void schedule(Timer& timer, std::uint64_t expiry);
+    void cancel(Timer& timer);
+    // Processes every tick up to and including `now`, calling `fire` with
+    // each timer whose expiry it reaches. The timer is unscheduled first, so
+    // `fire` may schedule it again or free it.
+    template <typename Fire>
+    void advance(std::uint64_t now, Fire&& fire);
+
+    std::size_t size() const { return count; }
+    // No timer fires before this tick: the next occupied level-0 slot, or
+    // the next time a higher level moves down. UINT64_MAX when empty.
+    std::uint64_t nextCheck() const;
+
+private:
+    static constexpr std::uint64_t kMask = kSlots - 1;
+
+    void insert(Timer& timer);
+    static void unlink(Timer& timer);
+    // Moves the timers of the higher-level slots `current` has reached
+    // down the wheel.
+    void cascade();
+    // The next tick after `current` that may have work, at most `limit`.
+    std::uint64_t nextTick(std::uint64_t limit) const;
+
+    std::array<std::array<Timer*, kSlots>, kLevels> slots{};
+    // Level-0 slots that may hold timers. Set on insert, cleared when a
+    // visit finds the slot empty, so cancel() never touches it.
+    std::uint64_t occupied = 0;
+    // The first tick not yet processed.
+    std::uint64_t current;
+    std::size_t count = 0;
+};
+
+template <typename Fire>
+void TimerWheel::advance(std::uint64_t now, Fire&& fire) {
+    while (current <= now) {
+        if (count == 0) {
+            current = now + 1;
+            return;
+        }
+        const std::size_t slot = current & kMask;
+        if (slot == 0) {
+            cascade();
+        }
+        Timer*& head = slots[0][slot];
+        while (Timer* timer = head) {
+            unlink(*timer);
+            --count;
+            if (timer->expiry <= current) {
+                fire(*timer);
+            } else {
+                // Only a timer placed by its capped expiry lands here early.
+                insert(*timer);
+            }
+        }
+        occupied &= ~(std::uint64_t(1) << slot);
+        current = nextTick(now + 1);
+    }
+}
+
+#endif
@@ -2,22 +2,154 @@
 #define TRANSACTION_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <ctime>
+#include <mutex>
+#include <cstdint>
+#include "money.hpp"
+#include "mpsc_queue.hpp"
+#include "sku_table.hpp"
 
+// `sku` is the item's SkuTable::global() id.
 struct Transaction {
-    std::string itemName;
-    double price;
+    std::uint32_t sku;
+    Money price;
     std::time_t timestamp;
 };
 
+// A transaction read in place from the history. `itemName` points into the
+// SKU table.
+struct TransactionView {
+    std::uint32_t itemId;
+    std::string_view itemName;
+    Money price;
+    std::time_t timestamp;
+};
+
+struct TransactionLogOptions {
+    // Zero appends under the log's mutex instead, without a queue or the
+    // background drainer; suits many lightly used logs.
+    std::size_t queueCapacity = 1024;
+    // Most transactions kept in memory; older ones are folded into the
+    // baseline counters. Zero keeps everything.
+    std::size_t retention = 0;
+};
+
+// Purchase threads only push a fixed-size record onto a lock-free queue; a
+// shared background thread drains every log's queue into its history. Reads
+// drain the queue first, waiting for records whose producers are still
+// writing them, so they see every logTransaction call that has returned.
+//
+// The history is columnar and chunked: items are uint32 SKU ids, prices are
+// int64 cents and timestamps are zigzag varint deltas, which comes to about
+// 13 bytes per transaction.
 class TransactionLog {
 public:
-    void logTransaction(const std::string& itemName, double price);
+    explicit TransactionLog(TransactionLogOptions options = TransactionLogOptions());
+    ~TransactionLog();
+
+    TransactionLog(const TransactionLog&) = delete;
+    TransactionLog& operator=(const TransactionLog&) = delete;
+
+    void logTransaction(std::uint32_t sku, Money price);
+    void logTransaction(std::uint32_t sku, Money price, std::time_t timestamp);
+    // Interns `itemName` first.
+    void logTransaction(const std::string& itemName, Money price);
+    void logTransaction(const std::string& itemName, Money price, std::time_t timestamp);
+    // Logs the lines of one order back to back, with nothing interleaved.
+    void logTransactions(const std::vector<Transaction>& group);
+    // Copies the whole retained history; prefer visit() for large logs.
     std::vector<Transaction> getHistory();
+    // Calls `visitor` with up to `limit` retained transactions starting at
+    // `offset` (0 is the oldest retained) without copying them, and returns
+    // how many were visited. The log is locked while visiting.
+    template <typename Visitor>
+    std::size_t visit(std::size_t offset, std::size_t limit, Visitor&& visitor);
+    std::size_t retainedCount();
+    // Bytes held by the retained history columns.
+    std::size_t memoryUsage();
+    // Exact sum of every logged price, including the baseline.
+    Money totalRevenue();
+    std::uint64_t transactionCount();
+    // Counts and revenue of transactions that are no longer held in memory,
+    // e.g. those folded into a snapshot.
+    void setBaseline(std::uint64_t count, Money revenue);
+    // Records logged but not yet moved into the history.
+    std::size_t pendingCount() const;
+
+    // Called by the background drainer; skips the log if a reader holds it.
+    void drainPending();
 
 private:
-    std::vector<Transaction> history;
+    // One cache line per record, so producers never share a line.
+    struct alignas(64) PendingTransaction {
+        std::int64_t cents;
+        std::int64_t timestamp;
+        std::uint32_t sku;
+    };
+    static_assert(sizeof(PendingTransaction) == 64, "PendingTransaction should fill one cache line");
+
+    struct Chunk {
+        // Columns grow on demand, so a log with a few transactions stays small.
+        static constexpr std::size_t kCapacity = 4096;
+
+        std::size_t size() const { return itemIds.size(); }
+
+        std::vector<std::uint32_t> itemIds;
+        std::vector<std::int64_t> cents;
+        std::vector<std::uint8_t> timestampDeltas;
+        std::int64_t lastTimestamp = 0;
+    };
+
+    // Moves queued records into the history. With `complete`, also waits for
+    // cells claimed before the call but not yet filled; the background
+    // drainer passes false and leaves those for the next pass.
+    void drainLocked(bool complete = true);
+    void append(std::uint32_t sku, std::int64_t cents, std::int64_t timestamp);
+    static std::int64_t readDelta(const std::uint8_t*& cursor);
+
+    TransactionLogOptions options;
+    std::unique_ptr<MpscQueue<PendingTransaction>> queue;
+    std::deque<std::unique_ptr<Chunk>> chunks;
+    std::size_t retained = 0;
+    std::uint64_t baselineCount = 0;
+    Money baselineRevenue;
+    std::mutex mtx;
 };
 
-#endif
\ No newline at end of file
+template <typename Visitor>
+std::size_t TransactionLog::visit(std::size_t offset, std::size_t limit, Visitor&& visitor) {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    const SkuTable& table = SkuTable::global();
+    std::size_t visited = 0;
+    for (const auto& chunk : chunks) {
+        if (visited == limit) {
+            break;
+        }
+        if (offset >= chunk->size()) {
+            offset -= chunk->size();
+            continue;
+        }
+        // Timestamps are deltas, so decode from the start of the chunk.
+        const std::uint8_t* cursor = chunk->timestampDeltas.data();
+        std::int64_t timestamp = 0;
+        for (std::size_t i = 0; i < chunk->size() && visited < limit; ++i) {
+            timestamp += readDelta(cursor);
+            if (i < offset) {
+                continue;
+            }
+            const std::uint32_t id = chunk->itemIds[i];
+            visitor(TransactionView{id, table.name(id), Money::fromCents(chunk->cents[i]),
+                                    static_cast<std::time_t>(timestamp)});
+            ++visited;
+        }
+        offset = 0;
+    }
+    return visited;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <cstddef>
+#include <string>
+#include "cpu_topology.hpp"
+#include "inventory_stream.hpp"
+#include "vending_api.hpp"
+
+// Zero leaves a setting at the front end's own default.
+struct TransportOptions {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    // Worker threads (httplib, crow) or event loops (epoll).
+    std::size_t threads = 0;
+    // Applies to httplib workers and epoll loops.
+    Pinning pinning = Pinning::None;
+    // Accepted connections waiting for a worker before further ones are
+    // dropped (httplib).
+    std::size_t queueLimit = 0;
+    // Pending connections the kernel queues before the server accepts them
+    // (httplib, epoll).
+    int backlog = 1024;
+    // Requests on one connection before it is closed (httplib, epoll), and
+    // seconds a kept-alive connection may sit idle.
+    std::size_t keepAliveRequests = 0;
+    int keepAliveSeconds = 0;
+    // Concurrent /api/items/stream subscribers (httplib). Each holds a
+    // thread of its own, added to the pool on top of `threads`; further
+    // subscribers are refused with 503.
+    std::size_t streamSubscribers = 16;
+};
+
+// HTTP front ends. Each one translates requests for VendingApi and blocks
+// serving them until the process ends.
+
+// cpp-httplib: a thread pool with blocking sockets. Also serves the
+// /api/items/stream Server-Sent Events route from `stream`, from threads
+// set aside for it so subscribers never starve the API.
+void serveHttplib(VendingApi& api, InventoryStream& stream, const TransportOptions& options);
+
+// Crow on Boost.Asio. Only built when Boost is found (VENDING_WITH_CROW);
+// it has no /api/items/stream route.
+void serveCrow(VendingApi& api, const TransportOptions& options);
+
+// Edge-triggered epoll, one non-blocking event loop per core with HTTP/1.1
+// keep-alive and pipelining, for many mostly idle connections. Linux only
+// (VENDING_WITH_EPOLL); it has no /api/items/stream route.
+void serveEpoll(VendingApi& api, const TransportOptions& options);
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef VENDING_API_HPP
+#define VENDING_API_HPP
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "admission.hpp"
+#include "catalog_cache.hpp"
+#include "fleet.hpp"
+#include "idempotency_cache.hpp"
+#include "metrics.hpp"
+#include "vending_machine.h"
+
+// What the API reads from an HTTP request. Every front end implements it
+// over its own request type, so dispatching copies nothing.
+class ApiRequest {
+public:
+    virtual ~ApiRequest() = default;
+    virtual std::string_view method() const = 0;
+    // Path without the query string.
+    virtual std::string_view path() const = 0;
+    virtual const std::string& body() const = 0;
+    // First header called `name` (case-insensitive), or an empty string.
+    virtual std::string header(const std::string& name) const = 0;
+    virtual std::optional<std::string> param(const std::string& name) const = 0;
+    // When the request started waiting for a handler, for front ends that
+    // know; admission control judges overload by the wait.
+    virtual std::optional<std::chrono::steady_clock::time_point> queuedSince() const { return std::nullopt; }
+};
+
+struct ApiResponse {
+    int status = 200;
+    std::string contentType = "text/plain";
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    void set(int code, std::string content, std::string type = "text/plain") {
+        status = code;
+        body = std::move(content);
+        contentType = std::move(type);
+    }
+};
+
+// Transport-agnostic request handling for every /api/... route and
+// /metrics: routing, JSON bodies, CORS headers and per-route metrics. The
+// HTTP front ends only translate their requests and responses, so they
+// serve the same API and report the same metrics.
+//
+// Machine routes are served for the default machine under /api/<action>
+// and for any fleet machine under /api/machines/<id>/<action>. Under
+// overload, requests are refused with 503 and Retry-After before reaching a
+// handler (see AdmissionController); insert-money, purchases and
+// return-change are refused last. Inserting money, purchases and
+// reservations honour an Idempotency-Key header: a retry with the same key
+// gets the first response back.
+class VendingApi {
+public:
+    // The fleet must hold a machine called "default".
+    VendingApi(Fleet& fleet, MetricsRegistry& metrics, AdmissionOptions admission = AdmissionOptions(),
+               IdempotencyCacheOptions idempotency = IdempotencyCacheOptions());
+
+    VendingApi(const VendingApi&) = delete;
+    VendingApi& operator=(const VendingApi&) = delete;
+
+    // Fills `response`; unknown routes answer 404.
+    void handle(const ApiRequest& request, ApiResponse& response);
+
+    MetricsRegistry& metrics();
+
+private:
+    using MachineHandler = void (VendingApi::*)(MachineHandle, const ApiRequest&, ApiResponse&);
+    struct MachineRoute {
+        const char* method;
+        const char* action;
+        MachineHandler handler;
+        bool purchase;
+        // Honours Idempotency-Key.
+        bool idempotent;
+        AdmissionController::Priority priority;
+        // Metrics under /api/<action> and /api/machines/:id/<action>.
+        RouteMetrics* defaultMetrics;
+        RouteMetrics* fleetMetrics;
+    };
+
+    void dispatch(const ApiRequest& request, ApiResponse& response, RouteMetrics*& timedAs, bool& purchase);
+    const MachineRoute* findRoute(std::string_view method, std::string_view action) const;
+    // Runs the route's handler, or replays the response to an earlier
+    // request with the same Idempotency-Key.
+    void runRoute(const MachineRoute& route, MachineHandle machine, const std::string& machineId,
+                  const ApiRequest& request, ApiResponse& response);
+    // Runs the route's handler unless the machine has halted.
+    void runHandler(const MachineRoute& route, MachineHandle machine, const ApiRequest& request,
+                    ApiResponse& response);
+    // An in-flight slot, or an empty ticket with `response` set to 503.
+    AdmissionController::Ticket admit(AdmissionController::Priority priority, const ApiRequest& request,
+                                      ApiResponse& response);
+
+    void handleItems(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleInsertMoney(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handlePurchase(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handlePurchaseBatch(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleReserve(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleConfirmHold(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleCancelHold(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleReturnChange(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleCoins(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleHistory(MachineHandle machine, const ApiRequest& request, ApiResponse& response);
+    void handleCreateMachine(const ApiRequest& request, ApiResponse& response);
+
+    static std::string sessionIdFor(const ApiRequest& request);
+
+    Fleet& fleet;
+    MetricsRegistry& registry;
+    MachineHandle defaultMachine;
+    // The default machine's /api/items body; fleet machines are small and
+    // many, so theirs is built per request.
+    CatalogCache catalogCache;
+    std::vector<MachineRoute> routes;
+    RouteMetrics* machinesGet;
+    RouteMetrics* machinesPost;
+    Counter* purchasesSucceeded;
+    Counter* purchasesFailed;
+    AdmissionController admission;
+    IdempotencyCache idempotency;
+    Counter* shedLow;
+    Counter* shedHigh;
+};
+
+// The catalog every new machine is stocked with.
+void seedDefaultItems(VendingMachine& machine);
+
+#endif
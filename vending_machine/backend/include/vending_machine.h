@@ -4,35 +4,226 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
 #include "payment.hpp"
 #include "inventory.hpp"
 #include "transaction.hpp"
+#include "session_store.hpp"
+#include "journal.hpp"
+#include "change_maker.hpp"
+#include "timer_wheel.hpp"
 
 class VendingMachine {
 public:
-    // Constructor with dependency injection
+    // Constructor with dependency injection. With a journal, every state
+    // change is committed to it before the call returns, or the call throws
+    // JournalFailure (see halted()). Without a session
+    // store a default one is created. With a coin inventory, change is paid
+    // out of it and purchases whose change it cannot make are refused;
+    // without one, change is unlimited.
     VendingMachine(std::unique_ptr<IPaymentMethod> paymentMethod,
                   std::unique_ptr<Inventory> inventory,
-                  std::unique_ptr<TransactionLog> transactionLog);
+                  std::unique_ptr<TransactionLog> transactionLog,
+                  std::unique_ptr<Journal> journal = nullptr,
+                  std::unique_ptr<SessionStore> sessions = nullptr,
+                  std::unique_ptr<CoinInventory> coins = nullptr);
 
-    // Payment operations
-    void insertMoney(double amount);
-    double getBalance() const;
-    double returnChange();
+    // Payment operations. Calls without a session id use the injected
+    // payment method; each non-empty session id has a balance of its own.
+    void insertMoney(Money amount);
+    void insertMoney(const std::string& sessionId, Money amount);
+    Money getBalance() const;
+    Money getBalance(const std::string& sessionId) const;
+    Money returnChange();
+    Money returnChange(const std::string& sessionId);
+    // Also reports the coins paid out. Throws ChangeUnavailable, leaving the
+    // balance untouched, if the coin inventory cannot make it exactly. Every
+    // balance has its coins set aside, and snapshots and the journal keep
+    // them, so that only happens to balances restored from a snapshot
+    // written before coins were saved.
+    Money returnChange(const std::string& sessionId, ChangeBreakdown& coinsOut);
+    // Coins and bills in the machine; empty without a coin inventory.
+    ChangeBreakdown getCoinStock() const;
+    void refillCoins(Money denomination, int count);
 
-    // Item operations
-    std::vector<std::unique_ptr<IItem>> getAvailableItems() const;
+    // Item operations. getAvailableItems() copies the catalog sorted by
+    // name; visitItems() reads it in place, in no particular order.
+    std::vector<Item> getAvailableItems() const;
+    template <typename Visitor>
+    void visitItems(Visitor&& visitor) const {
+        inventory->visit(std::forward<Visitor>(visitor));
+    }
+    Inventory::StockByType getStockByType() const;
     bool purchaseItem(const std::string& itemName);
-    void addItem(std::unique_ptr<IItem> item);
+    bool purchaseItem(const std::string& sessionId, const std::string& itemName);
+    // Buys by SkuTable::global() id, for callers that resolved the name
+    // already.
+    bool purchaseItem(const std::string& sessionId, std::uint32_t sku);
+    // Buys every line of `cart` or nothing: stock and funds are checked once
+    // for the whole order, which is logged and journaled as one group.
+    // Throws std::invalid_argument for an empty cart or a line whose
+    // quantity is not positive.
+    bool purchaseItems(const std::string& sessionId, const std::vector<CartLine>& cart);
+    void addItem(const Item& item);
     void refillItem(const std::string& itemName, int quantity);
 
+    // Holds. reserveItem() sets `quantity` units of an item aside for the
+    // session until `ttl` has passed and returns the hold's id, or 0 if the
+    // item is unknown or short. confirmHold() buys the held units with the
+    // session's balance; if the payment fails the hold stays. cancelHold()
+    // puts the units back and returns false for an unknown hold. A hold is
+    // unknown once confirmed, cancelled or expired, and to other sessions;
+    // confirmHold() throws std::out_of_range for one. Holds are not
+    // journaled: a restart returns every held unit to stock.
+    std::uint64_t reserveItem(const std::string& sessionId, const std::string& itemName, int quantity,
+                              std::chrono::milliseconds ttl,
+                              std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    std::uint64_t reserveItem(const std::string& sessionId, std::uint32_t sku, int quantity,
+                              std::chrono::milliseconds ttl,
+                              std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    bool confirmHold(const std::string& sessionId, std::uint64_t holdId,
+                     std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    bool cancelHold(const std::string& sessionId, std::uint64_t holdId,
+                    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    // Returns the units of expired holds to stock. Every item operation
+    // does this first; call it periodically as well so abandoned holds come
+    // back without waiting for the next customer. Costs one atomic load
+    // while no hold is due.
+    void expireHolds(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    std::size_t getHoldCount() const;
+    std::uint64_t getCatalogVersion() const;
+    Inventory::LockWaits getInventoryLockWaits() const;
+    // Stock change feed; see Inventory::enableChangeFeed and drainChanges.
+    void enableChangeFeed(std::size_t capacity);
+    bool drainItemChanges(std::vector<ItemChange>& out);
+
     // Transaction operations
     std::vector<Transaction> getTransactionHistory() const;
+    // Pages through the retained history in place; see TransactionLog::visit.
+    template <typename Visitor>
+    std::size_t visitTransactions(std::size_t offset, std::size_t limit, Visitor&& visitor) const {
+        return transactionLog->visit(offset, limit, std::forward<Visitor>(visitor));
+    }
+    std::size_t getRetainedTransactionCount() const;
+    std::uint64_t getTransactionCount() const;
+    // Transactions logged but not yet moved into the history.
+    std::size_t getPendingTransactionCount() const;
+    Money getTotalRevenue() const;
+
+    // Persistence. checkpoint() writes a snapshot of all state and drops the
+    // journal segments it covers. recover() loads a snapshot and replays the
+    // journal tail after it; call it once, before serving requests. Returns
+    // false when there was nothing to recover.
+    void checkpoint(const std::string& snapshotPath);
+    bool recover(const std::string& snapshotPath);
+    // True once the journal has failed a write. Changes caught in the failed
+    // batch are already in memory but not on disk, so from then on the
+    // machine fail-stops: every journaled change throws JournalFailure
+    // without applying anything, and checkpoint() throws rather than save
+    // them. A restart recovers the last durable state.
+    bool halted() const;
+
+    // While one of these is alive on a thread, changes made on that thread
+    // return once journaled instead of once durable, and the highest LSN
+    // they wrote is kept in `lsn`; the caller then passes it to
+    // waitDurable() before reporting success. A machine actor uses this so
+    // its mailbox keeps running while earlier callers wait on the flush,
+    // letting their records share a group commit.
+    class DeferDurability {
+    public:
+        explicit DeferDurability(std::uint64_t& lsn);
+        ~DeferDurability();
+
+        DeferDurability(const DeferDurability&) = delete;
+        DeferDurability& operator=(const DeferDurability&) = delete;
+
+    private:
+        std::uint64_t* previous;
+    };
+    // Blocks until every change up to `lsn` (zero for none) is on disk.
+    // Throws JournalFailure if it cannot be.
+    void waitDurable(std::uint64_t lsn);
 
 private:
+    // A session's payment method, held for one operation: the injected one
+    // for the empty session id, otherwise the session's account, opened on
+    // first use unless `open` is false. An account the operation left at
+    // zero balance is closed when this goes away.
+    class SessionPayment {
+    public:
+        SessionPayment(const VendingMachine& machine, const std::string& sessionId, bool open = true);
+        ~SessionPayment();
+
+        SessionPayment(const SessionPayment&) = delete;
+        SessionPayment& operator=(const SessionPayment&) = delete;
+
+        // Only valid when opened.
+        IPaymentMethod& method() const;
+        // Null when the method is not cash, or for an unopened session
+        // without an account.
+        CashPayment* cash() const;
+
+    private:
+        const VendingMachine& machine;
+        const std::string& sessionId;
+        std::shared_ptr<CashPayment> account;
+    };
+
+    std::shared_lock<std::shared_mutex> mutationGuard() const;
+    // mutationGuard() for journaled changes; throws JournalFailure once the
+    // machine has halted.
+    std::shared_lock<std::shared_mutex> commitGuard() const;
+    // Debits `price`. With a coin inventory and a cash balance, only if the
+    // change then owed can be set aside for the session, atomically with
+    // the debit; what that moved is appended to `deltas` if not null.
+    bool charge(const std::string& sessionId, const SessionPayment& payment, Money price, CoinDeltas* deltas);
+    // Replays a balance change without any checks.
+    void adjustBalance(const std::string& sessionId, Money delta);
+    std::uint64_t journalAppend(JournalRecord record);
+    // waitDurable(), or under DeferDurability only noting `lsn`.
+    void commitDurable(std::uint64_t lsn);
+    void replay(const JournalRecord& record);
+    // Both need holdsMtx and a created `holds`.
+    void expireHoldsLocked(std::uint64_t tick);
+    void publishHolds();
+
+    // A reservation, timed by the wheel it is scheduled on.
+    struct Hold : TimerWheel::Timer {
+        std::uint64_t id = 0;
+        std::string session;
+        std::uint32_t sku = 0;
+        int quantity = 0;
+    };
+    struct Holds {
+        explicit Holds(std::uint64_t now) : wheel(now) {}
+        TimerWheel wheel;
+        // Map nodes never move, so their timers stay linked.
+        std::unordered_map<std::uint64_t, Hold> byId;
+    };
+
     std::unique_ptr<IPaymentMethod> paymentMethod;
+    std::unique_ptr<SessionStore> sessions;
     std::unique_ptr<Inventory> inventory;
     std::unique_ptr<TransactionLog> transactionLog;
+    std::unique_ptr<Journal> journal;
+    std::unique_ptr<CoinInventory> coins;
+    // Set by DeferDurability.
+    static thread_local std::uint64_t* deferredLsn;
+    mutable std::shared_mutex stateMtx;
+    // Created by the first reservation, so machines that never take one
+    // carry no wheel.
+    std::unique_ptr<Holds> holds;
+    std::mutex holdsMtx;
+    std::uint64_t nextHoldId;
+    // Hold tick before which no hold can expire; read without holdsMtx.
+    std::atomic<std::uint64_t> nextHoldCheck;
+    std::atomic<std::size_t> holdCount{0};
 };
 
 #endif 
\ No newline at end of file
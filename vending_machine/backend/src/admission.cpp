@@ -0,0 +1,57 @@
+#include "admission.hpp"
+#include <algorithm>
+#include <limits>
+
+AdmissionController::AdmissionController(AdmissionOptions options)
+    : options(options), minSojourn(std::numeric_limits<std::int64_t>::max()) {}
+
+void AdmissionController::observe(std::int64_t sojournNanos, std::int64_t nowNanos) {
+    std::int64_t end = intervalEnd.load(std::memory_order_relaxed);
+    if (nowNanos >= end) {
+        const std::int64_t interval = std::chrono::nanoseconds(options.interval).count();
+        // One thread closes the interval and judges it.
+        if (intervalEnd.compare_exchange_strong(end, nowNanos + interval, std::memory_order_relaxed)) {
+            const std::int64_t shortest =
+                minSojourn.exchange(std::numeric_limits<std::int64_t>::max(), std::memory_order_relaxed);
+            // An interval without requests had no queue.
+            overloaded.store(shortest != std::numeric_limits<std::int64_t>::max() &&
+                                 shortest > std::chrono::nanoseconds(options.target).count(),
+                             std::memory_order_relaxed);
+        }
+    }
+    std::int64_t shortest = minSojourn.load(std::memory_order_relaxed);
+    while (sojournNanos < shortest &&
+           !minSojourn.compare_exchange_weak(shortest, sojournNanos, std::memory_order_relaxed)) {
+    }
+}
+
+AdmissionController::Ticket AdmissionController::admit(Priority priority,
+                                                       std::optional<std::chrono::nanoseconds> sojourn,
+                                                       std::chrono::steady_clock::time_point now) {
+    if (sojourn && options.target.count() > 0) {
+        observe(sojourn->count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+        const auto limit =
+            priority == Priority::Low && isOverloaded() ? std::chrono::nanoseconds(options.target)
+                                                        : std::chrono::nanoseconds(options.interval);
+        if (*sojourn > limit) {
+            return Ticket();
+        }
+    }
+    const long running = inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (options.maxInFlight > 0) {
+        const double cap = priority == Priority::Low ? std::max(1.0, options.maxInFlight * options.lowPriorityShare)
+                                                     : static_cast<double>(options.maxInFlight);
+        if (running > cap) {
+            inFlight.fetch_sub(1, std::memory_order_relaxed);
+            return Ticket();
+        }
+    }
+    return Ticket(this);
+}
+
+int AdmissionController::retryAfterSeconds() const {
+    // Long enough for an overloaded queue to drain over a few intervals.
+    const auto drain = options.interval * 10;
+    return static_cast<int>(std::max<long long>(1, std::chrono::ceil<std::chrono::seconds>(drain).count()));
+}
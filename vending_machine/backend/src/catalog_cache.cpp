@@ -0,0 +1,62 @@
+#include "catalog_cache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+CatalogCache::CatalogCache(const VendingMachine& machine) : machine(machine) {}
+
+std::shared_ptr<const CatalogCache::Entry> CatalogCache::get() {
+    std::uint64_t version = machine.getCatalogVersion();
+    auto entry = std::atomic_load(&current);
+    if (entry && entry->version == version) {
+        return entry;
+    }
+
+    // One thread rebuilds while the others wait for its result instead of
+    // all serializing the same catalog.
+    std::lock_guard<std::mutex> lock(rebuildMtx);
+    version = machine.getCatalogVersion();
+    entry = std::atomic_load(&current);
+    if (entry && entry->version == version) {
+        return entry;
+    }
+    // A change racing with serialization bumps the version past the one
+    // recorded here, so the next request rebuilds again.
+    auto rebuilt = std::make_shared<Entry>();
+    rebuilt->version = version;
+    rebuilt->etag = "\"" + std::to_string(version) + "\"";
+    rebuilt->body = serialize(machine);
+    std::atomic_store(&current, std::shared_ptr<const Entry>(rebuilt));
+    return rebuilt;
+}
+
+std::string CatalogCache::serialize(const VendingMachine& machine) {
+    // Read in place: views name into SkuTable::global(), which never moves
+    // or frees a name, so they stay valid after the shard locks are
+    // released and nothing is copied until the JSON is built. Sorted by
+    // name, the same order getAvailableItems() returns.
+    std::vector<ItemView> items;
+    machine.visitItems([&items](const ItemView& item) { items.push_back(item); });
+    std::sort(items.begin(), items.end(), [](const ItemView& a, const ItemView& b) { return a.name < b.name; });
+    json response = json::array();
+    for (const auto& item : items) {
+        json entry = {
+            {"id", item.id},
+            {"name", item.name},
+            {"price", item.price},
+            {"quantity", item.quantity},
+            {"reserved", item.reserved},
+            {"type", itemTypeName(item.type)}
+        };
+        if (item.type == ItemType::Beverage) {
+            entry["volume"] = item.attribute;
+        } else if (item.type == ItemType::Snack) {
+            entry["weight"] = item.attribute;
+        }
+        response.push_back(std::move(entry));
+    }
+    return response.dump();
+}
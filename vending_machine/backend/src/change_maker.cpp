@@ -0,0 +1,387 @@
+#include "change_maker.hpp"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <stdexcept>
+
+namespace {
+
+// Keeps per-call scratch counts on the stack.
+constexpr std::size_t kMaxDenominations = 16;
+
+}  // namespace
+
+ChangeMaker::ChangeMaker(std::vector<Money> denominations) {
+    for (Money denomination : denominations) {
+        if (denomination <= Money()) {
+            throw std::invalid_argument("Denominations must be positive");
+        }
+        cents.push_back(denomination.toCents());
+    }
+    std::sort(cents.begin(), cents.end());
+    cents.erase(std::unique(cents.begin(), cents.end()), cents.end());
+    if (cents.empty() || cents.front() != 1) {
+        throw std::invalid_argument("Denominations must include 1 cent");
+    }
+    if (cents.size() > kMaxDenominations) {
+        throw std::invalid_argument("Too many denominations");
+    }
+
+    // Unbounded fewest-coins DP, then each row is its predecessor's plus
+    // the coin that reached it.
+    const std::size_t d = cents.size();
+    limit = cents.back() * 10;
+    std::vector<std::int32_t> best(limit, INT32_MAX);
+    std::vector<std::uint8_t> last(limit, 0);
+    best[0] = 0;
+    for (std::int64_t a = 1; a < limit; ++a) {
+        for (std::size_t i = 0; i < d && cents[i] <= a; ++i) {
+            if (best[a - cents[i]] + 1 < best[a]) {
+                best[a] = best[a - cents[i]] + 1;
+                last[a] = static_cast<std::uint8_t>(i);
+            }
+        }
+    }
+    table.assign(static_cast<std::size_t>(limit) * d, 0);
+    for (std::int64_t a = 1; a < limit; ++a) {
+        const std::size_t coin = last[a];
+        std::copy_n(&table[(a - cents[coin]) * d], d, &table[a * d]);
+        ++table[a * d + coin];
+    }
+}
+
+const ChangeMaker& ChangeMaker::standard() {
+    static const ChangeMaker maker({
+        Money::fromCents(1), Money::fromCents(5), Money::fromCents(10), Money::fromCents(25),
+        Money::fromCents(50), Money::fromCents(100), Money::fromCents(200), Money::fromCents(500),
+        Money::fromCents(1000), Money::fromCents(2000)});
+    return maker;
+}
+
+std::size_t ChangeMaker::denominationCount() const {
+    return cents.size();
+}
+
+Money ChangeMaker::denomination(std::size_t index) const {
+    return Money::fromCents(cents[index]);
+}
+
+std::int64_t ChangeMaker::tableCents() const {
+    return limit;
+}
+
+void ChangeMaker::split(std::int64_t amount, int* counts) const {
+    const std::size_t d = cents.size();
+    // Past the table the largest denomination leads every optimal breakdown
+    // of a canonical system like the standard one, so peel it off first.
+    std::int64_t largest = 0;
+    if (amount >= limit) {
+        largest = (amount - limit) / cents.back() + 1;
+        amount -= largest * cents.back();
+    }
+    const std::uint16_t* row = &table[amount * d];
+    for (std::size_t i = 0; i < d; ++i) {
+        counts[i] = row[i];
+    }
+    counts[d - 1] += static_cast<int>(largest);
+}
+
+bool ChangeMaker::makeChange(std::int64_t amount, const int* stock, int* counts) const {
+    if (amount < 0) {
+        return false;
+    }
+    split(amount, counts);
+    bool covered = true;
+    int optimum = 0;
+    for (std::size_t i = 0; i < cents.size(); ++i) {
+        covered = covered && counts[i] <= stock[i];
+        optimum += counts[i];
+    }
+    if (covered) {
+        return true;
+    }
+    // Greedy over the stock is optimal whenever it matches the unlimited
+    // optimum, which no bounded answer can beat; that skips the search for
+    // the common case of one denomination running low.
+    if (greedyChange(amount, stock, counts)) {
+        int used = 0;
+        for (std::size_t i = 0; i < cents.size(); ++i) {
+            used += counts[i];
+        }
+        if (used == optimum) {
+            return true;
+        }
+    }
+    if (amount <= kSearchLimitCents) {
+        return searchChange(amount, stock, counts);
+    }
+    return greedyChange(amount, stock, counts);
+}
+
+bool ChangeMaker::searchChange(std::int64_t amount, const int* stock, int* counts) const {
+    if (amount < 0) {
+        return false;
+    }
+    // Bounded knapsack as 0/1 items: each denomination's stock is split
+    // into parts of 1, 2, 4, ... coins so any count up to it is a subset.
+    struct Part {
+        std::size_t denomination;
+        int coins;
+        std::int64_t value;
+    };
+    std::vector<Part> parts;
+    for (std::size_t i = 0; i < cents.size(); ++i) {
+        int available = static_cast<int>(std::min<std::int64_t>(stock[i], amount / cents[i]));
+        for (int take = 1; available > 0; take *= 2) {
+            take = std::min(take, available);
+            parts.push_back({i, take, take * cents[i]});
+            available -= take;
+        }
+    }
+
+    const std::size_t size = static_cast<std::size_t>(amount) + 1;
+    const std::size_t words = (size + 63) / 64;
+    std::vector<std::int32_t> best(size, INT32_MAX);
+    std::vector<std::uint64_t> used(parts.size() * words, 0);
+    best[0] = 0;
+    for (std::size_t p = 0; p < parts.size(); ++p) {
+        const Part& part = parts[p];
+        for (std::int64_t a = amount; a >= part.value; --a) {
+            const std::int32_t from = best[a - part.value];
+            if (from != INT32_MAX && from + part.coins < best[a]) {
+                best[a] = from + part.coins;
+                used[p * words + a / 64] |= std::uint64_t(1) << (a % 64);
+            }
+        }
+    }
+    if (best[amount] == INT32_MAX) {
+        return false;
+    }
+    std::fill_n(counts, cents.size(), 0);
+    for (std::size_t p = parts.size(); p-- > 0 && amount > 0;) {
+        if (used[p * words + amount / 64] >> (amount % 64) & 1) {
+            counts[parts[p].denomination] += parts[p].coins;
+            amount -= parts[p].value;
+        }
+    }
+    return true;
+}
+
+bool ChangeMaker::greedyChange(std::int64_t amount, const int* stock, int* counts) const {
+    for (std::size_t i = cents.size(); i-- > 0;) {
+        counts[i] = static_cast<int>(std::min<std::int64_t>(stock[i], amount / cents[i]));
+        amount -= counts[i] * cents[i];
+    }
+    return amount == 0;
+}
+
+CoinInventory::CoinInventory(int floatPerDenomination, const ChangeMaker& maker)
+    : maker(maker),
+      counts(maker.denominationCount(), floatPerDenomination),
+      reserved(maker.denominationCount(), 0) {}
+
+std::size_t CoinInventory::denominationIndex(Money amount) const {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        if (maker.denomination(i) == amount) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+void CoinInventory::available(const std::vector<int>* mine, int* pool) const {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        pool[i] = counts[i] - reserved[i] + (mine ? (*mine)[i] : 0);
+    }
+}
+
+void CoinInventory::record(CoinDeltas* deltas, std::size_t denomination, int stock, int setAside) {
+    if (deltas && (stock != 0 || setAside != 0)) {
+        deltas->push_back({static_cast<std::uint8_t>(denomination), stock, setAside});
+    }
+}
+
+void CoinInventory::deposit(Money amount) {
+    std::lock_guard<std::mutex> lock(mtx);
+    const std::size_t i = denominationIndex(amount);
+    if (i == SIZE_MAX) {
+        throw std::invalid_argument("Not a coin or bill: " + amount.toString());
+    }
+    ++counts[i];
+}
+
+void CoinInventory::refill(Money denomination, int count, CoinDeltas* deltas) {
+    std::lock_guard<std::mutex> lock(mtx);
+    const std::size_t i = denominationIndex(denomination);
+    if (i == SIZE_MAX) {
+        throw std::invalid_argument("Unsupported denomination " + denomination.toString());
+    }
+    // Pieces set aside for customers stay.
+    const int before = counts[i];
+    counts[i] = std::max(reserved[i], counts[i] + count);
+    record(deltas, i, counts[i] - before, 0);
+}
+
+bool CoinInventory::canMakeChange(Money amount) const {
+    std::array<int, kMaxDenominations> pool{};
+    std::array<int, kMaxDenominations> pieces{};
+    std::lock_guard<std::mutex> lock(mtx);
+    available(nullptr, pool.data());
+    return maker.makeChange(amount.toCents(), pool.data(), pieces.data());
+}
+
+std::optional<ChangeBreakdown> CoinInventory::dispense(Money amount) {
+    std::array<int, kMaxDenominations> pool{};
+    std::array<int, kMaxDenominations> pieces{};
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        available(nullptr, pool.data());
+        if (!maker.makeChange(amount.toCents(), pool.data(), pieces.data())) {
+            return std::nullopt;
+        }
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            counts[i] -= pieces[i];
+        }
+    }
+    return breakdown(maker, pieces.data());
+}
+
+void CoinInventory::deposit(const std::string& session, CashPayment& account, Money amount, CoinDeltas* deltas) {
+    std::lock_guard<std::mutex> lock(mtx);
+    const std::size_t i = denominationIndex(amount);
+    if (i == SIZE_MAX) {
+        throw std::invalid_argument("Not a coin or bill: " + amount.toString());
+    }
+    // Credit first: if the balance cannot take it, no coin has been counted.
+    account.addMoney(amount);
+    auto& mine = setAside[session];
+    mine.resize(counts.size());
+    ++mine[i];
+    ++reserved[i];
+    ++counts[i];
+    record(deltas, i, 1, 1);
+}
+
+bool CoinInventory::charge(const std::string& session, CashPayment& account, Money price, CoinDeltas* deltas) {
+    std::array<int, kMaxDenominations> pool{};
+    std::array<int, kMaxDenominations> change{};
+    std::lock_guard<std::mutex> lock(mtx);
+    const Money left = account.getBalance() - price;
+    if (left < Money()) {
+        return false;
+    }
+    auto it = setAside.find(session);
+    const std::vector<int>* mine = it != setAside.end() ? &it->second : nullptr;
+    available(mine, pool.data());
+    if (!maker.makeChange(left.toCents(), pool.data(), change.data()) || !account.processPayment(price)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        const int moved = change[i] - (mine ? (*mine)[i] : 0);
+        reserved[i] += moved;
+        record(deltas, i, 0, moved);
+    }
+    if (left == Money()) {
+        if (mine) {
+            setAside.erase(it);
+        }
+    } else {
+        auto& kept = setAside[session];
+        kept.assign(change.begin(), change.begin() + counts.size());
+    }
+    return true;
+}
+
+ChangeBreakdown CoinInventory::payOut(const std::string& session, CashPayment& account, Money& amount,
+                                      CoinDeltas* deltas) {
+    std::array<int, kMaxDenominations> pool{};
+    std::array<int, kMaxDenominations> pieces{};
+    std::lock_guard<std::mutex> lock(mtx);
+    amount = account.getBalance();
+    auto it = setAside.find(session);
+    const std::vector<int>* mine = it != setAside.end() ? &it->second : nullptr;
+    if (amount > Money()) {
+        // The session's own coins add up to its balance unless the balance
+        // came back from a snapshot; either way they are in the pool.
+        available(mine, pool.data());
+        if (!maker.makeChange(amount.toCents(), pool.data(), pieces.data())) {
+            throw ChangeUnavailable("Cannot make exact change for " + amount.toString());
+        }
+        account.returnChange();
+    }
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        const int released = mine ? (*mine)[i] : 0;
+        counts[i] -= pieces[i];
+        reserved[i] -= released;
+        record(deltas, i, -pieces[i], -released);
+    }
+    if (mine) {
+        setAside.erase(it);
+    }
+    return breakdown(maker, pieces.data());
+}
+
+void CoinInventory::apply(const std::string& session, const CoinDeltas& deltas) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& mine = setAside[session];
+    mine.resize(counts.size());
+    for (const CoinDelta& delta : deltas) {
+        if (delta.denomination >= counts.size()) {
+            setAside.erase(session);
+            throw std::runtime_error("Unknown denomination in coin record");
+        }
+        counts[delta.denomination] += delta.stock;
+        reserved[delta.denomination] += delta.setAside;
+        mine[delta.denomination] += delta.setAside;
+    }
+    if (std::all_of(mine.begin(), mine.end(), [](int count) { return count == 0; })) {
+        setAside.erase(session);
+    }
+}
+
+CoinInventory::State CoinInventory::state() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {counts, setAside};
+}
+
+void CoinInventory::restore(State state) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (state.stock.size() != counts.size()) {
+        throw std::runtime_error("Snapshot coin stock does not match the machine's denominations");
+    }
+    std::vector<int> held(counts.size(), 0);
+    for (auto& [session, mine] : state.setAside) {
+        if (mine.size() != counts.size()) {
+            throw std::runtime_error("Snapshot coin stock does not match the machine's denominations");
+        }
+        for (std::size_t i = 0; i < held.size(); ++i) {
+            held[i] += mine[i];
+        }
+    }
+    counts = std::move(state.stock);
+    reserved = std::move(held);
+    setAside = std::move(state.setAside);
+}
+
+ChangeBreakdown CoinInventory::stock() const {
+    ChangeBreakdown result;
+    std::lock_guard<std::mutex> lock(mtx);
+    for (std::size_t i = counts.size(); i-- > 0;) {
+        result.push_back({maker.denomination(i), counts[i]});
+    }
+    return result;
+}
+
+const ChangeMaker& CoinInventory::changeMaker() const {
+    return maker;
+}
+
+ChangeBreakdown CoinInventory::breakdown(const ChangeMaker& maker, const int* counts) {
+    ChangeBreakdown result;
+    for (std::size_t i = maker.denominationCount(); i-- > 0;) {
+        if (counts[i] > 0) {
+            result.push_back({maker.denomination(i), counts[i]});
+        }
+    }
+    return result;
+}
@@ -0,0 +1,145 @@
+#include "cpu_topology.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+#ifdef __linux__
+// Parses a sysfs CPU list such as "0-3,8-11".
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        const auto dash = range.find('-');
+        const int first = std::atoi(range.c_str());
+        const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+#endif
+
+}  // namespace
+
+Pinning parsePinning(const std::string& name) {
+    if (name == "none") {
+        return Pinning::None;
+    }
+    if (name == "compact") {
+        return Pinning::Compact;
+    }
+    if (name == "spread") {
+        return Pinning::Spread;
+    }
+    throw std::invalid_argument("Unknown pinning " + name + " (expected none, compact or spread)");
+}
+
+std::vector<std::vector<int>> numaNodes() {
+    const std::vector<int> allowed = allowedCpus();
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    std::vector<int> ids;
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (const dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                ids.push_back(std::atoi(name.c_str() + 4));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(ids.begin(), ids.end());
+    for (int id : ids) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+#endif
+    if (nodes.empty()) {
+        nodes.push_back(allowed);
+    }
+    return nodes;
+}
+
+std::vector<int> pinningOrder(Pinning pinning) {
+    std::vector<int> order;
+#ifdef __linux__
+    const auto nodes = numaNodes();
+    if (pinning == Pinning::Compact) {
+        for (const auto& node : nodes) {
+            order.insert(order.end(), node.begin(), node.end());
+        }
+    } else if (pinning == Pinning::Spread) {
+        std::size_t total = 0;
+        for (const auto& node : nodes) {
+            total += node.size();
+        }
+        for (std::size_t i = 0; order.size() < total; ++i) {
+            for (const auto& node : nodes) {
+                if (i < node.size()) {
+                    order.push_back(node[i]);
+                }
+            }
+        }
+    }
+#else
+    (void)pinning;
+#endif
+    return order;
+}
+
+bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
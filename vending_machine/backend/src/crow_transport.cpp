@@ -0,0 +1,63 @@
+#include "transport.hpp"
+#include "crow_all.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+class CrowRequest : public ApiRequest {
+public:
+    explicit CrowRequest(const crow::request& req) : req(req), methodName(crow::method_name(req.method)) {}
+
+    std::string_view method() const override { return methodName; }
+    std::string_view path() const override { return req.url; }
+    const std::string& body() const override { return req.body; }
+    std::string header(const std::string& name) const override { return req.get_header_value(name); }
+    std::optional<std::string> param(const std::string& name) const override {
+        if (const char* value = req.url_params.get(name)) {
+            return std::string(value);
+        }
+        return std::nullopt;
+    }
+
+private:
+    const crow::request& req;
+    std::string methodName;
+};
+
+}  // namespace
+
+void serveCrow(VendingApi& api, const TransportOptions& options) {
+    crow::SimpleApp app;
+    // Crow logs every request at INFO.
+    app.loglevel(crow::LogLevel::Warning);
+
+    // No routes of its own: every request falls through to the catch-all,
+    // which hands it to the API. Crow answers OPTIONS itself.
+    CROW_CATCHALL_ROUTE(app)([&api](const crow::request& req, crow::response& res) {
+        CrowRequest request(req);
+        ApiResponse response;
+        api.handle(request, response);
+        res.code = response.status;
+        for (auto& [name, value] : response.headers) {
+            res.set_header(name, value);
+        }
+        if (!response.body.empty()) {
+            res.set_header("Content-Type", response.contentType);
+            res.body = std::move(response.body);
+        }
+    });
+
+    // Crow only exposes its thread count and idle timeout.
+    if (options.keepAliveSeconds > 0) {
+        app.timeout(static_cast<std::uint8_t>(std::min(options.keepAliveSeconds, 255)));
+    }
+    app.bindaddr(options.host).port(static_cast<std::uint16_t>(options.port));
+    if (options.threads > 0) {
+        app.concurrency(static_cast<std::uint16_t>(options.threads));
+    } else {
+        app.multithreaded();
+    }
+    std::cout << "Server started at http://" << options.host << ":" << options.port << " (crow)" << std::endl;
+    app.run();
+}
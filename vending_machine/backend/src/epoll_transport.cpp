@@ -0,0 +1,573 @@
+#include "transport.hpp"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Requests with more header bytes than this are refused with 431.
+constexpr std::size_t kMaxHeaderBytes = 8 * 1024;
+constexpr std::size_t kMaxBodyBytes = 1024 * 1024;
+// The largest request that can parse: headers, the blank line, a body.
+// The input buffer is read up to this, so a full buffer always starts
+// with a complete request.
+constexpr std::size_t kMaxRequestBytes = kMaxHeaderBytes + 4 + kMaxBodyBytes;
+// A pipelining client that stops reading its responses stops being read
+// once this much output is pending.
+constexpr std::size_t kMaxPendingOutput = 1024 * 1024;
+// Connections with nothing in flight for this long are closed, unless
+// TransportOptions::keepAliveSeconds says otherwise.
+constexpr int kDefaultIdleSeconds = 60;
+constexpr int kTickMillis = 1000;
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Query string decoding: '+' is a space and %XX a byte.
+std::string decodeComponent(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 &&
+                   hexValue(text[i + 2]) >= 0) {
+            out += static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+// One parsed request. The views point into the connection's input buffer
+// and are only valid until the request has been answered.
+class EpollRequest : public ApiRequest {
+public:
+    std::string_view method() const override { return methodView; }
+    std::string_view path() const override { return pathView; }
+    const std::string& body() const override { return bodyText; }
+    std::optional<std::chrono::steady_clock::time_point> queuedSince() const override { return readAt; }
+    std::string header(const std::string& name) const override {
+        for (const auto& [key, value] : headers) {
+            if (equalsIgnoreCase(key, name)) {
+                return std::string(value);
+            }
+        }
+        return std::string();
+    }
+    std::optional<std::string> param(const std::string& name) const override {
+        std::string_view rest = query;
+        while (!rest.empty()) {
+            const std::size_t amp = rest.find('&');
+            const std::string_view pair = rest.substr(0, amp);
+            rest = amp == std::string_view::npos ? std::string_view() : rest.substr(amp + 1);
+            const std::size_t eq = pair.find('=');
+            if (decodeComponent(pair.substr(0, eq)) == name) {
+                return eq == std::string_view::npos ? std::string() : decodeComponent(pair.substr(eq + 1));
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::string_view methodView;
+    std::string_view pathView;
+    std::string_view query;
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+    std::string bodyText;
+    bool keepAlive = true;
+    // When the loop woke up to read it; pipelined requests and requests
+    // behind a slow handler wait from there.
+    std::chrono::steady_clock::time_point readAt;
+};
+
+enum class Parse { Incomplete, Complete, Invalid, TooLarge, HeadersTooLarge, Unsupported };
+
+// Parses the request at the start of `input`; on Complete, `consumed` is
+// its length including the body.
+Parse parseRequest(std::string_view input, EpollRequest& request, std::size_t& consumed) {
+    const std::size_t headerEnd = input.find("\r\n\r\n");
+    if (headerEnd == std::string_view::npos) {
+        return input.size() > kMaxHeaderBytes ? Parse::HeadersTooLarge : Parse::Incomplete;
+    }
+    if (headerEnd > kMaxHeaderBytes) {
+        return Parse::HeadersTooLarge;
+    }
+    std::string_view head = input.substr(0, headerEnd);
+    const std::size_t lineEnd = head.find("\r\n");
+    const std::string_view requestLine = head.substr(0, lineEnd);
+    head = lineEnd == std::string_view::npos ? std::string_view() : head.substr(lineEnd + 2);
+
+    // METHOD SP target SP HTTP/1.x
+    const std::size_t sp1 = requestLine.find(' ');
+    const std::size_t sp2 = requestLine.find(' ', sp1 == std::string_view::npos ? sp1 : sp1 + 1);
+    if (sp1 == std::string_view::npos || sp2 == std::string_view::npos) {
+        return Parse::Invalid;
+    }
+    const std::string_view version = requestLine.substr(sp2 + 1);
+    if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+        return Parse::Invalid;
+    }
+    request.methodView = requestLine.substr(0, sp1);
+    const std::string_view target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    const std::size_t question = target.find('?');
+    request.pathView = target.substr(0, question);
+    request.query = question == std::string_view::npos ? std::string_view() : target.substr(question + 1);
+    request.keepAlive = version == "HTTP/1.1";
+
+    request.headers.clear();
+    std::size_t contentLength = 0;
+    while (!head.empty()) {
+        const std::size_t end = head.find("\r\n");
+        const std::string_view line = head.substr(0, end);
+        head = end == std::string_view::npos ? std::string_view() : head.substr(end + 2);
+        const std::size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0) {
+            return Parse::Invalid;
+        }
+        const std::string_view name = line.substr(0, colon);
+        const std::string_view value = trim(line.substr(colon + 1));
+        request.headers.emplace_back(name, value);
+        if (equalsIgnoreCase(name, "Content-Length")) {
+            contentLength = 0;
+            for (char c : value) {
+                if (c < '0' || c > '9' || contentLength > kMaxBodyBytes) {
+                    return c < '0' || c > '9' ? Parse::Invalid : Parse::TooLarge;
+                }
+                contentLength = contentLength * 10 + (c - '0');
+            }
+        } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+            return Parse::Unsupported;
+        } else if (equalsIgnoreCase(name, "Connection")) {
+            if (equalsIgnoreCase(value, "close")) {
+                request.keepAlive = false;
+            } else if (equalsIgnoreCase(value, "keep-alive")) {
+                request.keepAlive = true;
+            }
+        }
+    }
+    if (contentLength > kMaxBodyBytes) {
+        return Parse::TooLarge;
+    }
+    const std::size_t total = headerEnd + 4 + contentLength;
+    if (input.size() < total) {
+        return Parse::Incomplete;
+    }
+    request.bodyText.assign(input.data() + headerEnd + 4, contentLength);
+    consumed = total;
+    return Parse::Complete;
+}
+
+const char* reasonPhrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 422: return "Unprocessable Entity";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
+
+void appendResponse(std::string& out, const ApiResponse& response, bool keepAlive) {
+    out += "HTTP/1.1 ";
+    out += std::to_string(response.status);
+    out += ' ';
+    out += reasonPhrase(response.status);
+    out += "\r\n";
+    for (const auto& [name, value] : response.headers) {
+        out += name;
+        out += ": ";
+        out += value;
+        out += "\r\n";
+    }
+    if (!response.body.empty()) {
+        out += "Content-Type: ";
+        out += response.contentType;
+        out += "\r\n";
+    }
+    if (response.status != 304 && response.status != 204) {
+        out += "Content-Length: ";
+        out += std::to_string(response.body.size());
+        out += "\r\n";
+    }
+    if (!keepAlive) {
+        out += "Connection: close\r\n";
+    }
+    out += "\r\n";
+    out += response.body;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+int openListener(const TransportOptions& options) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // Every event loop listens on its own socket and the kernel spreads
+    // new connections across them.
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+        close(fd);
+        throw std::invalid_argument("Not an IPv4 address: " + options.host);
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, options.backlog) < 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(),
+                                "listen on " + options.host + ":" + std::to_string(options.port));
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+// One thread, one epoll instance and one listening socket. Sockets are
+// edge-triggered, so every handler reads or writes until EAGAIN.
+// Requests are answered on the loop thread; a handler that blocks (a
+// journal flush, an actor round trip) holds up that loop's other
+// connections, which is why there is a loop per core.
+class EventLoop {
+public:
+    EventLoop(VendingApi& api, const TransportOptions& options, std::atomic<long>& open)
+        : api(api), open(open),
+          idleTimeout(options.keepAliveSeconds > 0 ? options.keepAliveSeconds : kDefaultIdleSeconds),
+          maxRequests(options.keepAliveRequests), listenFd(openListener(options)), epollFd(epoll_create1(EPOLL_CLOEXEC)),
+          scratch(64 * 1024) {
+        if (epollFd < 0) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = nullptr;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    }
+
+    ~EventLoop() {
+        for (Connection& connection : connections) {
+            close(connection.fd);
+        }
+        close(epollFd);
+        close(listenFd);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void run() {
+        std::vector<epoll_event> events(256);
+        while (true) {
+            const int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), kTickMillis);
+            if (ready < 0 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "epoll_wait");
+            }
+            now = std::chrono::steady_clock::now();
+            for (int i = 0; i < ready; ++i) {
+                if (!events[i].data.ptr) {
+                    acceptAll();
+                } else {
+                    service(*static_cast<Connection*>(events[i].data.ptr));
+                }
+            }
+            if (now - lastSweep >= std::chrono::milliseconds(kTickMillis)) {
+                lastSweep = now;
+                closeIdle();
+                if (acceptPaused) {
+                    acceptAll();
+                }
+            }
+        }
+    }
+
+private:
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        // Bytes of `out` already sent.
+        std::size_t sent = 0;
+        std::chrono::steady_clock::time_point lastActive;
+        // Answer what is pending, then close.
+        bool closing = false;
+        std::size_t requests = 0;
+        std::list<Connection>::iterator self;
+    };
+
+    enum class Fill { Drained, Full, Closed };
+
+    void acceptAll() {
+        acceptPaused = false;
+        while (true) {
+            const int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                    // Out of descriptors: the listener will not signal
+                    // again for connections already queued, so retry on
+                    // the next tick.
+                    acceptPaused = true;
+                } else if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+            const int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            connections.push_back({fd, {}, {}, 0, now, false, 0, {}});
+            Connection& connection = connections.back();
+            connection.self = std::prev(connections.end());
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = &connection;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+                close(fd);
+                connections.pop_back();
+                continue;
+            }
+            open.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Reads, answers and writes until the socket has nothing more to give
+    // or cannot take more output.
+    void service(Connection& connection) {
+        touch(connection);
+        while (true) {
+            const Fill fill = connection.closing ? Fill::Drained : read(connection);
+            const std::size_t unread = connection.in.size();
+            const bool moreRequests = answer(connection);
+            if (!flush(connection)) {
+                destroy(connection);
+                return;
+            }
+            if (connection.sent < connection.out.size()) {
+                return;  // EPOLLOUT resumes once the client catches up
+            }
+            if (connection.closing || (fill == Fill::Closed && !moreRequests)) {
+                destroy(connection);
+                return;
+            }
+            // A full buffer is read again only once answering made room.
+            if (!moreRequests && (fill != Fill::Full || connection.in.size() == unread)) {
+                return;
+            }
+        }
+    }
+
+    Fill read(Connection& connection) {
+        while (connection.in.size() < kMaxRequestBytes) {
+            const ssize_t n = recv(connection.fd, scratch.data(), scratch.size(), 0);
+            if (n > 0) {
+                connection.in.append(scratch.data(), static_cast<std::size_t>(n));
+            } else if (n == 0) {
+                return Fill::Closed;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return Fill::Drained;
+            } else if (errno != EINTR) {
+                return Fill::Closed;
+            }
+        }
+        return Fill::Full;
+    }
+
+    // Answers every complete request in the input, in order, so pipelined
+    // requests get their responses back to back. Returns true if it
+    // stopped early with complete requests still waiting.
+    bool answer(Connection& connection) {
+        std::size_t offset = 0;
+        bool more = false;
+        while (!connection.closing) {
+            if (connection.out.size() - connection.sent >= kMaxPendingOutput) {
+                more = true;
+                break;
+            }
+            std::size_t consumed = 0;
+            Parse parse =
+                parseRequest(std::string_view(connection.in).substr(offset), request, consumed);
+            if (parse == Parse::Incomplete && offset == 0 && connection.in.size() >= kMaxRequestBytes) {
+                // Cannot happen given kMaxRequestBytes; refuse rather than
+                // wait on a buffer that will never be read further.
+                parse = Parse::TooLarge;
+            } else if (parse == Parse::Incomplete) {
+                break;
+            }
+            ApiResponse response;
+            if (parse == Parse::Complete) {
+                offset += consumed;
+                request.readAt = now;
+                try {
+                    api.handle(request, response);
+                } catch (const std::exception& e) {
+                    response = ApiResponse();
+                    response.set(500, e.what());
+                }
+                connection.closing =
+                    !request.keepAlive || (maxRequests > 0 && ++connection.requests >= maxRequests);
+            } else {
+                // The stream cannot be resynchronized after a bad request.
+                static const int kStatus[] = {0, 0, 400, 413, 431, 501};
+                response.set(kStatus[static_cast<int>(parse)], reasonPhrase(kStatus[static_cast<int>(parse)]));
+                connection.closing = true;
+            }
+            appendResponse(connection.out, response, !connection.closing);
+        }
+        connection.in.erase(0, offset);
+        return more;
+    }
+
+    // Writes pending output until done or EAGAIN; false on a dead socket.
+    bool flush(Connection& connection) {
+        while (connection.sent < connection.out.size()) {
+            const ssize_t n = send(connection.fd, connection.out.data() + connection.sent,
+                                   connection.out.size() - connection.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                connection.sent += static_cast<std::size_t>(n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        connection.out.clear();
+        connection.sent = 0;
+        // Idle connections are the common case at high counts; do not let
+        // one large response pin its buffers.
+        if (connection.out.capacity() > 64 * 1024) {
+            connection.out.shrink_to_fit();
+        }
+        if (connection.in.empty() && connection.in.capacity() > 64 * 1024) {
+            connection.in.shrink_to_fit();
+        }
+        return true;
+    }
+
+    // Keeps `connections` ordered by last activity, oldest first.
+    void touch(Connection& connection) {
+        connection.lastActive = now;
+        connections.splice(connections.end(), connections, connection.self);
+    }
+
+    void closeIdle() {
+        while (!connections.empty() && now - connections.front().lastActive >= idleTimeout) {
+            destroy(connections.front());
+        }
+    }
+
+    void destroy(Connection& connection) {
+        close(connection.fd);  // also removes it from the epoll set
+        open.fetch_sub(1, std::memory_order_relaxed);
+        connections.erase(connection.self);
+    }
+
+    VendingApi& api;
+    std::atomic<long>& open;
+    const std::chrono::seconds idleTimeout;
+    // Zero for no limit.
+    const std::size_t maxRequests;
+    int listenFd;
+    int epollFd;
+    std::vector<char> scratch;
+    std::list<Connection> connections;
+    EpollRequest request;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastSweep = now;
+    bool acceptPaused = false;
+};
+
+}  // namespace
+
+void serveEpoll(VendingApi& api, const TransportOptions& options) {
+    std::atomic<long> open{0};
+    api.metrics().gauge("vending_http_open_connections", "Client connections held open by the server.", {},
+                        [&open] { return static_cast<double>(open.load(std::memory_order_relaxed)); });
+
+    const std::size_t loops =
+        options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<int> cpus = pinningOrder(options.pinning);
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    for (std::size_t i = 0; i < loops; ++i) {
+        eventLoops.push_back(std::make_unique<EventLoop>(api, options, open));
+    }
+    std::cout << "Server started at http://" << options.host << ":" << options.port << " (epoll, " << loops
+              << " event loops)" << std::endl;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < loops; ++i) {
+        threads.emplace_back([&loop = *eventLoops[i], cpu = cpus.empty() ? -1 : cpus[i % cpus.size()]] {
+            if (cpu >= 0) {
+                pinCurrentThread(cpu);
+            }
+            loop.run();
+        });
+    }
+    if (!cpus.empty()) {
+        pinCurrentThread(cpus[0]);
+    }
+    eventLoops[0]->run();
+}
@@ -0,0 +1,117 @@
+#include "executor.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+// Lets schedule() recognize calls made from one of this executor's workers.
+thread_local const Executor* currentExecutor = nullptr;
+thread_local std::size_t currentWorker = 0;
+}
+
+Executor::Executor(ExecutorOptions options)
+    : workerCount(options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency())) {
+    workers.reset(new Worker[workerCount]);
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    threads.reserve(workerCount);
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        threads.emplace_back(&Executor::workerLoop, this, i);
+#ifdef __linux__
+        if (options.pinThreads) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cores, &set);
+            pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+        }
+#else
+        (void)cores;
+#endif
+    }
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        stopping = true;
+    }
+    idleCv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void Executor::schedule(Task* task) {
+    const std::size_t index = currentExecutor == this
+        ? currentWorker
+        : nextWorker.fetch_add(1, std::memory_order_relaxed) % workerCount;
+    // Counted before it is published, so the worker that takes it can never
+    // decrement first. Paired with the sleeper count in workerLoop: either
+    // the worker sees the new pending count before sleeping or this sees it
+    // as a sleeper.
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers[index].mtx);
+        workers[index].tasks.push_back(task);
+    }
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        idleCv.notify_one();
+    }
+}
+
+std::size_t Executor::threadCount() const {
+    return workerCount;
+}
+
+std::uint64_t Executor::steals() const {
+    return stealCount.load(std::memory_order_relaxed);
+}
+
+std::size_t Executor::queuedTasks() const {
+    return pending.load(std::memory_order_relaxed);
+}
+
+Task* Executor::take(std::size_t index) {
+    {
+        Worker& own = workers[index];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            Task* task = own.tasks.front();
+            own.tasks.pop_front();
+            return task;
+        }
+    }
+    for (std::size_t i = 1; i < workerCount; ++i) {
+        Worker& victim = workers[(index + i) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            Task* task = victim.tasks.back();
+            victim.tasks.pop_back();
+            stealCount.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void Executor::workerLoop(std::size_t index) {
+    currentExecutor = this;
+    currentWorker = index;
+    while (true) {
+        if (Task* task = take(index)) {
+            pending.fetch_sub(1);
+            task->run();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMtx);
+        sleepers.fetch_add(1);
+        idleCv.wait(lock, [this]() { return stopping || pending.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping && pending.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "fleet.hpp"
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+Fleet::Fleet(FleetOptions options, Executor* executor)
+    : options(options), executor(executor), shards(new Shard[options.registryShards ? options.registryShards : 1]) {
+    if (options.registryShards == 0) {
+        throw std::invalid_argument("Fleet needs at least one registry shard");
+    }
+}
+
+Fleet::Shard& Fleet::shardFor(const std::string& id) const {
+    return shards[std::hash<std::string>{}(id) % options.registryShards];
+}
+
+std::unique_ptr<VendingMachine> Fleet::createMachine() const {
+    TransactionLogOptions logOptions;
+    logOptions.queueCapacity = options.logQueueCapacity;
+    logOptions.retention = options.historyRetention;
+    return std::make_unique<VendingMachine>(std::make_unique<CashPayment>(),
+                                            std::make_unique<Inventory>(options.inventoryShards),
+                                            std::make_unique<TransactionLog>(logOptions),
+                                            nullptr,
+                                            std::make_unique<SessionStore>(options.sessionShards),
+                                            options.coinFloat >= 0 ? std::make_unique<CoinInventory>(options.coinFloat) : nullptr);
+}
+
+Fleet::Entry Fleet::makeEntry(std::unique_ptr<VendingMachine> machine) const {
+    Entry entry;
+    if (executor) {
+        entry.actor = std::make_unique<MachineActor>(*machine, *executor);
+    }
+    entry.machine = std::move(machine);
+    return entry;
+}
+
+void Fleet::claim() {
+    if (claimed.fetch_add(1, std::memory_order_relaxed) >= options.maxMachines && options.maxMachines > 0) {
+        unclaim();
+        throw FleetFull("Fleet is full (limit " + std::to_string(options.maxMachines) + ")");
+    }
+}
+
+void Fleet::unclaim() {
+    claimed.fetch_sub(1, std::memory_order_relaxed);
+}
+
+VendingMachine& Fleet::addMachine(const std::string& id) {
+    if (VendingMachine* existing = find(id)) {
+        return *existing;
+    }
+    claim();
+    // Built outside the lock; if another thread wins the race this one is
+    // simply dropped.
+    Entry entry;
+    try {
+        entry = makeEntry(createMachine());
+    } catch (...) {
+        unclaim();
+        throw;
+    }
+    Shard& shard = shardFor(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    auto& slot = shard.machines[id];
+    if (!slot.machine) {
+        slot = std::move(entry);
+    } else {
+        unclaim();
+    }
+    return *slot.machine;
+}
+
+VendingMachine& Fleet::addMachine(const std::string& id, std::unique_ptr<VendingMachine> machine) {
+    Shard& shard = shardFor(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.machines.find(id);
+    if (it != shard.machines.end() && it->second.machine) {
+        throw std::invalid_argument("Machine " + id + " already exists");
+    }
+    claim();
+    auto& slot = shard.machines[id];
+    slot = makeEntry(std::move(machine));
+    return *slot.machine;
+}
+
+VendingMachine* Fleet::find(const std::string& id) const {
+    Shard& shard = shardFor(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.machines.find(id);
+    return it == shard.machines.end() ? nullptr : it->second.machine.get();
+}
+
+std::optional<MachineHandle> Fleet::handle(const std::string& id) const {
+    Shard& shard = shardFor(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.machines.find(id);
+    if (it == shard.machines.end() || !it->second.machine) {
+        return std::nullopt;
+    }
+    return MachineHandle(*it->second.machine, it->second.actor.get());
+}
+
+std::size_t Fleet::size() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < options.registryShards; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mtx);
+        total += shards[i].machines.size();
+    }
+    return total;
+}
@@ -0,0 +1,174 @@
+#include "transport.hpp"
+
+namespace {
+// httplib's listen backlog is a macro; pointing it at a variable makes it
+// a runtime setting.
+int listenBacklog = 1024;
+}  // namespace
+#define CPPHTTPLIB_LISTEN_BACKLOG listenBacklog
+#include "httplib.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// When the connection a worker is serving was queued for it; cleared once
+// its first request has been dispatched, since later requests on the same
+// connection never wait in the queue.
+thread_local std::optional<std::chrono::steady_clock::time_point> connectionQueuedAt;
+
+class HttplibRequest : public ApiRequest {
+public:
+    HttplibRequest(const httplib::Request& req, std::optional<std::chrono::steady_clock::time_point> queuedAt)
+        : req(req), queuedAt(queuedAt) {}
+
+    std::string_view method() const override { return req.method; }
+    std::string_view path() const override { return req.path; }
+    const std::string& body() const override { return req.body; }
+    std::string header(const std::string& name) const override { return req.get_header_value(name); }
+    std::optional<std::string> param(const std::string& name) const override {
+        if (!req.has_param(name)) {
+            return std::nullopt;
+        }
+        return req.get_param_value(name);
+    }
+    std::optional<std::chrono::steady_clock::time_point> queuedSince() const override { return queuedAt; }
+
+private:
+    const httplib::Request& req;
+    std::optional<std::chrono::steady_clock::time_point> queuedAt;
+};
+
+// httplib's worker pool, counting accepted connections still waiting for a
+// worker. Workers pin themselves to the next CPU in `cpus` on their first
+// connection. With a queue limit, connections beyond it are closed at once.
+class CountedTaskQueue : public httplib::TaskQueue {
+public:
+    CountedTaskQueue(std::size_t threads, std::size_t queueLimit, std::vector<int> cpus, std::atomic<long>& queued)
+        : pool(threads, queueLimit), cpus(std::move(cpus)), queued(queued) {}
+
+    bool enqueue(std::function<void()> fn) override {
+        queued.fetch_add(1, std::memory_order_relaxed);
+        if (!pool.enqueue([this, fn = std::move(fn), queuedAt = std::chrono::steady_clock::now()] {
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                connectionQueuedAt = queuedAt;
+                thread_local bool pinned = false;
+                if (!pinned && !cpus.empty()) {
+                    pinned = true;
+                    pinCurrentThread(cpus[nextCpu.fetch_add(1, std::memory_order_relaxed) % cpus.size()]);
+                }
+                fn();
+            })) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void shutdown() override { pool.shutdown(); }
+
+private:
+    httplib::ThreadPool pool;
+    const std::vector<int> cpus;
+    std::atomic<std::size_t> nextCpu{0};
+    std::atomic<long>& queued;
+};
+
+}  // namespace
+
+void serveHttplib(VendingApi& api, InventoryStream& inventoryStream, const TransportOptions& options) {
+    httplib::Server svr;
+    // Without this a keep-alive response can sit behind the client's delayed
+    // ACK for ~40 ms.
+    svr.set_tcp_nodelay(true);
+
+    if (options.keepAliveRequests > 0) {
+        svr.set_keep_alive_max_count(options.keepAliveRequests);
+    }
+    if (options.keepAliveSeconds > 0) {
+        svr.set_keep_alive_timeout(options.keepAliveSeconds);
+    }
+    listenBacklog = options.backlog;
+
+    const std::size_t threads = options.threads > 0 ? options.threads : CPPHTTPLIB_THREAD_POOL_COUNT;
+    // A streaming subscriber keeps its worker until it disconnects, so the
+    // pool has one more worker per subscriber allowed; at most that many
+    // are ever streaming, leaving `threads` for everything else.
+    const std::size_t poolThreads = threads + options.streamSubscribers;
+    std::atomic<long> httpQueued{0};
+    svr.new_task_queue = [&httpQueued, &options, poolThreads] {
+        return new CountedTaskQueue(poolThreads, options.queueLimit, pinningOrder(options.pinning), httpQueued);
+    };
+    api.metrics().gauge("vending_http_queued_connections", "Accepted connections waiting for a server thread.", {},
+                        [&httpQueued] { return static_cast<double>(httpQueued.load(std::memory_order_relaxed)); });
+
+    // Server-Sent Events: a resync event first, then stock deltas as they
+    // happen (see InventoryStream). A comment line every 15 s keeps idle
+    // connections open and notices clients that went away. Each subscriber
+    // holds one of the workers set aside above while connected; past
+    // options.streamSubscribers the route answers 503.
+    std::atomic<std::size_t> subscribers{0};
+    api.metrics().gauge("vending_stream_subscribers", "Connected /api/items/stream subscribers.", {},
+                        [&subscribers] { return static_cast<double>(subscribers.load(std::memory_order_relaxed)); });
+    svr.Get("/api/items/stream", [&inventoryStream, &subscribers, &options](const httplib::Request &,
+                                                                          httplib::Response &res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        if (subscribers.fetch_add(1, std::memory_order_relaxed) >= options.streamSubscribers) {
+            subscribers.fetch_sub(1, std::memory_order_relaxed);
+            res.status = 503;
+            res.set_header("Retry-After", "30");
+            res.set_content("Too many stream subscribers", "text/plain");
+            return;
+        }
+        res.set_header("Cache-Control", "no-cache");
+        res.set_chunked_content_provider("text/event-stream",
+            [&inventoryStream, after = inventoryStream.latest(), greeted = false](std::size_t, httplib::DataSink &sink) mutable {
+                if (!greeted) {
+                    greeted = true;
+                    const std::string hello = inventoryStream.hello();
+                    return sink.write(hello.data(), hello.size());
+                }
+                std::vector<InventoryStream::Event> events;
+                if (!inventoryStream.wait(after, std::chrono::seconds(15), events)) {
+                    sink.done();
+                    return true;
+                }
+                if (events.empty()) {
+                    static const std::string keepAlive = ": keep-alive\n\n";
+                    return sink.write(keepAlive.data(), keepAlive.size());
+                }
+                for (const auto& event : events) {
+                    if (!sink.write(event->data(), event->size())) {
+                        return false;
+                    }
+                }
+                return true;
+            },
+            // Runs on the worker once the stream ends, however it ends.
+            [&subscribers](bool) { subscribers.fetch_sub(1, std::memory_order_relaxed); });
+    });
+
+    // Everything else goes to the API.
+    auto dispatch = [&api](const httplib::Request &req, httplib::Response &res) {
+        HttplibRequest request(req, connectionQueuedAt);
+        connectionQueuedAt.reset();
+        ApiResponse response;
+        api.handle(request, response);
+        res.status = response.status;
+        for (auto& [name, value] : response.headers) {
+            res.set_header(name, value);
+        }
+        if (!response.body.empty()) {
+            res.set_content(std::move(response.body), response.contentType);
+        }
+    };
+    svr.Get(".*", dispatch);
+    svr.Post(".*", dispatch);
+    svr.Options(".*", dispatch);
+
+    std::cout << "Server started at http://" << options.host << ":" << options.port << " (httplib, " << threads
+              << " threads)" << std::endl;
+    svr.listen(options.host, options.port);
+}
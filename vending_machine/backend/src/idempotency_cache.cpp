@@ -0,0 +1,146 @@
+#include "idempotency_cache.hpp"
+#include "vending_api.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Rough heap cost of a slot beyond its strings: the slot, the index node
+// and the response object.
+constexpr std::size_t kSlotOverhead = 160;
+
+std::size_t responseBytes(const ApiResponse& response) {
+    std::size_t bytes = response.body.size() + response.contentType.size();
+    for (const auto& [name, value] : response.headers) {
+        bytes += name.size() + value.size() + 64;
+    }
+    return bytes;
+}
+
+}  // namespace
+
+IdempotencyCache::IdempotencyCache(IdempotencyCacheOptions options)
+    : shardCapacity(std::max<std::size_t>(1, options.capacityBytes / std::max<std::size_t>(1, options.shards))),
+      shards(std::max<std::size_t>(1, options.shards)) {}
+
+IdempotencyCache::Shard& IdempotencyCache::shardFor(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % shards.size()];
+}
+
+IdempotencyCache::Outcome IdempotencyCache::begin(const std::string& key, std::uint64_t fingerprint,
+                                                  std::shared_ptr<const ApiResponse>& replay) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        Slot& slot = shard.ring[it->second];
+        if (slot.fingerprint != fingerprint) {
+            return Outcome::Mismatch;
+        }
+        if (!slot.response) {
+            return Outcome::InProgress;
+        }
+        slot.referenced = true;
+        replay = slot.response;
+        return Outcome::Replayed;
+    }
+
+    const std::size_t bytes = key.size() * 2 + kSlotOverhead;
+    // An empty shard still takes one key, however small the budget.
+    if (!evictFor(shard, bytes) && !shard.index.empty()) {
+        return Outcome::Full;
+    }
+    std::size_t index;
+    if (!shard.freeSlots.empty()) {
+        index = shard.freeSlots.back();
+        shard.freeSlots.pop_back();
+    } else {
+        index = shard.ring.size();
+        shard.ring.emplace_back();
+    }
+    Slot& slot = shard.ring[index];
+    slot.key = key;
+    slot.fingerprint = fingerprint;
+    slot.response.reset();
+    slot.bytes = bytes;
+    slot.used = true;
+    slot.referenced = false;
+    shard.bytes += bytes;
+    shard.index.emplace(key, index);
+    return Outcome::Started;
+}
+
+void IdempotencyCache::complete(const std::string& key, std::shared_ptr<const ApiResponse> response) {
+    Shard& shard = shardFor(key);
+    const std::size_t extra = responseBytes(*response);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return;
+    }
+    Slot& slot = shard.ring[it->second];
+    slot.response = std::move(response);
+    slot.bytes += extra;
+    // A retry usually comes soon after; give the entry one sweep's grace.
+    slot.referenced = true;
+    shard.bytes += extra;
+    // Make room for it now that it is evictable.
+    evictFor(shard, 0);
+}
+
+void IdempotencyCache::abandon(const std::string& key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end() && !shard.ring[it->second].response) {
+        release(shard, it->second);
+    }
+}
+
+void IdempotencyCache::release(Shard& shard, std::size_t index) {
+    Slot& slot = shard.ring[index];
+    shard.index.erase(slot.key);
+    shard.bytes -= slot.bytes;
+    slot = Slot();
+    shard.freeSlots.push_back(index);
+}
+
+bool IdempotencyCache::evictFor(Shard& shard, std::size_t needed) {
+    // Two passes over the ring clear every reference bit, so a sweep that
+    // goes further than that has found only requests still in progress.
+    std::size_t steps = 0;
+    while (shard.bytes + needed > shardCapacity && steps < shard.ring.size() * 2) {
+        const std::size_t index = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.ring.size();
+        ++steps;
+        Slot& slot = shard.ring[index];
+        if (!slot.used || !slot.response) {
+            continue;
+        }
+        if (slot.referenced) {
+            slot.referenced = false;
+            continue;
+        }
+        release(shard, index);
+        evicted.fetch_add(1, std::memory_order_relaxed);
+    }
+    return shard.bytes + needed <= shardCapacity;
+}
+
+std::size_t IdempotencyCache::size() const {
+    std::size_t total = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        total += shard.index.size();
+    }
+    return total;
+}
+
+std::size_t IdempotencyCache::bytes() const {
+    std::size_t total = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        total += shard.bytes;
+    }
+    return total;
+}
@@ -1,27 +1,407 @@
 #include "inventory.hpp"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
-void Inventory::addItem(const std::string& name, int quantity, double price) {
-    std::lock_guard<std::mutex> lock(mtx);
-    items[name] = { quantity, price };
+Inventory::Inventory(std::size_t shardCount)
+    : shardCount(shardCount), shards(new Shard[shardCount ? shardCount : 1]) {
+    if (shardCount == 0) {
+        throw std::invalid_argument("Inventory needs at least one shard");
+    }
 }
 
-bool Inventory::purchaseItem(const std::string& name) {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (items.count(name) && items[name].first > 0) {
-        items[name].first--;
-        return true;
+Inventory::Shard& Inventory::shardFor(std::uint32_t sku) const {
+    // SKU ids are dense, so they spread evenly without hashing.
+    return shards[sku % shardCount];
+}
+
+std::size_t Inventory::Shard::home(std::uint32_t sku) const {
+    // Fibonacci hashing: the top bits of the product mix in every bit of the
+    // id, including the low ones that already chose the shard.
+    return static_cast<std::size_t>((static_cast<std::uint64_t>(sku) * 0x9E3779B97F4A7C15ull) >> indexShift);
+}
+
+std::size_t Inventory::Shard::find(std::uint32_t sku) const {
+    if (index.empty()) {
+        return kNotFound;
+    }
+    const std::size_t mask = index.size() - 1;
+    for (std::size_t b = home(sku);; b = (b + 1) & mask) {
+        const std::uint64_t entry = index[b];
+        if (entry == 0) {
+            return kNotFound;
+        }
+        if ((entry >> 32) == sku) {
+            return static_cast<std::uint32_t>(entry) - 1;
+        }
+    }
+}
+
+std::size_t Inventory::Shard::findOrInsert(std::uint32_t sku) {
+    const std::size_t existing = find(sku);
+    if (existing != kNotFound) {
+        return existing;
+    }
+    reserve(count + 1);
+
+    const std::size_t slot = count++;
+    quantities[slot].store(0, std::memory_order_relaxed);
+    reserved[slot].store(0, std::memory_order_relaxed);
+    priceCents.push_back(0);
+    types.push_back(ItemType::Item);
+    attributes.push_back(0);
+    skus.push_back(sku);
+
+    const std::size_t mask = index.size() - 1;
+    std::size_t b = home(sku);
+    while (index[b] != 0) {
+        b = (b + 1) & mask;
+    }
+    index[b] = (static_cast<std::uint64_t>(sku) << 32) | (slot + 1);
+    return slot;
+}
+
+void Inventory::Shard::reserve(std::size_t items) {
+    if (items > capacity) {
+        const std::size_t grown = std::max(items, capacity * 2);
+        // Only called under the exclusive lock, so no purchase is touching
+        // the old stock column while it is copied.
+        std::unique_ptr<std::atomic<int>[]> moved(new std::atomic<int>[grown]);
+        std::unique_ptr<std::atomic<int>[]> movedReserved(new std::atomic<int>[grown]);
+        for (std::size_t i = 0; i < count; ++i) {
+            moved[i].store(quantities[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            movedReserved[i].store(reserved[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        quantities = std::move(moved);
+        reserved = std::move(movedReserved);
+        priceCents.reserve(grown);
+        types.reserve(grown);
+        attributes.reserve(grown);
+        skus.reserve(grown);
+        capacity = grown;
+    }
+    std::size_t buckets = std::max<std::size_t>(index.size(), 16);
+    while (buckets < items * 2) {
+        buckets *= 2;
+    }
+    if (buckets != index.size()) {
+        rehash(buckets);
+    }
+}
+
+void Inventory::Shard::rehash(std::size_t buckets) {
+    index.assign(buckets, 0);
+    indexShift = 64;
+    for (std::size_t b = buckets; b > 1; b >>= 1) {
+        --indexShift;
+    }
+    const std::size_t mask = buckets - 1;
+    for (std::size_t slot = 0; slot < count; ++slot) {
+        std::size_t b = home(skus[slot]);
+        while (index[b] != 0) {
+            b = (b + 1) & mask;
+        }
+        index[b] = (static_cast<std::uint64_t>(skus[slot]) << 32) | (slot + 1);
+    }
+}
+
+void Inventory::assign(Shard& shard, std::size_t slot, const ItemView& item) {
+    shard.quantities[slot].store(item.quantity, std::memory_order_relaxed);
+    shard.priceCents[slot] = item.price.toCents();
+    // Tags read back from disk index per-type arrays, so clamp unknown ones.
+    shard.types[slot] = static_cast<std::size_t>(item.type) < kItemTypeCount ? item.type : ItemType::Item;
+    shard.attributes[slot] = item.attribute;
+}
+
+void Inventory::addItem(const Item& item) {
+    const std::uint32_t sku = SkuTable::global().intern(item.name);
+    Shard& shard = shardFor(sku);
+    auto lock = lockExclusive(shard);
+    const std::size_t slot = shard.findOrInsert(sku);
+    assign(shard, slot, ItemView{item.name, item.price, item.quantity, item.type, item.attribute});
+    bumpVersion(shard);
+    requestResync();
+}
+
+void Inventory::load(std::size_t count, const std::function<ItemView(std::size_t)>& itemAt) {
+    const std::size_t workers = std::max<std::size_t>(
+        1, std::min<std::size_t>(shardCount, std::thread::hardware_concurrency()));
+    // The first exception any worker throws is rethrown once all joined.
+    auto parallel = [workers](const std::function<void(std::size_t)>& work) {
+        std::vector<std::exception_ptr> errors(workers);
+        auto guarded = [&work, &errors](std::size_t w) {
+            try {
+                work(w);
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t w = 1; w < workers; ++w) {
+            threads.emplace_back(guarded, w);
+        }
+        guarded(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+
+    // Pass one: every worker interns a contiguous range of names and
+    // buckets the items by shard, keeping each item and its id so pass two
+    // reads neither again.
+    struct Pending {
+        ItemView item;
+        std::uint32_t sku;
+    };
+    SkuTable::global().reserve(SkuTable::global().size() + count);
+    std::vector<std::vector<std::vector<Pending>>> buckets(
+        workers, std::vector<std::vector<Pending>>(shardCount));
+    parallel([&](std::size_t w) {
+        const std::size_t begin = count * w / workers;
+        const std::size_t end = count * (w + 1) / workers;
+        for (std::size_t i = begin; i < end; ++i) {
+            const ItemView item = itemAt(i);
+            const std::uint32_t sku = SkuTable::global().intern(item.name);
+            buckets[w][sku % shardCount].push_back({item, sku});
+        }
+    });
+
+    // Pass two: every worker owns a disjoint set of shards and fills them.
+    parallel([&](std::size_t w) {
+        for (std::size_t s = w; s < shardCount; s += workers) {
+            Shard& shard = shards[s];
+            std::unique_lock<std::shared_mutex> lock(shard.mtx);
+            std::size_t total = shard.count;
+            for (const auto& perWorker : buckets) {
+                total += perWorker[s].size();
+            }
+            shard.reserve(total);
+            for (const auto& perWorker : buckets) {
+                for (const Pending& pending : perWorker[s]) {
+                    assign(shard, shard.findOrInsert(pending.sku), pending.item);
+                }
+            }
+            bumpVersion(shard);
+        }
+    });
+    requestResync();
+}
+
+bool Inventory::take(std::atomic<int>& quantity, int count) {
+    int current = quantity.load(std::memory_order_relaxed);
+    while (current >= count) {
+        if (quantity.compare_exchange_weak(current, current - count,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+            return true;
+        }
     }
     return false;
 }
 
+bool Inventory::purchaseItem(const std::string& name) {
+    return purchaseItem(name, [](Money) { return true; });
+}
+
+bool Inventory::takeCart(const std::vector<CartLine>& cart, CartHold& hold) {
+    std::vector<std::uint32_t> lineSkus;
+    std::vector<std::size_t> shardIndexes;
+    lineSkus.reserve(cart.size());
+    for (const auto& line : cart) {
+        lineSkus.push_back(SkuTable::global().find(line.name));
+        if (lineSkus.back() == SkuTable::kNone) {
+            return false;
+        }
+        shardIndexes.push_back(lineSkus.back() % shardCount);
+    }
+    // Each shard is locked once and in index order, so checkouts with
+    // overlapping carts cannot deadlock against each other or a writer.
+    std::sort(shardIndexes.begin(), shardIndexes.end());
+    shardIndexes.erase(std::unique(shardIndexes.begin(), shardIndexes.end()), shardIndexes.end());
+    for (std::size_t s : shardIndexes) {
+        hold.locks.push_back(lockShared(shards[s]));
+    }
+
+    hold.slots.reserve(cart.size());
+    for (std::size_t i = 0; i < cart.size(); ++i) {
+        Shard& shard = shardFor(lineSkus[i]);
+        const std::size_t slot = shard.find(lineSkus[i]);
+        if (slot == kNotFound || !take(shard.quantities[slot], cart[i].quantity)) {
+            putBack(cart, hold);
+            return false;
+        }
+        hold.slots.emplace_back(&shard, slot);
+        changed(shard, slot);
+    }
+    return true;
+}
+
+void Inventory::putBack(const std::vector<CartLine>& cart, const CartHold& hold) {
+    for (std::size_t i = 0; i < hold.slots.size(); ++i) {
+        const auto& [shard, slot] = hold.slots[i];
+        shard->quantities[slot].fetch_add(cart[i].quantity, std::memory_order_acq_rel);
+        changed(*shard, slot);
+    }
+}
+
 void Inventory::refillItem(const std::string& name, int quantity) {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (items.count(name)) {
-        items[name].first += quantity;
+    const std::uint32_t sku = SkuTable::global().find(name);
+    if (sku != SkuTable::kNone) {
+        refillItem(sku, quantity);
+    }
+}
+
+void Inventory::refillItem(std::uint32_t sku, int quantity) {
+    Shard& shard = shardFor(sku);
+    auto lock = lockShared(shard);
+    const std::size_t slot = shard.find(sku);
+    if (slot != kNotFound) {
+        shard.quantities[slot].fetch_add(quantity, std::memory_order_acq_rel);
+        changed(shard, slot);
+    }
+}
+
+bool Inventory::reserve(std::uint32_t sku, int quantity) {
+    Shard& shard = shardFor(sku);
+    auto lock = lockShared(shard);
+    const std::size_t slot = shard.find(sku);
+    if (slot == kNotFound || !take(shard.quantities[slot], quantity)) {
+        return false;
+    }
+    shard.reserved[slot].fetch_add(quantity, std::memory_order_acq_rel);
+    changed(shard, slot);
+    return true;
+}
+
+void Inventory::release(std::uint32_t sku, int quantity) {
+    Shard& shard = shardFor(sku);
+    auto lock = lockShared(shard);
+    const std::size_t slot = shard.find(sku);
+    if (slot != kNotFound) {
+        shard.reserved[slot].fetch_sub(quantity, std::memory_order_acq_rel);
+        shard.quantities[slot].fetch_add(quantity, std::memory_order_acq_rel);
+        changed(shard, slot);
+    }
+}
+
+std::size_t Inventory::size() const {
+    std::size_t total = 0;
+    for (std::size_t s = 0; s < shardCount; ++s) {
+        std::shared_lock<std::shared_mutex> lock(shards[s].mtx);
+        total += shards[s].count;
+    }
+    return total;
+}
+
+Inventory::StockByType Inventory::stockByType() const {
+    StockByType result{};
+    std::array<std::int64_t, kItemTypeCount> valueCents{};
+    for (std::size_t s = 0; s < shardCount; ++s) {
+        const Shard& shard = shards[s];
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        // Only the type, stock and price columns are read.
+        for (std::size_t i = 0; i < shard.count; ++i) {
+            const auto type = static_cast<std::size_t>(shard.types[i]);
+            const std::int64_t units = shard.quantities[i].load(std::memory_order_relaxed);
+            result[type].skus += 1;
+            result[type].units += units;
+            valueCents[type] += units * shard.priceCents[i];
+        }
+    }
+    for (std::size_t t = 0; t < kItemTypeCount; ++t) {
+        result[t].value = Money::fromCents(valueCents[t]);
+    }
+    return result;
+}
+
+std::uint64_t Inventory::getVersion() const {
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        total += shards[i].version.load(std::memory_order_acquire);
     }
+    return total;
 }
 
-std::map<std::string, std::pair<int, double>> Inventory::getItems() {
-    std::lock_guard<std::mutex> lock(mtx);
-    return items;
-}
\ No newline at end of file
+Inventory::LockWaits Inventory::lockWaits() const {
+    LockWaits total;
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        total.count += shards[i].waits.load(std::memory_order_relaxed);
+        total.nanos += shards[i].waitNanos.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Inventory::waitShared(std::shared_lock<std::shared_mutex>& lock, const Shard& shard) {
+    const auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    shard.waits.fetch_add(1, std::memory_order_relaxed);
+    shard.waitNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start).count(),
+                              std::memory_order_relaxed);
+}
+
+void Inventory::waitExclusive(std::unique_lock<std::shared_mutex>& lock, Shard& shard) {
+    const auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    shard.waits.fetch_add(1, std::memory_order_relaxed);
+    shard.waitNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start).count(),
+                              std::memory_order_relaxed);
+}
+
+void Inventory::bumpVersion(Shard& shard) {
+    shard.version.fetch_add(1, std::memory_order_release);
+}
+
+void Inventory::changed(Shard& shard, std::size_t slot) {
+    bumpVersion(shard);
+    if (feed && !feed->tryPush(shard.skus[slot])) {
+        requestResync();
+    }
+}
+
+void Inventory::requestResync() {
+    if (feed) {
+        resync.store(true, std::memory_order_release);
+    }
+}
+
+void Inventory::enableChangeFeed(std::size_t capacity) {
+    feed = std::make_unique<MpscQueue<std::uint32_t>>(capacity);
+}
+
+bool Inventory::drainChanges(std::vector<ItemChange>& out) {
+    if (!feed) {
+        return false;
+    }
+    // Clear the flag before draining, so a resync requested meanwhile is
+    // reported by this call or the next one, never lost.
+    const bool complete = !resync.exchange(false, std::memory_order_acq_rel);
+    feedScratch.clear();
+    std::uint32_t id;
+    while (feed->tryPop(id)) {
+        feedScratch.push_back(id);
+    }
+    feed->publishConsumed();
+    std::sort(feedScratch.begin(), feedScratch.end());
+    feedScratch.erase(std::unique(feedScratch.begin(), feedScratch.end()), feedScratch.end());
+    for (std::uint32_t sku : feedScratch) {
+        const Shard& shard = shardFor(sku);
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        const std::size_t slot = shard.find(sku);
+        if (slot != kNotFound) {
+            out.push_back({sku, shard.quantities[slot].load(std::memory_order_acquire)});
+        }
+    }
+    return complete;
+}
@@ -0,0 +1,93 @@
+#include "inventory_stream.hpp"
+
+InventoryStream::InventoryStream(VendingMachine& machine, InventoryStreamOptions options)
+    : machine(machine), options(options) {
+    machine.enableChangeFeed(options.feedCapacity);
+    publisher = std::thread(&InventoryStream::run, this);
+}
+
+InventoryStream::~InventoryStream() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    publisher.join();
+}
+
+std::uint64_t InventoryStream::latest() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return sequence;
+}
+
+std::string InventoryStream::hello() const {
+    return resyncEvent();
+}
+
+bool InventoryStream::wait(std::uint64_t& after, std::chrono::milliseconds timeout, std::vector<Event>& out) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait_for(lock, timeout, [this, after]() { return sequence > after || stopping; });
+    if (stopping) {
+        return false;
+    }
+    if (sequence == after) {
+        return true;
+    }
+    const std::uint64_t oldest = sequence - events.size() + 1;
+    if (after + 1 < oldest) {
+        // Too far behind to replay what was missed.
+        out.push_back(std::make_shared<const std::string>(resyncEvent()));
+    } else {
+        for (std::uint64_t s = after + 1; s <= sequence; ++s) {
+            out.push_back(events[s - oldest]);
+        }
+    }
+    after = sequence;
+    return true;
+}
+
+std::string InventoryStream::resyncEvent() const {
+    return "event: resync\ndata: {\"version\":" + std::to_string(machine.getCatalogVersion()) + "}\n\n";
+}
+
+void InventoryStream::publish(std::string event) {
+    auto shared = std::make_shared<const std::string>(std::move(event));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        events.push_back(std::move(shared));
+        if (events.size() > options.history) {
+            events.pop_front();
+        }
+        ++sequence;
+    }
+    cv.notify_all();
+}
+
+void InventoryStream::run() {
+    std::vector<ItemChange> changes;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        cv.wait_for(lock, options.interval, [this]() { return stopping; });
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        changes.clear();
+        if (!machine.drainItemChanges(changes)) {
+            publish(resyncEvent());
+        } else if (!changes.empty()) {
+            std::string event = "event: delta\ndata: {\"version\":" + std::to_string(machine.getCatalogVersion()) +
+                                ",\"items\":[";
+            for (std::size_t i = 0; i < changes.size(); ++i) {
+                event += i ? ",[" : "[";
+                event += std::to_string(changes[i].id);
+                event += ',';
+                event += std::to_string(changes[i].quantity);
+                event += ']';
+            }
+            event += "]}\n\n";
+            publish(std::move(event));
+        }
+        lock.lock();
+    }
+}
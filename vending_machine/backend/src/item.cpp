@@ -0,0 +1,22 @@
+#include "item.hpp"
+#include <utility>
+
+const char* itemTypeName(ItemType type) {
+    switch (type) {
+    case ItemType::Beverage:
+        return "Beverage";
+    case ItemType::Snack:
+        return "Snack";
+    case ItemType::Item:
+        break;
+    }
+    return "Item";
+}
+
+Item Item::beverage(std::string name, Money price, int quantity, std::int32_t volumeMl) {
+    return Item{std::move(name), price, quantity, ItemType::Beverage, volumeMl};
+}
+
+Item Item::snack(std::string name, Money price, int quantity, std::int32_t weightGrams) {
+    return Item{std::move(name), price, quantity, ItemType::Snack, weightGrams};
+}
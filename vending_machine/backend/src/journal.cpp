@@ -0,0 +1,438 @@
+#include "journal.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define JOURNAL_OPEN(path) ::_open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644)
+#define JOURNAL_WRITE ::_write
+#define JOURNAL_SYNC ::_commit
+#define JOURNAL_TRUNCATE ::_chsize_s
+#define JOURNAL_CLOSE ::_close
+#else
+#include <unistd.h>
+#define JOURNAL_OPEN(path) ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)
+#define JOURNAL_WRITE ::write
+#ifdef __APPLE__
+#define JOURNAL_SYNC ::fsync
+#else
+#define JOURNAL_SYNC ::fdatasync
+#endif
+#define JOURNAL_TRUNCATE ::ftruncate
+#define JOURNAL_CLOSE ::close
+#endif
+
+namespace {
+
+constexpr std::size_t kHeaderSize = 4 + 4 + 8 + 1 + 8 + 8 + 4 + 2 + 2;
+constexpr std::size_t kItemTypeSize = 1 + 4;
+constexpr std::size_t kCoinDeltaSize = 1 + 4 + 4;
+constexpr std::uint8_t kCoinsFlag = 0x80;
+
+std::array<std::uint32_t, 256> makeCrcTable() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+std::uint32_t crc32(const char* data, std::size_t size) {
+    static const std::array<std::uint32_t, 256> table = makeCrcTable();
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; ++i) {
+        c = table[(c ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void put(char*& out, T value) {
+    std::memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+template <typename T>
+T take(const char*& in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+}  // namespace
+
+Journal::Journal(JournalOptions options) : options(std::move(options)) {
+    // Continue the sequence of an existing journal and cut off a torn tail
+    // left by a crash, together with any group it left incomplete, so new
+    // records are not appended after garbage or counted into that group.
+    for (const auto& segment : segments(this->options.path)) {
+        if (segment != this->options.path) {
+            nextLsn = std::max(nextLsn, segmentLastLsn(this->options.path, segment) + 1);
+        }
+    }
+    std::vector<char> existing = load(this->options.path);
+    const char* cursor = existing.data();
+    const char* end = existing.data() + existing.size();
+    JournalRecord record;
+    const char* groupStart = nullptr;
+    std::uint64_t groupLsn = 0;
+    std::size_t groupRemaining = 0;
+    for (const char* start = cursor; decode(cursor, end, record); start = cursor) {
+        if (record.type == JournalRecordType::Group && record.quantity > 0) {
+            groupStart = start;
+            groupLsn = record.lsn;
+            groupRemaining = static_cast<std::size_t>(record.quantity);
+        } else if (groupRemaining > 0 && --groupRemaining == 0) {
+            groupStart = nullptr;
+        }
+        nextLsn = record.lsn + 1;
+    }
+    if (groupStart) {
+        cursor = groupStart;
+        nextLsn = groupLsn;
+    }
+    durable = nextLsn - 1;
+
+    fd = JOURNAL_OPEN(this->options.path.c_str());
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open journal " + this->options.path + ": " + std::strerror(errno));
+    }
+    if (cursor != end && JOURNAL_TRUNCATE(fd, cursor - existing.data()) != 0) {
+        JOURNAL_CLOSE(fd);
+        throw std::runtime_error("Cannot truncate torn journal tail: " + std::string(std::strerror(errno)));
+    }
+    flusher = std::thread(&Journal::flushLoop, this);
+}
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    pendingCv.notify_one();
+    flusher.join();
+    JOURNAL_CLOSE(fd);
+}
+
+std::uint64_t Journal::append(const std::vector<JournalRecord>& records) {
+    for (const JournalRecord& record : records) {
+        checkNames(record);
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writeError.empty()) {
+        throw JournalFailure(writeError);
+    }
+    JournalRecord marker;
+    marker.type = JournalRecordType::Group;
+    marker.quantity = static_cast<std::int32_t>(records.size());
+    marker.timestamp = records.empty() ? 0 : records.front().timestamp;
+    marker.lsn = nextLsn++;
+    encode(marker, pending);
+    for (JournalRecord record : records) {
+        record.lsn = nextLsn++;
+        encode(record, pending);
+    }
+    const std::size_t before = pendingRecords;
+    pendingRecords += records.size() + 1;
+    if (before == 0 || pendingRecords >= options.maxBatchRecords) {
+        pendingCv.notify_one();
+    }
+    return nextLsn - 1;
+}
+
+std::uint64_t Journal::append(JournalRecord record) {
+    checkNames(record);
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writeError.empty()) {
+        throw JournalFailure(writeError);
+    }
+    // The LSN is assigned under the same lock that orders the buffer, so
+    // file order and LSN order always agree.
+    record.lsn = nextLsn++;
+    encode(record, pending);
+    if (++pendingRecords == 1 || pendingRecords >= options.maxBatchRecords) {
+        pendingCv.notify_one();
+    }
+    return record.lsn;
+}
+
+void Journal::waitDurable(std::uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mtx);
+    durableCv.wait(lock, [this, lsn]() { return durable >= lsn || !writeError.empty(); });
+    if (durable < lsn) {
+        throw JournalFailure(writeError);
+    }
+}
+
+std::uint64_t Journal::commit(JournalRecord record) {
+    std::uint64_t lsn = append(std::move(record));
+    waitDurable(lsn);
+    return lsn;
+}
+
+std::uint64_t Journal::durableLsn() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return durable;
+}
+
+std::uint64_t Journal::batchesWritten() const {
+    return batches.load(std::memory_order_relaxed);
+}
+
+bool Journal::failed() const {
+    return failure.load(std::memory_order_acquire);
+}
+
+const std::string& Journal::path() const {
+    return options.path;
+}
+
+std::uint64_t Journal::rotate() {
+    std::unique_lock<std::mutex> lock(mtx);
+    pendingCv.notify_one();
+    durableCv.wait(lock, [this]() { return durable + 1 == nextLsn || !writeError.empty(); });
+    if (!writeError.empty()) {
+        throw JournalFailure(writeError);
+    }
+    const std::uint64_t last = nextLsn - 1;
+    std::error_code ec;
+    if (std::filesystem::file_size(options.path, ec) == 0) {
+        return last;
+    }
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%020llu", static_cast<unsigned long long>(last));
+    JOURNAL_CLOSE(fd);
+    std::filesystem::rename(options.path, options.path + suffix, ec);
+    fd = JOURNAL_OPEN(options.path.c_str());
+    if (ec || fd < 0) {
+        writeError = "Journal rotation failed: " + (ec ? ec.message() : std::string(std::strerror(errno)));
+        failure.store(true, std::memory_order_release);
+        throw JournalFailure(writeError);
+    }
+    return last;
+}
+
+void Journal::removeSegmentsThrough(std::uint64_t lsn) {
+    for (const auto& segment : segments(options.path)) {
+        if (segment != options.path && segmentLastLsn(options.path, segment) <= lsn) {
+            std::error_code ec;
+            std::filesystem::remove(segment, ec);
+        }
+    }
+}
+
+void Journal::advancePast(std::uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (nextLsn <= lsn) {
+        nextLsn = lsn + 1;
+        durable = lsn;
+    }
+}
+
+std::vector<std::string> Journal::segments(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> result;
+    const fs::path active(path);
+    const std::string prefix = active.filename().string() + ".";
+    std::error_code ec;
+    fs::path dir = active.parent_path().empty() ? fs::path(".") : active.parent_path();
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() == prefix.size() + 20 && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+            result.push_back((active.parent_path() / name).string());
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.push_back(path);
+    return result;
+}
+
+std::uint64_t Journal::segmentLastLsn(const std::string& path, const std::string& segment) {
+    return std::stoull(segment.substr(path.size() + 1));
+}
+
+void Journal::checkNames(const JournalRecord& record) {
+    // Truncating instead would replay the change against another item or
+    // session.
+    if (record.item.size() > kMaxNameBytes || record.session.size() > kMaxNameBytes) {
+        throw std::invalid_argument("Item name or session id too long to journal");
+    }
+}
+
+void Journal::encode(const JournalRecord& record, std::vector<char>& out) {
+    const std::size_t itemLen = record.item.size();
+    const std::size_t sessionLen = record.session.size();
+    // Older records carry no type, so untyped items still omit it.
+    const bool typed = record.itemType != ItemType::Item || record.attribute != 0;
+    const std::size_t coinsSize = record.coins.empty() ? 0 : 1 + record.coins.size() * kCoinDeltaSize;
+    const std::size_t size = kHeaderSize + itemLen + sessionLen + coinsSize + (typed ? kItemTypeSize : 0);
+    const std::size_t offset = out.size();
+    out.resize(offset + size);
+
+    char* p = out.data() + offset;
+    put<std::uint32_t>(p, static_cast<std::uint32_t>(size));
+    char* crcField = p;
+    p += 4;
+    put<std::uint64_t>(p, record.lsn);
+    put<std::uint8_t>(p, static_cast<std::uint8_t>(record.type) | (coinsSize ? kCoinsFlag : 0));
+    put<std::int64_t>(p, record.timestamp);
+    put<std::int64_t>(p, record.amount.toCents());
+    put<std::int32_t>(p, record.quantity);
+    put<std::uint16_t>(p, static_cast<std::uint16_t>(itemLen));
+    put<std::uint16_t>(p, static_cast<std::uint16_t>(sessionLen));
+    std::memcpy(p, record.item.data(), itemLen);
+    std::memcpy(p + itemLen, record.session.data(), sessionLen);
+    p += itemLen + sessionLen;
+    if (coinsSize) {
+        put<std::uint8_t>(p, static_cast<std::uint8_t>(record.coins.size()));
+        for (const CoinDelta& delta : record.coins) {
+            put<std::uint8_t>(p, delta.denomination);
+            put<std::int32_t>(p, delta.stock);
+            put<std::int32_t>(p, delta.setAside);
+        }
+    }
+    if (typed) {
+        put<std::uint8_t>(p, static_cast<std::uint8_t>(record.itemType));
+        put<std::int32_t>(p, record.attribute);
+    }
+
+    std::uint32_t crc = crc32(crcField + 4, size - 8);
+    std::memcpy(crcField, &crc, sizeof(crc));
+}
+
+bool Journal::decode(const char*& cursor, const char* end, JournalRecord& record) {
+    if (end - cursor < static_cast<std::ptrdiff_t>(kHeaderSize)) {
+        return false;
+    }
+    const char* p = cursor;
+    std::uint32_t size = take<std::uint32_t>(p);
+    if (size < kHeaderSize || static_cast<std::size_t>(end - cursor) < size) {
+        return false;
+    }
+    std::uint32_t crc = take<std::uint32_t>(p);
+    if (crc != crc32(p, size - 8)) {
+        return false;
+    }
+    record.lsn = take<std::uint64_t>(p);
+    const std::uint8_t type = take<std::uint8_t>(p);
+    record.type = static_cast<JournalRecordType>(type & ~kCoinsFlag);
+    record.timestamp = take<std::int64_t>(p);
+    record.amount = Money::fromCents(take<std::int64_t>(p));
+    record.quantity = take<std::int32_t>(p);
+    std::uint16_t itemLen = take<std::uint16_t>(p);
+    std::uint16_t sessionLen = take<std::uint16_t>(p);
+    std::size_t untypedSize = kHeaderSize + itemLen + sessionLen;
+    if (size < untypedSize) {
+        return false;
+    }
+    record.item.assign(p, itemLen);
+    record.session.assign(p + itemLen, sessionLen);
+    p += itemLen + sessionLen;
+    record.coins.clear();
+    if (type & kCoinsFlag) {
+        if (size < untypedSize + 1) {
+            return false;
+        }
+        const std::size_t count = take<std::uint8_t>(p);
+        untypedSize += 1 + count * kCoinDeltaSize;
+        if (size < untypedSize) {
+            return false;
+        }
+        record.coins.resize(count);
+        for (CoinDelta& delta : record.coins) {
+            delta.denomination = take<std::uint8_t>(p);
+            delta.stock = take<std::int32_t>(p);
+            delta.setAside = take<std::int32_t>(p);
+        }
+    }
+    if (size != untypedSize && size != untypedSize + kItemTypeSize) {
+        return false;
+    }
+    record.itemType = ItemType::Item;
+    record.attribute = 0;
+    if (size != untypedSize) {
+        record.itemType = static_cast<ItemType>(take<std::uint8_t>(p));
+        record.attribute = take<std::int32_t>(p);
+    }
+    cursor += size;
+    return true;
+}
+
+std::vector<char> Journal::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void Journal::flushLoop() {
+    std::vector<char> batch;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        pendingCv.wait(lock, [this]() { return pendingRecords > 0 || stopping; });
+        if (pendingRecords == 0 && stopping) {
+            return;
+        }
+        // Group commit window: give other producers a chance to join this
+        // batch unless it is already full or we are shutting down.
+        if (options.flushInterval.count() > 0 && !stopping) {
+            pendingCv.wait_for(lock, options.flushInterval, [this]() {
+                return pendingRecords >= options.maxBatchRecords || stopping;
+            });
+        }
+        std::uint64_t batchEnd = nextLsn - 1;
+        batch.swap(pending);
+        pending.clear();
+        pendingRecords = 0;
+
+        lock.unlock();
+        std::string error;
+        try {
+            writeAll(batch);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        lock.lock();
+
+        if (error.empty()) {
+            durable = batchEnd;
+            batches.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            writeError = error;
+            failure.store(true, std::memory_order_release);
+        }
+        durableCv.notify_all();
+    }
+}
+
+void Journal::writeAll(const std::vector<char>& batch) {
+    const char* data = batch.data();
+    std::size_t left = batch.size();
+    while (left > 0) {
+        auto written = JOURNAL_WRITE(fd, data, static_cast<unsigned>(left));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Journal write failed: " + std::string(std::strerror(errno)));
+        }
+        data += written;
+        left -= static_cast<std::size_t>(written);
+    }
+    if (options.sync && JOURNAL_SYNC(fd) != 0) {
+        throw std::runtime_error("Journal sync failed: " + std::string(std::strerror(errno)));
+    }
+}
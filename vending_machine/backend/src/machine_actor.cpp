@@ -0,0 +1,98 @@
+#include "machine_actor.hpp"
+#include <thread>
+
+MachineActor::MachineActor(VendingMachine& machine, Executor& executor)
+    : vendingMachine(machine), executor(executor), head(&stub), tail(&stub) {}
+
+MachineActor::~MachineActor() {
+    // Posting sets `scheduled` and a turn leaves `running` last, so once
+    // both are clear no worker can touch this actor again.
+    while (scheduled.load() || running.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+VendingMachine& MachineActor::machine() const {
+    return vendingMachine;
+}
+
+std::future<void> MachineActor::insertMoney(const std::string& sessionId, Money amount) {
+    return ask([sessionId, amount](VendingMachine& machine) { machine.insertMoney(sessionId, amount); });
+}
+
+std::future<bool> MachineActor::purchaseItem(const std::string& sessionId, const std::string& itemName) {
+    return ask([sessionId, itemName](VendingMachine& machine) { return machine.purchaseItem(sessionId, itemName); });
+}
+
+std::future<Money> MachineActor::returnChange(const std::string& sessionId) {
+    return ask([sessionId](VendingMachine& machine) { return machine.returnChange(sessionId); });
+}
+
+std::future<void> MachineActor::refillItem(const std::string& itemName, int quantity) {
+    return ask([itemName, quantity](VendingMachine& machine) { machine.refillItem(itemName, quantity); });
+}
+
+void MachineActor::post(Message* message) {
+    push(message);
+    // Whoever flips `scheduled` from false hands the actor to the executor;
+    // run() clears it before its final mailbox check, so no message is left
+    // behind with nobody scheduled to run it.
+    if (!scheduled.exchange(true)) {
+        executor.schedule(this);
+    }
+}
+
+void MachineActor::push(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = head.exchange(node);
+    previous->next.store(node, std::memory_order_release);
+}
+
+MachineActor::Message* MachineActor::pop() {
+    Node* first = tail;
+    Node* next = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+        if (!next) {
+            return nullptr;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        tail = next;
+        return static_cast<Message*>(first);
+    }
+    // `first` is the newest message unless a producer is between its swap
+    // and its link; in that case try again on the next turn.
+    if (first != head.load()) {
+        return nullptr;
+    }
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return static_cast<Message*>(first);
+    }
+    return nullptr;
+}
+
+void MachineActor::run() {
+    running.fetch_add(1);
+    for (int i = 0; i < kBatch; ++i) {
+        Message* message = pop();
+        if (!message) {
+            break;
+        }
+        message->run(vendingMachine);
+        delete message;
+    }
+    // Once `scheduled` is clear another worker may start a turn, so only the
+    // atomic head is read after it.
+    const bool drained = tail == &stub;
+    scheduled.store(false);
+    if ((!drained || head.load() != &stub) && !scheduled.exchange(true)) {
+        executor.schedule(this);
+    }
+    running.fetch_sub(1);
+}
@@ -0,0 +1,188 @@
+#include "metrics.hpp"
+#include <cstdio>
+#include <stdexcept>
+
+namespace metrics_detail {
+
+// Bit i set while private stripe i is leased; the last stripe is shared.
+static std::atomic<std::uint32_t> leased{0};
+
+Lease::Lease() : stripe(kStripes - 1), owned(false) {
+    std::uint32_t taken = leased.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i + 1 < kStripes; ++i) {
+        const std::uint32_t bit = std::uint32_t(1) << i;
+        // Acquire pairs with the release in ~Lease, so the previous owner's
+        // stores are seen before this thread adds to them.
+        while (!(taken & bit)) {
+            if (leased.compare_exchange_weak(taken, taken | bit, std::memory_order_acquire)) {
+                stripe = i;
+                owned = true;
+                return;
+            }
+        }
+    }
+}
+
+Lease::~Lease() {
+    if (owned) {
+        leased.fetch_and(~(std::uint32_t(1) << stripe), std::memory_order_release);
+    }
+}
+
+}  // namespace metrics_detail
+
+std::uint64_t Counter::value() const {
+    std::uint64_t total = 0;
+    for (const Cell& cell : cells) {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t LatencyHistogram::bucketLimit(std::size_t bucket) {
+    if (bucket < 2) {
+        return bucket + 1;
+    }
+    const std::size_t shift = (bucket - 2) / 2;
+    const std::uint64_t sub = 2 + (bucket - 2) % 2;
+    return (sub + 1) << shift;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    for (const Stripe& s : stripes) {
+        for (std::size_t b = 0; b <= kBuckets; ++b) {
+            result.counts[b] += s.buckets[b].load(std::memory_order_relaxed);
+        }
+        result.sumMicros += s.sumMicros.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+std::string MetricsRegistry::formatLabels(const Labels& labels) {
+    std::string out;
+    for (const auto& [key, value] : labels) {
+        out += out.empty() ? "" : ",";
+        out += key + "=\"";
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+    return out;
+}
+
+void MetricsRegistry::add(const std::string& name, const std::string& help, Kind kind, const Labels& labels,
+                          Series series) {
+    series.labels = formatLabels(labels);
+    std::lock_guard<std::mutex> lock(mtx);
+    for (Family& family : families) {
+        if (family.name == name) {
+            if (family.kind != kind) {
+                throw std::invalid_argument("Metric " + name + " registered with two types");
+            }
+            family.series.push_back(std::move(series));
+            return;
+        }
+    }
+    families.push_back({name, help, kind, {}});
+    families.back().series.push_back(std::move(series));
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const Labels& labels) {
+    auto counter = std::make_unique<Counter>();
+    Counter& result = *counter;
+    add(name, help, Kind::Counter, labels, {std::string(), std::move(counter), nullptr, nullptr});
+    return result;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                             const Labels& labels) {
+    auto histogram = std::make_unique<LatencyHistogram>();
+    LatencyHistogram& result = *histogram;
+    add(name, help, Kind::Histogram, labels, {std::string(), nullptr, std::move(histogram), nullptr});
+    return result;
+}
+
+void MetricsRegistry::counter(const std::string& name, const std::string& help, const Labels& labels,
+                              std::function<double()> read) {
+    add(name, help, Kind::Counter, labels, {std::string(), nullptr, nullptr, std::move(read)});
+}
+
+void MetricsRegistry::gauge(const std::string& name, const std::string& help, const Labels& labels,
+                            std::function<double()> read) {
+    add(name, help, Kind::Gauge, labels, {std::string(), nullptr, nullptr, std::move(read)});
+}
+
+RouteMetrics& MetricsRegistry::route(const std::string& method, const std::string& pattern) {
+    auto metrics = std::make_unique<RouteMetrics>();
+    static const char* const kClasses[] = {"2xx", "3xx", "4xx", "5xx"};
+    for (std::size_t c = 0; c < 4; ++c) {
+        metrics->responses[c] = &counter("vending_http_requests_total",
+                                         "HTTP requests answered, by route and status class.",
+                                         {{"method", method}, {"route", pattern}, {"code", kClasses[c]}});
+    }
+    metrics->latency = &histogram("vending_http_request_duration_seconds", "Time spent in the route handler.",
+                                   {{"method", method}, {"route", pattern}});
+    std::lock_guard<std::mutex> lock(mtx);
+    routes.push_back(std::move(metrics));
+    return *routes.back();
+}
+
+std::string MetricsRegistry::render() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::string out;
+    char number[32];
+    auto withLabels = [](const std::string& labels, const std::string& extra) {
+        if (labels.empty() && extra.empty()) {
+            return std::string();
+        }
+        return "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+    };
+    for (const Family& family : families) {
+        static const char* const kTypes[] = {"counter", "gauge", "histogram"};
+        out += "# HELP " + family.name + " " + family.help + "\n";
+        out += "# TYPE " + family.name + " " + kTypes[static_cast<int>(family.kind)] + "\n";
+        for (const Series& series : family.series) {
+            switch (family.kind) {
+            case Kind::Counter:
+                if (series.counter) {
+                    out += family.name + withLabels(series.labels, "") + " " +
+                           std::to_string(series.counter->value()) + "\n";
+                    break;
+                }
+                [[fallthrough]];
+            case Kind::Gauge:
+                std::snprintf(number, sizeof(number), "%.17g", series.read());
+                out += family.name + withLabels(series.labels, "") + " " + number + "\n";
+                break;
+            case Kind::Histogram: {
+                const auto snapshot = series.histogram->snapshot();
+                std::uint64_t cumulative = 0;
+                for (std::size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+                    cumulative += snapshot.counts[b];
+                    std::snprintf(number, sizeof(number), "%g", LatencyHistogram::bucketLimit(b) / 1e6);
+                    out += family.name + "_bucket" + withLabels(series.labels, std::string("le=\"") + number + "\"") +
+                           " " + std::to_string(cumulative) + "\n";
+                }
+                cumulative += snapshot.counts[LatencyHistogram::kBuckets];
+                out += family.name + "_bucket" + withLabels(series.labels, "le=\"+Inf\"") + " " +
+                       std::to_string(cumulative) + "\n";
+                std::snprintf(number, sizeof(number), "%.6f", snapshot.sumMicros / 1e6);
+                out += family.name + "_sum" + withLabels(series.labels, "") + " " + number + "\n";
+                out += family.name + "_count" + withLabels(series.labels, "") + " " +
+                       std::to_string(cumulative) + "\n";
+                break;
+            }
+            }
+        }
+    }
+    return out;
+}
@@ -1,13 +1,19 @@
 #include "payment.hpp"
+#include <limits>
 #include <stdexcept>
 
 // CashPayment implementation
-CashPayment::CashPayment(double initialBalance) : balance(initialBalance) {}
-
-bool CashPayment::processPayment(double amount) {
-    if (balance >= amount) {
-        balance -= amount;
-        return true;
+CashPayment::CashPayment(Money initialBalance) : balanceCents(initialBalance.toCents()) {}
+
+bool CashPayment::processPayment(Money amount) {
+    const std::int64_t cents = amount.toCents();
+    std::int64_t current = balanceCents.load(std::memory_order_relaxed);
+    while (current >= cents) {
+        if (balanceCents.compare_exchange_weak(current, current - cents,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed)) {
+            return true;
+        }
     }
     return false;
 }
@@ -16,70 +22,31 @@ std::string CashPayment::getPaymentType() const {
     return "Cash";
 }
 
-double CashPayment::getBalance() const {
-    return balance;
+Money CashPayment::getBalance() const {
+    return Money::fromCents(balanceCents.load(std::memory_order_acquire));
 }
 
-void CashPayment::addMoney(double amount) {
-    if (amount < 0) {
+void CashPayment::addMoney(Money amount) {
+    if (amount < Money()) {
         throw std::invalid_argument("Amount cannot be negative");
     }
-    balance += amount;
-}
-
-double CashPayment::returnChange() {
-    double change = balance;
-    balance = 0.0;
-    return change;
-}
-
-// BaseItem implementation
-BaseItem::BaseItem(const std::string& name, double price, int quantity)
-    : name(name), price(price), quantity(quantity) {}
-
-std::string BaseItem::getName() const {
-    return name;
-}
-
-double BaseItem::getPrice() const {
-    return price;
-}
-
-int BaseItem::getQuantity() const {
-    return quantity;
-}
-
-void BaseItem::setQuantity(int quantity) {
-    if (quantity < 0) {
-        throw std::invalid_argument("Quantity cannot be negative");
-    }
-    this->quantity = quantity;
-}
-
-std::string BaseItem::getType() const {
-    return "Base";
+    // A bare fetch_add would wrap to a negative balance, so the add is
+    // refused, leaving the balance untouched, when it cannot fit.
+    const std::int64_t cents = amount.toCents();
+    std::int64_t current = balanceCents.load(std::memory_order_relaxed);
+    do {
+        if (current > std::numeric_limits<std::int64_t>::max() - cents) {
+            throw std::overflow_error("Balance too large");
+        }
+    } while (!balanceCents.compare_exchange_weak(current, current + cents,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed));
 }
 
-// Beverage implementation
-Beverage::Beverage(const std::string& name, double price, int quantity, int volume)
-    : BaseItem(name, price, quantity), volume(volume) {}
-
-std::string Beverage::getType() const {
-    return "Beverage";
+Money CashPayment::returnChange() {
+    return Money::fromCents(balanceCents.exchange(0, std::memory_order_acq_rel));
 }
 
-int Beverage::getVolume() const {
-    return volume;
+void CashPayment::adjustBalance(Money delta) {
+    balanceCents.fetch_add(delta.toCents(), std::memory_order_acq_rel);
 }
-
-// Snack implementation
-Snack::Snack(const std::string& name, double price, int quantity, int weight)
-    : BaseItem(name, price, quantity), weight(weight) {}
-
-std::string Snack::getType() const {
-    return "Snack";
-}
-
-int Snack::getWeight() const {
-    return weight;
-} 
\ No newline at end of file
@@ -1,109 +1,247 @@
-#include "httplib.h"
 #include "vending_machine.h"
 #include "payment.hpp"
 #include "inventory.hpp"
 #include "transaction.hpp"
+#include "fleet.hpp"
+#include "executor.hpp"
+#include "inventory_stream.hpp"
+#include "metrics.hpp"
+#include "vending_api.hpp"
+#include "transport.hpp"
+#include <algorithm>
 #include <memory>
-#include <nlohmann/json.hpp>
-
-using json = nlohmann::json;
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
 
 int main() {
+    const auto startedAt = std::chrono::steady_clock::now();
+
     // Create dependencies with dependency injection
     auto paymentMethod = std::make_unique<CashPayment>();
     auto inventory = std::make_unique<Inventory>();
-    auto transactionLog = std::make_unique<TransactionLog>();
+    // Machines start with VENDING_COIN_FLOAT coins of every denomination
+    // (default 20) to make change from; a negative value stops tracking
+    // coins and change is unlimited.
+    const char* coinFloatEnv = std::getenv("VENDING_COIN_FLOAT");
+    const int coinFloat = coinFloatEnv ? std::atoi(coinFloatEnv) : 20;
+    // VENDING_HISTORY_RETENTION bounds how many transactions are kept in
+    // memory; older ones only count towards totals.
+    TransactionLogOptions logOptions;
+    if (const char* retention = std::getenv("VENDING_HISTORY_RETENTION")) {
+        logOptions.retention = static_cast<std::size_t>(std::atoll(retention));
+    }
+    auto transactionLog = std::make_unique<TransactionLog>(logOptions);
+
+    // Setting VENDING_DATA_DIR turns on persistence: every state change is
+    // journaled before it is acknowledged, snapshots are written every
+    // VENDING_SNAPSHOT_SECS seconds, and a restart recovers from both.
+    // VENDING_JOURNAL_FLUSH_US widens the group commit window.
+    const char* dataDir = std::getenv("VENDING_DATA_DIR");
+    const std::string snapshotPath = dataDir ? std::string(dataDir) + "/vending.snapshot" : std::string();
+    std::unique_ptr<Journal> journal;
+    if (dataDir) {
+        JournalOptions options;
+        options.path = std::string(dataDir) + "/vending.journal";
+        if (const char* flushUs = std::getenv("VENDING_JOURNAL_FLUSH_US")) {
+            options.flushInterval = std::chrono::microseconds(std::atoll(flushUs));
+        }
+        journal = std::make_unique<Journal>(options);
+    }
     
-    // Create vending machine with dependencies
-    VendingMachine vendingMachine(std::move(paymentMethod), 
-                                std::move(inventory), 
-                                std::move(transactionLog));
+    // Every machine in the process lives in the fleet. The default machine
+    // is the persistent one behind the plain /api/... routes; VENDING_FLEET_SIZE
+    // pre-creates machines "1".."N" with the default catalog.
+    // VENDING_MAX_MACHINES caps the fleet, default machine included. It
+    // defaults to the machines created here, so POST /api/machines, which
+    // anyone can call, adds nothing unless it is raised.
+    // VENDING_EXECUTOR=actor runs each machine as an actor on a work-stealing
+    // pool of VENDING_EXECUTOR_THREADS workers (one per core by default)
+    // instead of on the HTTP threads. Those threads still wait for the
+    // journal, so the actor's requests share group commits.
+    std::unique_ptr<Executor> executor;
+    if (const char* mode = std::getenv("VENDING_EXECUTOR"); mode && std::string(mode) == "actor") {
+        ExecutorOptions executorOptions;
+        if (const char* threads = std::getenv("VENDING_EXECUTOR_THREADS")) {
+            executorOptions.threads = static_cast<std::size_t>(std::atoll(threads));
+        }
+        executor = std::make_unique<Executor>(executorOptions);
+    }
+    long fleetSize = 0;
+    if (const char* size = std::getenv("VENDING_FLEET_SIZE")) {
+        fleetSize = std::max(0L, std::atol(size));
+    }
+    FleetOptions fleetOptions;
+    fleetOptions.coinFloat = coinFloat;
+    fleetOptions.maxMachines = static_cast<std::size_t>(fleetSize) + 1;
+    if (const char* maxMachines = std::getenv("VENDING_MAX_MACHINES")) {
+        fleetOptions.maxMachines = std::max(fleetOptions.maxMachines,
+                                            static_cast<std::size_t>(std::max(0LL, std::atoll(maxMachines))));
+    }
+    Fleet fleet(fleetOptions, executor.get());
+    VendingMachine& vendingMachine = fleet.addMachine("default",
+        std::make_unique<VendingMachine>(std::move(paymentMethod),
+                                         std::move(inventory),
+                                         std::move(transactionLog),
+                                         std::move(journal),
+                                         nullptr,
+                                         coinFloat >= 0 ? std::make_unique<CoinInventory>(coinFloat) : nullptr));
 
-    // Add items using the new item types
-    vendingMachine.addItem(std::make_unique<Beverage>("Coke", 1.5, 10, 330));
-    vendingMachine.addItem(std::make_unique<Beverage>("Pepsi", 1.2, 8, 330));
-    vendingMachine.addItem(std::make_unique<Beverage>("Water", 1.0, 15, 500));
-    vendingMachine.addItem(std::make_unique<Snack>("Chips", 1.8, 12, 50));
-    vendingMachine.addItem(std::make_unique<Snack>("Candy", 1.0, 20, 30));
-    vendingMachine.addItem(std::make_unique<Beverage>("Sprite", 1.5, 10, 330));
-    vendingMachine.addItem(std::make_unique<Beverage>("Fanta", 1.5, 10, 330));
-    vendingMachine.addItem(std::make_unique<Beverage>("Mountain Dew", 1.2, 8, 330));
-    vendingMachine.addItem(std::make_unique<Snack>("Doritos", 1.8, 12, 50));
-    vendingMachine.addItem(std::make_unique<Snack>("Snickers", 1.2, 15, 45));
-    vendingMachine.addItem(std::make_unique<Snack>("Twix", 1.2, 15, 45));
-    vendingMachine.addItem(std::make_unique<Snack>("KitKat", 1.2, 15, 45));
+    bool recovered = dataDir && vendingMachine.recover(snapshotPath);
+    if (!recovered) {
+        seedDefaultItems(vendingMachine);
+    }
 
-    httplib::Server svr;
+    for (long m = 1; m <= fleetSize; ++m) {
+        seedDefaultItems(fleet.addMachine(std::to_string(m)));
+    }
 
-    // Enable CORS
-    svr.set_pre_routing_handler([](const httplib::Request &req, httplib::Response &res) {
-        res.set_header("Access-Control-Allow-Origin", "*");
-        res.set_header("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-        res.set_header("Access-Control-Allow-Headers", "Content-Type");
-        if (req.method == "OPTIONS") {
-            res.status = 200;
-            return httplib::Server::HandlerResponse::Handled;
-        }
-        return httplib::Server::HandlerResponse::Unhandled;
-    });
+    std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - startedAt;
+    std::cout << (recovered ? "Recovered state" : "Seeded default items") << " in "
+              << startup.count() << " ms" << std::endl;
 
-    // API endpoints
-    svr.Get("/api/items", [&vendingMachine](const httplib::Request&, httplib::Response &res) {
-        auto items = vendingMachine.getAvailableItems();
-        json response = json::array();
-        for (const auto& item : items) {
-            response.push_back({
-                {"name", item->getName()},
-                {"price", item->getPrice()},
-                {"quantity", item->getQuantity()},
-                {"type", item->getType()}
-            });
-        }
-        res.set_content(response.dump(), "application/json");
-    });
+    // Pushes the default machine's stock changes to /api/items/stream
+    // subscribers; set up before anything else can touch the machine.
+    InventoryStream inventoryStream(vendingMachine);
 
-    svr.Post("/api/insert-money", [&vendingMachine](const httplib::Request &req, httplib::Response &res) {
-        try {
-            auto data = json::parse(req.body);
-            if (!data.contains("amount")) {
-                res.status = 400;
-                res.set_content("Invalid request: missing amount", "text/plain");
-                return;
+    if (dataDir) {
+        const char* intervalEnv = std::getenv("VENDING_SNAPSHOT_SECS");
+        const auto interval = std::chrono::seconds(intervalEnv ? std::atoll(intervalEnv) : 60);
+        std::thread([&vendingMachine, snapshotPath, interval]() {
+            while (true) {
+                std::this_thread::sleep_for(interval);
+                try {
+                    vendingMachine.checkpoint(snapshotPath);
+                } catch (const std::exception& e) {
+                    std::cerr << "Snapshot failed: " << e.what() << std::endl;
+                }
             }
-            vendingMachine.insertMoney(data["amount"].get<double>());
-            res.set_content("Money inserted successfully", "text/plain");
-        } catch (const std::exception& e) {
-            res.status = 400;
-            res.set_content(e.what(), "text/plain");
-        }
-    });
+        }).detach();
+    }
 
-    svr.Post("/api/purchase", [&vendingMachine](const httplib::Request &req, httplib::Response &res) {
-        try {
-            auto data = json::parse(req.body);
-            if (!data.contains("item")) {
-                res.status = 400;
-                res.set_content("Invalid request: missing item", "text/plain");
-                return;
-            }
-            if (vendingMachine.purchaseItem(data["item"].get<std::string>())) {
-                res.set_content("Purchase successful", "text/plain");
-            } else {
-                res.status = 400;
-                res.set_content("Purchase failed", "text/plain");
-            }
-        } catch (const std::exception& e) {
-            res.status = 400;
-            res.set_content(e.what(), "text/plain");
+    // Expired holds are released by the next request to their machine;
+    // this sweep also returns them on machines nobody is using. Machines
+    // without holds cost one atomic load each; the rest are expired through
+    // their actor, if they have one, without waiting for it.
+    std::thread([&fleet]() {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            fleet.forEachHandle([](const std::string&, MachineHandle handle) {
+                if (handle.machine().getHoldCount() > 0) {
+                    handle.send([](VendingMachine& machine) { machine.expireHolds(); });
+                }
+            });
         }
-    });
+    }).detach();
 
-    svr.Post("/api/return-change", [&vendingMachine](const httplib::Request&, httplib::Response &res) {
-        double change = vendingMachine.returnChange();
-        res.set_content(std::to_string(change), "text/plain");
+    // Runtime metrics, scraped from /metrics. Request paths update striped
+    // counters; queue depths and lock waits are read only when scraped.
+    MetricsRegistry metrics;
+    metrics.gauge("vending_transaction_log_pending", "Transactions logged but not yet moved into the history.",
+                  {{"machine", "default"}},
+                  [&vendingMachine] { return static_cast<double>(vendingMachine.getPendingTransactionCount()); });
+    metrics.counter("vending_inventory_lock_waits_total", "Inventory shard lock acquisitions that had to wait.",
+                    {{"machine", "default"}},
+                    [&vendingMachine] { return static_cast<double>(vendingMachine.getInventoryLockWaits().count); });
+    metrics.counter("vending_inventory_lock_wait_seconds_total", "Time spent waiting for inventory shard locks.",
+                    {{"machine", "default"}},
+                    [&vendingMachine] { return vendingMachine.getInventoryLockWaits().nanos / 1e9; });
+    metrics.gauge("vending_fleet_machines", "Machines hosted by this process.", {},
+                  [&fleet] { return static_cast<double>(fleet.size()); });
+    metrics.gauge("vending_holds", "Stock reservations outstanding across the fleet.", {}, [&fleet] {
+        std::size_t total = 0;
+        fleet.forEach([&total](const std::string&, const VendingMachine& machine) { total += machine.getHoldCount(); });
+        return static_cast<double>(total);
     });
+    if (executor) {
+        metrics.gauge("vending_executor_queued_tasks", "Machine actors scheduled but not yet running.", {},
+                      [&executor] { return static_cast<double>(executor->queuedTasks()); });
+    }
+    // Admission control: once requests have queued for longer than
+    // VENDING_SHED_TARGET_MS (default 5, 0 turns it off) throughout a
+    // VENDING_SHED_INTERVAL_MS window (default 100), reads are refused with
+    // 503 until the queue drains. VENDING_MAX_IN_FLIGHT caps requests in
+    // handlers, keeping a quarter of them for money in, purchases and change.
+    AdmissionOptions admissionOptions;
+    if (const char* target = std::getenv("VENDING_SHED_TARGET_MS")) {
+        admissionOptions.target = std::chrono::milliseconds(std::atoll(target));
+    }
+    if (const char* interval = std::getenv("VENDING_SHED_INTERVAL_MS")) {
+        admissionOptions.interval = std::chrono::milliseconds(std::max(1LL, std::atoll(interval)));
+    }
+    if (const char* inFlight = std::getenv("VENDING_MAX_IN_FLIGHT")) {
+        admissionOptions.maxInFlight = static_cast<std::size_t>(std::atoll(inFlight));
+    }
+    // Responses to requests sent with an Idempotency-Key are kept within
+    // VENDING_IDEMPOTENCY_BYTES of memory (default 16 MiB).
+    IdempotencyCacheOptions idempotencyOptions;
+    if (const char* bytes = std::getenv("VENDING_IDEMPOTENCY_BYTES")) {
+        idempotencyOptions.capacityBytes = static_cast<std::size_t>(std::atoll(bytes));
+    }
+    VendingApi api(fleet, metrics, admissionOptions, idempotencyOptions);
+
+    // Runtime settings for the HTTP front end; unset ones keep its defaults.
+    // VENDING_HTTP_THREADS sizes the worker pool (event loops for epoll),
+    // VENDING_HTTP_PINNING=none|compact|spread pins those threads by NUMA
+    // node, VENDING_HTTP_QUEUE bounds connections waiting for a worker,
+    // VENDING_HTTP_BACKLOG sets the listen backlog, and
+    // VENDING_KEEPALIVE_REQUESTS and VENDING_KEEPALIVE_SECS cap requests
+    // per connection and idle seconds. VENDING_STREAM_SUBSCRIBERS caps
+    // /api/items/stream subscribers, each of which gets a thread of its own.
+    TransportOptions transportOptions;
+    if (const char* threads = std::getenv("VENDING_HTTP_THREADS")) {
+        transportOptions.threads = static_cast<std::size_t>(std::atoll(threads));
+    }
+    if (const char* queue = std::getenv("VENDING_HTTP_QUEUE")) {
+        transportOptions.queueLimit = static_cast<std::size_t>(std::atoll(queue));
+    }
+    if (const char* backlog = std::getenv("VENDING_HTTP_BACKLOG")) {
+        transportOptions.backlog = std::atoi(backlog);
+    }
+    if (const char* requests = std::getenv("VENDING_KEEPALIVE_REQUESTS")) {
+        transportOptions.keepAliveRequests = static_cast<std::size_t>(std::atoll(requests));
+    }
+    if (const char* seconds = std::getenv("VENDING_KEEPALIVE_SECS")) {
+        transportOptions.keepAliveSeconds = std::atoi(seconds);
+    }
+    if (const char* subscribers = std::getenv("VENDING_STREAM_SUBSCRIBERS")) {
+        transportOptions.streamSubscribers = static_cast<std::size_t>(std::atoll(subscribers));
+    }
 
-    std::cout << "Server started at http://localhost:8080" << std::endl;
-    svr.listen("localhost", 8080);
+    try {
+        if (const char* pinning = std::getenv("VENDING_HTTP_PINNING")) {
+            transportOptions.pinning = parsePinning(pinning);
+        }
+        // VENDING_TRANSPORT picks the HTTP front end: httplib (default), crow
+        // when built with Boost, or epoll on Linux. All serve the same VendingApi.
+        const char* transportEnv = std::getenv("VENDING_TRANSPORT");
+        const std::string transport = transportEnv ? transportEnv : "httplib";
+        if (transport == "httplib") {
+            serveHttplib(api, inventoryStream, transportOptions);
+        } else if (transport == "crow") {
+#ifdef VENDING_WITH_CROW
+            serveCrow(api, transportOptions);
+#else
+            std::cerr << "This build has no Crow front end (Boost was not found)" << std::endl;
+            return 1;
+#endif
+        } else if (transport == "epoll") {
+#ifdef VENDING_WITH_EPOLL
+            serveEpoll(api, transportOptions);
+#else
+            std::cerr << "The epoll front end is only built on Linux" << std::endl;
+            return 1;
+#endif
+        } else {
+            std::cerr << "Unknown VENDING_TRANSPORT " << transport << " (expected httplib, crow or epoll)"
+                      << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Server failed: " << e.what() << std::endl;
+        return 1;
+    }
     return 0;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,68 @@
+#include "session_store.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+
+SessionStore::SessionStore(std::size_t shardCount)
+    : shardCount(shardCount), shards(new Shard[shardCount ? shardCount : 1]) {
+    if (shardCount == 0) {
+        throw std::invalid_argument("SessionStore needs at least one shard");
+    }
+}
+
+SessionStore::Shard& SessionStore::shardFor(const std::string& sessionId) const {
+    return shards[std::hash<std::string>{}(sessionId) % shardCount];
+}
+
+std::shared_ptr<CashPayment> SessionStore::account(const std::string& sessionId) {
+    if (auto existing = find(sessionId)) {
+        return existing;
+    }
+    Shard& shard = shardFor(sessionId);
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    auto& slot = shard.accounts[sessionId];
+    if (!slot) {
+        slot = std::make_shared<CashPayment>();
+    }
+    return slot;
+}
+
+std::shared_ptr<CashPayment> SessionStore::find(const std::string& sessionId) const {
+    Shard& shard = shardFor(sessionId);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.accounts.find(sessionId);
+    return it != shard.accounts.end() ? it->second : nullptr;
+}
+
+void SessionStore::release(const std::string& sessionId) {
+    Shard& shard = shardFor(sessionId);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.accounts.find(sessionId);
+        if (it == shard.accounts.end() || it->second->getBalance() != Money()) {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.accounts.find(sessionId);
+    // Pointers are only handed out under the shard lock, so with it held
+    // exclusively a use count of one cannot grow. The fence pairs with the
+    // last holder dropping its pointer, making its balance change visible.
+    if (it == shard.accounts.end() || it->second.use_count() != 1) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (it->second->getBalance() == Money()) {
+        shard.accounts.erase(it);
+    }
+}
+
+std::size_t SessionStore::size() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mtx);
+        total += shards[i].accounts.size();
+    }
+    return total;
+}
@@ -0,0 +1,118 @@
+#include "sku_table.hpp"
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t kInitialBuckets = 64;
+
+}  // namespace
+
+SkuTable& SkuTable::global() {
+    static SkuTable table;
+    return table;
+}
+
+SkuTable::Index::Index(std::size_t buckets)
+    : entries(new std::atomic<std::uint64_t>[buckets]()), mask(buckets - 1), shift(64) {
+    for (std::size_t b = buckets; b > 1; b >>= 1) {
+        --shift;
+    }
+}
+
+SkuTable::SkuTable() : pages(new std::atomic<const std::string_view*>[kMaxPages]()) {
+    indexes.push_back(std::make_unique<Index>(kInitialBuckets));
+    current.store(indexes.back().get(), std::memory_order_release);
+}
+
+std::size_t SkuTable::hashName(std::string_view name) {
+    return std::hash<std::string_view>{}(name);
+}
+
+std::uint32_t SkuTable::findIn(const Index& index, std::string_view itemName, std::size_t hash) const {
+    const auto tag = static_cast<std::uint32_t>(static_cast<std::uint64_t>(hash) >> 32);
+    // Fibonacci hashing, as the inventory's shard index does.
+    std::size_t b = static_cast<std::size_t>((static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >>
+                                             index.shift);
+    for (;; b = (b + 1) & index.mask) {
+        const std::uint64_t entry = index.entries[b].load(std::memory_order_acquire);
+        if (entry == 0) {
+            return kNone;
+        }
+        const auto sku = static_cast<std::uint32_t>(entry) - 1;
+        if ((entry >> 32) == tag && name(sku) == itemName) {
+            return sku;
+        }
+    }
+}
+
+void SkuTable::insertInto(Index& index, std::size_t hash, std::uint32_t sku) {
+    std::size_t b = static_cast<std::size_t>((static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >>
+                                             index.shift);
+    while (index.entries[b].load(std::memory_order_relaxed) != 0) {
+        b = (b + 1) & index.mask;
+    }
+    // Release: a reader that finds the entry also sees the name behind it.
+    index.entries[b].store(((static_cast<std::uint64_t>(hash) >> 32) << 32) | (std::uint64_t(sku) + 1),
+                           std::memory_order_release);
+}
+
+std::uint32_t SkuTable::find(std::string_view itemName) const {
+    return findIn(*current.load(std::memory_order_acquire), itemName, hashName(itemName));
+}
+
+void SkuTable::rebuild(std::size_t buckets) {
+    indexes.push_back(std::make_unique<Index>(buckets));
+    Index& index = *indexes.back();
+    for (std::size_t sku = 0; sku < hashes.size(); ++sku) {
+        insertInto(index, hashes[sku], static_cast<std::uint32_t>(sku));
+    }
+    current.store(&index, std::memory_order_release);
+}
+
+void SkuTable::reserve(std::size_t total) {
+    std::lock_guard<std::mutex> lock(writeMtx);
+    std::size_t buckets = indexes.back()->mask + 1;
+    while (total * 2 > buckets) {
+        buckets *= 2;
+    }
+    if (buckets > indexes.back()->mask + 1) {
+        rebuild(buckets);
+    }
+}
+
+std::uint32_t SkuTable::intern(std::string_view itemName) {
+    const std::size_t hash = hashName(itemName);
+    const std::uint32_t known = findIn(*current.load(std::memory_order_acquire), itemName, hash);
+    if (known != kNone) {
+        return known;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMtx);
+    Index* index = indexes.back().get();
+    // Another thread may have added it since.
+    const std::uint32_t raced = findIn(*index, itemName, hash);
+    if (raced != kNone) {
+        return raced;
+    }
+    const std::size_t sku = count.load(std::memory_order_relaxed);
+    if (sku >= kMaxSkus) {
+        throw std::length_error("Too many distinct item names");
+    }
+    names.emplace_back(itemName);
+    const std::size_t page = sku >> kPageBits;
+    if (page == ownedPages.size()) {
+        ownedPages.push_back(std::make_unique<std::string_view[]>(kPageSize));
+        pages[page].store(ownedPages.back().get(), std::memory_order_release);
+    }
+    ownedPages[page][sku & (kPageSize - 1)] = names.back();
+
+    if ((sku + 1) * 2 > index->mask + 1) {
+        rebuild((index->mask + 1) * 2);
+        index = indexes.back().get();
+    }
+    insertInto(*index, hash, static_cast<std::uint32_t>(sku));
+    hashes.push_back(hash);
+    count.store(sku + 1, std::memory_order_release);
+    return static_cast<std::uint32_t>(sku);
+}
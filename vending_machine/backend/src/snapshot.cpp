@@ -0,0 +1,307 @@
+#include "snapshot.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char kMagic[8] = {'V', 'M', 'S', 'N', 'A', 'P', '0', '3'};
+constexpr char kCoinlessMagic[8] = {'V', 'M', 'S', 'N', 'A', 'P', '0', '2'};
+constexpr char kUntypedMagic[8] = {'V', 'M', 'S', 'N', 'A', 'P', '0', '1'};
+// More denominations than any machine has; bounds the coin section.
+constexpr std::uint64_t kMaxCoinDenominations = 64;
+}
+
+struct Snapshot::Header {
+    char magic[8];
+    std::uint64_t lsn;
+    std::uint64_t itemCount;
+    std::uint64_t sessionCount;
+    std::uint64_t transactionCount;
+    std::int64_t revenueCents;
+    std::uint64_t blobSize;
+};
+
+struct Snapshot::ItemRecord {
+    std::uint64_t nameOffset;
+    std::uint32_t nameLength;
+    std::int32_t quantity;
+    std::int64_t priceCents;
+};
+
+struct Snapshot::ItemTypeRecord {
+    std::int32_t attribute;
+    std::uint8_t type;
+    std::uint8_t reserved[3];
+};
+
+struct Snapshot::SessionRecord {
+    std::uint64_t idOffset;
+    std::uint64_t idLength;
+    std::int64_t balanceCents;
+};
+
+void Snapshot::write(const std::string& path, const SnapshotState& state) {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.lsn = state.lsn;
+    header.itemCount = state.items.size();
+    header.sessionCount = state.sessions.size();
+    header.transactionCount = state.transactionCount;
+    header.revenueCents = state.revenue.toCents();
+
+    std::vector<ItemRecord> items;
+    std::vector<ItemTypeRecord> itemTypes;
+    std::vector<SessionRecord> sessions;
+    std::string blob;
+    items.reserve(state.items.size());
+    itemTypes.reserve(state.items.size());
+    sessions.reserve(state.sessions.size());
+    for (const auto& item : state.items) {
+        items.push_back({blob.size(), static_cast<std::uint32_t>(item.name.size()),
+                         item.quantity, item.price.toCents()});
+        itemTypes.push_back({item.attribute, static_cast<std::uint8_t>(item.type), {}});
+        blob += item.name;
+    }
+    for (const auto& session : state.sessions) {
+        sessions.push_back({blob.size(), session.id.size(), session.balance.toCents()});
+        blob += session.id;
+    }
+    header.blobSize = blob.size();
+
+    const std::uint64_t denominations = state.coinStock.size();
+    std::vector<std::int32_t> coins(state.coinStock.begin(), state.coinStock.end());
+    for (const auto& session : state.sessions) {
+        for (std::size_t i = 0; i < denominations; ++i) {
+            coins.push_back(i < session.setAside.size() ? session.setAside[i] : 0);
+        }
+    }
+
+    const std::string tmpPath = path + ".tmp";
+    std::FILE* out = std::fopen(tmpPath.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("Cannot write snapshot " + tmpPath + ": " + std::strerror(errno));
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+              std::fwrite(items.data(), sizeof(ItemRecord), items.size(), out) == items.size() &&
+              std::fwrite(itemTypes.data(), sizeof(ItemTypeRecord), itemTypes.size(), out) == itemTypes.size() &&
+              std::fwrite(sessions.data(), sizeof(SessionRecord), sessions.size(), out) == sessions.size() &&
+              std::fwrite(&denominations, sizeof(denominations), 1, out) == 1 &&
+              std::fwrite(coins.data(), sizeof(std::int32_t), coins.size(), out) == coins.size() &&
+              std::fwrite(blob.data(), 1, blob.size(), out) == blob.size() &&
+              std::fflush(out) == 0;
+#ifndef _WIN32
+    ok = ok && ::fsync(::fileno(out)) == 0;
+#endif
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("Cannot write snapshot " + path);
+    }
+}
+
+Snapshot::Snapshot(const std::string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw std::runtime_error("Cannot open snapshot " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapped = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const char*>(mapped);
+            size = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    if (!data && st.st_size > 0) {
+        throw std::runtime_error("Cannot map snapshot " + path);
+    }
+#else
+    std::ifstream in(path, std::ios::binary);
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data = fallback.data();
+    size = fallback.size();
+#endif
+    if (size == 0) {
+        return;
+    }
+    if (!valid()) {
+        unmap();
+        throw std::runtime_error("Corrupt snapshot " + path);
+    }
+}
+
+bool Snapshot::valid() {
+    if (size < sizeof(Header)) {
+        return false;
+    }
+    const Header* h = header();
+    hasCoins = std::memcmp(h->magic, kMagic, sizeof(kMagic)) == 0;
+    typed = hasCoins || std::memcmp(h->magic, kCoinlessMagic, sizeof(kCoinlessMagic)) == 0;
+    if (!typed && std::memcmp(h->magic, kUntypedMagic, sizeof(kUntypedMagic)) != 0) {
+        return false;
+    }
+    // Sections are sized one at a time against what is left, so no product
+    // or sum can overflow.
+    std::size_t left = size - sizeof(Header);
+    const std::size_t itemBytes = sizeof(ItemRecord) + (typed ? sizeof(ItemTypeRecord) : 0);
+    if (h->itemCount > left / itemBytes) {
+        return false;
+    }
+    left -= h->itemCount * itemBytes;
+    if (h->sessionCount > left / sizeof(SessionRecord)) {
+        return false;
+    }
+    left -= h->sessionCount * sizeof(SessionRecord);
+    if (hasCoins) {
+        std::uint64_t denominations = 0;
+        if (left < sizeof(denominations)) {
+            return false;
+        }
+        std::memcpy(&denominations, sessions() + h->sessionCount * sizeof(SessionRecord), sizeof(denominations));
+        left -= sizeof(denominations);
+        const std::uint64_t perRow = denominations * sizeof(std::int32_t);
+        if (denominations > kMaxCoinDenominations ||
+            (perRow > 0 && h->sessionCount + 1 > left / perRow)) {
+            return false;
+        }
+        left -= (h->sessionCount + 1) * perRow;
+    }
+    if (h->blobSize != left) {
+        return false;
+    }
+    // Every string is checked here, once, so item() and session() cannot
+    // fail later, on the threads that load a large snapshot in parallel.
+    const auto inBlob = [h](std::uint64_t offset, std::uint64_t length) {
+        return offset <= h->blobSize && length <= h->blobSize - offset;
+    };
+    const auto* items = reinterpret_cast<const ItemRecord*>(data + sizeof(Header));
+    for (std::uint64_t i = 0; i < h->itemCount; ++i) {
+        if (!inBlob(items[i].nameOffset, items[i].nameLength)) {
+            return false;
+        }
+    }
+    const auto* records = reinterpret_cast<const SessionRecord*>(sessions());
+    for (std::uint64_t i = 0; i < h->sessionCount; ++i) {
+        if (!inBlob(records[i].idOffset, records[i].idLength)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Snapshot::~Snapshot() {
+    unmap();
+}
+
+void Snapshot::unmap() {
+#ifndef _WIN32
+    if (data && size > 0) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+std::size_t Snapshot::itemTypeRecordsSize() const {
+    return typed ? header()->itemCount * sizeof(ItemTypeRecord) : 0;
+}
+
+const char* Snapshot::sessions() const {
+    return data + sizeof(Header) + header()->itemCount * sizeof(ItemRecord) + itemTypeRecordsSize();
+}
+
+const char* Snapshot::coins() const {
+    return sessions() + header()->sessionCount * sizeof(SessionRecord);
+}
+
+std::size_t Snapshot::coinSectionSize() const {
+    return hasCoins ? sizeof(std::uint64_t) + (header()->sessionCount + 1) * coinDenominations() * sizeof(std::int32_t)
+                    : 0;
+}
+
+const char* Snapshot::blob() const {
+    return coins() + coinSectionSize();
+}
+
+std::size_t Snapshot::coinDenominations() const {
+    if (!hasCoins) {
+        return 0;
+    }
+    std::uint64_t denominations = 0;
+    std::memcpy(&denominations, coins(), sizeof(denominations));
+    return static_cast<std::size_t>(denominations);
+}
+
+const std::int32_t* Snapshot::coinStock() const {
+    return reinterpret_cast<const std::int32_t*>(coins() + sizeof(std::uint64_t));
+}
+
+// Ranges were checked by valid().
+std::string_view Snapshot::text(std::uint64_t offset, std::uint64_t length) const {
+    return std::string_view(blob() + offset, length);
+}
+
+const Snapshot::Header* Snapshot::header() const {
+    return reinterpret_cast<const Header*>(data);
+}
+
+bool Snapshot::empty() const {
+    return size == 0;
+}
+
+std::uint64_t Snapshot::lsn() const {
+    return empty() ? 0 : header()->lsn;
+}
+
+std::uint64_t Snapshot::transactionCount() const {
+    return empty() ? 0 : header()->transactionCount;
+}
+
+Money Snapshot::revenue() const {
+    return empty() ? Money() : Money::fromCents(header()->revenueCents);
+}
+
+std::size_t Snapshot::itemCount() const {
+    return empty() ? 0 : header()->itemCount;
+}
+
+ItemView Snapshot::item(std::size_t index) const {
+    const auto* records = reinterpret_cast<const ItemRecord*>(data + sizeof(Header));
+    const ItemRecord& r = records[index];
+    ItemView view{text(r.nameOffset, r.nameLength), Money::fromCents(r.priceCents), r.quantity,
+                  ItemType::Item, 0};
+    if (typed) {
+        const auto* types = reinterpret_cast<const ItemTypeRecord*>(records + header()->itemCount);
+        view.type = static_cast<ItemType>(types[index].type);
+        view.attribute = types[index].attribute;
+    }
+    return view;
+}
+
+std::size_t Snapshot::sessionCount() const {
+    return empty() ? 0 : header()->sessionCount;
+}
+
+Snapshot::SessionView Snapshot::session(std::size_t index) const {
+    const auto* records = reinterpret_cast<const SessionRecord*>(sessions());
+    const SessionRecord& r = records[index];
+    const std::size_t denominations = coinDenominations();
+    const std::int32_t* setAside = denominations ? coinStock() + (index + 1) * denominations : nullptr;
+    return {text(r.idOffset, r.idLength), Money::fromCents(r.balanceCents), setAside};
+}
@@ -0,0 +1,110 @@
+#include "timer_wheel.hpp"
+#include <algorithm>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Index of the lowest set bit; `value` must not be zero.
+unsigned lowestBit(std::uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+}  // namespace
+
+TimerWheel::TimerWheel(std::uint64_t now) : current(now) {}
+
+void TimerWheel::schedule(Timer& timer, std::uint64_t expiry) {
+    cancel(timer);
+    timer.expiry = expiry;
+    insert(timer);
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (timer.scheduled()) {
+        unlink(timer);
+        --count;
+    }
+}
+
+void TimerWheel::insert(Timer& timer) {
+    // Past expiries fire on the next tick processed; those beyond the span
+    // wait where the span ends and are placed again from there.
+    std::uint64_t at = std::max(timer.expiry, current);
+    at = std::min(at, current + kSpan - 1);
+    const std::uint64_t delta = at - current;
+    unsigned level = 0;
+    while (level + 1 < kLevels && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    const std::size_t slot = (at >> (kSlotBits * level)) & kMask;
+    Timer*& head = slots[level][slot];
+    timer.next = head;
+    if (head) {
+        head->prev = &timer.next;
+    }
+    head = &timer;
+    timer.prev = &head;
+    if (level == 0) {
+        occupied |= std::uint64_t(1) << slot;
+    }
+    ++count;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    *timer.prev = timer.next;
+    if (timer.next) {
+        timer.next->prev = timer.prev;
+    }
+    timer.next = nullptr;
+    timer.prev = nullptr;
+}
+
+void TimerWheel::cascade() {
+    for (unsigned level = 1; level < kLevels; ++level) {
+        const std::size_t slot = (current >> (kSlotBits * level)) & kMask;
+        Timer* timer = slots[level][slot];
+        slots[level][slot] = nullptr;
+        while (timer) {
+            Timer* next = timer->next;
+            timer->next = nullptr;
+            timer->prev = nullptr;
+            --count;
+            insert(*timer);
+            timer = next;
+        }
+        // The level above only moves when this one wraps.
+        if (slot != 0) {
+            break;
+        }
+    }
+}
+
+std::uint64_t TimerWheel::nextTick(std::uint64_t limit) const {
+    std::uint64_t next = current + 1;
+    const std::size_t slot = next & kMask;
+    if (slot != 0) {
+        const std::uint64_t ahead = occupied >> slot;
+        // Nothing left on level 0 this lap: skip to where the next level
+        // moves down.
+        next = ahead ? next + lowestBit(ahead) : (next | kMask) + 1;
+    }
+    return std::min(next, limit);
+}
+
+std::uint64_t TimerWheel::nextCheck() const {
+    if (count == 0) {
+        return std::numeric_limits<std::uint64_t>::max();
+    }
+    const std::uint64_t ahead = occupied >> (current & kMask);
+    return ahead ? current + lowestBit(ahead) : (current | kMask) + 1;
+}
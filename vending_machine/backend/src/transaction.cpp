@@ -1,14 +1,249 @@
 #include "transaction.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <ctime>
+#include <thread>
+#include <unordered_set>
 
-void TransactionLog::logTransaction(const std::string& itemName, double price) {
-    Transaction t;
-    t.itemName = itemName;
-    t.price = price;
-    t.timestamp = std::time(nullptr);
-    history.push_back(t);
+namespace {
+
+// Process-wide thread that moves queued records into every live log's
+// history, so the cost of building Transaction objects stays off the
+// purchase path.
+class LogDrainer {
+public:
+    static LogDrainer& instance() {
+        static LogDrainer drainer;
+        return drainer;
+    }
+
+    void add(TransactionLog* log) {
+        std::lock_guard<std::mutex> lock(mtx);
+        logs.insert(log);
+    }
+
+    // Once this returns the drainer no longer touches `log`.
+    void remove(TransactionLog* log) {
+        std::lock_guard<std::mutex> lock(mtx);
+        logs.erase(log);
+    }
+
+    void wake() {
+        cv.notify_one();
+    }
+
+private:
+    LogDrainer() : worker(&LogDrainer::run, this) {}
+
+    ~LogDrainer() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopping) {
+            for (TransactionLog* log : logs) {
+                log->drainPending();
+            }
+            cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::unordered_set<TransactionLog*> logs;
+    bool stopping = false;
+    std::thread worker;
+};
+
+}  // namespace
+
+TransactionLog::TransactionLog(TransactionLogOptions options) : options(options) {
+    if (options.queueCapacity > 0) {
+        queue = std::make_unique<MpscQueue<PendingTransaction>>(options.queueCapacity);
+        LogDrainer::instance().add(this);
+    }
+}
+
+TransactionLog::~TransactionLog() {
+    if (queue) {
+        LogDrainer::instance().remove(this);
+    }
+}
+
+void TransactionLog::logTransaction(const std::string& itemName, Money price) {
+    logTransaction(SkuTable::global().intern(itemName), price, std::time(nullptr));
+}
+
+void TransactionLog::logTransaction(const std::string& itemName, Money price, std::time_t timestamp) {
+    logTransaction(SkuTable::global().intern(itemName), price, timestamp);
+}
+
+void TransactionLog::logTransaction(std::uint32_t sku, Money price) {
+    logTransaction(sku, price, std::time(nullptr));
+}
+
+void TransactionLog::logTransaction(std::uint32_t sku, Money price, std::time_t timestamp) {
+    if (queue) {
+        PendingTransaction record;
+        record.cents = price.toCents();
+        record.timestamp = static_cast<std::int64_t>(timestamp);
+        record.sku = sku;
+        if (queue->tryPush(record)) {
+            if (queue->size() > queue->capacity() / 2) {
+                LogDrainer::instance().wake();
+            }
+            return;
+        }
+    }
+    // There is no queue or it is full: drain here, including records still
+    // being written, so every call that returned before this one stays
+    // ahead of it, then append directly.
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    append(sku, price.toCents(), static_cast<std::int64_t>(timestamp));
+}
+
+void TransactionLog::logTransactions(const std::vector<Transaction>& group) {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    for (const auto& transaction : group) {
+        append(transaction.sku, transaction.price.toCents(), static_cast<std::int64_t>(transaction.timestamp));
+    }
+}
+
+void TransactionLog::drainPending() {
+    if (!queue || queue->size() == 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    if (lock.owns_lock()) {
+        drainLocked(false);
+    }
+}
+
+void TransactionLog::drainLocked(bool complete) {
+    if (!queue) {
+        return;
+    }
+    // A producer fills its cell a few instructions after claiming it, so
+    // the wait is short unless that thread is descheduled in between.
+    const std::size_t end = complete ? queue->claimed() : 0;
+    PendingTransaction record;
+    while (true) {
+        while (queue->tryPop(record)) {
+            append(record.sku, record.cents, record.timestamp);
+        }
+        if (queue->popped() >= end) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    queue->publishConsumed();
+}
+
+void TransactionLog::append(std::uint32_t sku, std::int64_t cents, std::int64_t timestamp) {
+    if (chunks.empty() || chunks.back()->size() == Chunk::kCapacity) {
+        chunks.push_back(std::make_unique<Chunk>());
+    }
+    Chunk& chunk = *chunks.back();
+    chunk.itemIds.push_back(sku);
+    chunk.cents.push_back(cents);
+
+    // Zigzag so a clock stepping backwards still encodes small.
+    const std::int64_t delta = timestamp - chunk.lastTimestamp;
+    std::uint64_t zigzag = (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63);
+    while (zigzag >= 0x80) {
+        chunk.timestampDeltas.push_back(static_cast<std::uint8_t>(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    chunk.timestampDeltas.push_back(static_cast<std::uint8_t>(zigzag));
+    chunk.lastTimestamp = timestamp;
+    ++retained;
+
+    // Retire whole chunks once the oldest one is entirely past retention.
+    while (options.retention > 0 && chunks.size() > 1 &&
+           retained - chunks.front()->size() >= options.retention) {
+        const Chunk& oldest = *chunks.front();
+        std::int64_t retiredCents = 0;
+        for (std::int64_t c : oldest.cents) {
+            retiredCents += c;
+        }
+        baselineCount += oldest.size();
+        baselineRevenue += Money::fromCents(retiredCents);
+        retained -= oldest.size();
+        chunks.pop_front();
+    }
+}
+
+std::int64_t TransactionLog::readDelta(const std::uint8_t*& cursor) {
+    std::uint64_t zigzag = 0;
+    int shift = 0;
+    while (*cursor & 0x80) {
+        zigzag |= static_cast<std::uint64_t>(*cursor++ & 0x7F) << shift;
+        shift += 7;
+    }
+    zigzag |= static_cast<std::uint64_t>(*cursor++) << shift;
+    return static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+}
+
+std::size_t TransactionLog::pendingCount() const {
+    return queue ? queue->size() : 0;
 }
 
 std::vector<Transaction> TransactionLog::getHistory() {
+    std::vector<Transaction> history;
+    history.reserve(retainedCount());
+    visit(0, SIZE_MAX, [&history](const TransactionView& t) {
+        history.push_back({t.itemId, t.price, t.timestamp});
+    });
     return history;
-}
\ No newline at end of file
+}
+
+std::size_t TransactionLog::retainedCount() {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    return retained;
+}
+
+std::size_t TransactionLog::memoryUsage() {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    std::size_t bytes = 0;
+    for (const auto& chunk : chunks) {
+        bytes += sizeof(Chunk) + chunk->itemIds.capacity() * sizeof(std::uint32_t) +
+                 chunk->cents.capacity() * sizeof(std::int64_t) + chunk->timestampDeltas.capacity();
+    }
+    return bytes;
+}
+
+Money TransactionLog::totalRevenue() {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    // Contiguous int64 columns: this loop vectorizes.
+    std::int64_t cents = baselineRevenue.toCents();
+    for (const auto& chunk : chunks) {
+        for (std::int64_t c : chunk->cents) {
+            cents += c;
+        }
+    }
+    return Money::fromCents(cents);
+}
+
+std::uint64_t TransactionLog::transactionCount() {
+    std::lock_guard<std::mutex> lock(mtx);
+    drainLocked();
+    return baselineCount + retained;
+}
+
+void TransactionLog::setBaseline(std::uint64_t count, Money revenue) {
+    std::lock_guard<std::mutex> lock(mtx);
+    baselineCount = count;
+    baselineRevenue = revenue;
+}
@@ -0,0 +1,580 @@
+#include "vending_api.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+json coinsToJson(const ChangeBreakdown& coins) {
+    json result = json::array();
+    for (const auto& coin : coins) {
+        result.push_back({{"denomination", coin.denomination}, {"count", coin.count}});
+    }
+    return result;
+}
+
+// Largest quantity one cart line or hold may ask for; far above any slot's
+// capacity, and small enough that price * quantity cannot overflow.
+constexpr int kMaxQuantity = 1000;
+
+// Reads an optional count field into out, or fallback when it is absent.
+// Only a JSON integer between 1 and max is accepted: a float such as 2.7
+// would otherwise be truncated and 1e20 would not fit in an int at all.
+bool readCount(const json& object, const char* key, int fallback, int max, int& out) {
+    const auto field = object.find(key);
+    if (field == object.end()) {
+        out = fallback;
+        return true;
+    }
+    if (!field->is_number_integer()) {
+        return false;
+    }
+    if (field->is_number_unsigned() ? field->get<std::uint64_t>() > static_cast<std::uint64_t>(max)
+                                    : field->get<std::int64_t>() < 1 || field->get<std::int64_t>() > max) {
+        return false;
+    }
+    out = field->get<int>();
+    return true;
+}
+
+std::string countError(const char* key, int max) {
+    return std::string("Invalid request: ") + key + " must be an integer between 1 and " + std::to_string(max);
+}
+
+MachineHandle defaultHandle(const Fleet& fleet) {
+    auto handle = fleet.handle("default");
+    if (!handle) {
+        throw std::invalid_argument("The fleet has no default machine");
+    }
+    return *handle;
+}
+
+}  // namespace
+
+void seedDefaultItems(VendingMachine& machine) {
+    machine.addItem(Item::beverage("Coke", Money::fromCents(150), 10, 330));
+    machine.addItem(Item::beverage("Pepsi", Money::fromCents(120), 8, 330));
+    machine.addItem(Item::beverage("Water", Money::fromCents(100), 15, 500));
+    machine.addItem(Item::snack("Chips", Money::fromCents(180), 12, 50));
+    machine.addItem(Item::snack("Candy", Money::fromCents(100), 20, 30));
+    machine.addItem(Item::beverage("Sprite", Money::fromCents(150), 10, 330));
+    machine.addItem(Item::beverage("Fanta", Money::fromCents(150), 10, 330));
+    machine.addItem(Item::beverage("Mountain Dew", Money::fromCents(120), 8, 330));
+    machine.addItem(Item::snack("Doritos", Money::fromCents(180), 12, 50));
+    machine.addItem(Item::snack("Snickers", Money::fromCents(120), 15, 45));
+    machine.addItem(Item::snack("Twix", Money::fromCents(120), 15, 45));
+    machine.addItem(Item::snack("KitKat", Money::fromCents(120), 15, 45));
+}
+
+VendingApi::VendingApi(Fleet& fleet, MetricsRegistry& metrics, AdmissionOptions admissionOptions,
+                       IdempotencyCacheOptions idempotencyOptions)
+    : fleet(fleet), registry(metrics), defaultMachine(defaultHandle(fleet)),
+      catalogCache(defaultMachine.machine()), admission(admissionOptions), idempotency(idempotencyOptions) {
+    // Paying in, completing a sale and handing back change are what a
+    // customer at the machine is waiting on; they are shed last. Shedding an
+    // insert would leave the customer's money in limbo.
+    constexpr auto low = AdmissionController::Priority::Low;
+    constexpr auto high = AdmissionController::Priority::High;
+    routes = {
+        {"GET", "items", &VendingApi::handleItems, false, false, low, nullptr, nullptr},
+        {"POST", "insert-money", &VendingApi::handleInsertMoney, false, true, high, nullptr, nullptr},
+        {"POST", "purchase", &VendingApi::handlePurchase, true, true, high, nullptr, nullptr},
+        {"POST", "purchase/batch", &VendingApi::handlePurchaseBatch, true, true, high, nullptr, nullptr},
+        {"POST", "reserve", &VendingApi::handleReserve, false, true, low, nullptr, nullptr},
+        {"POST", "reserve/confirm", &VendingApi::handleConfirmHold, true, true, high, nullptr, nullptr},
+        {"POST", "reserve/cancel", &VendingApi::handleCancelHold, false, false, high, nullptr, nullptr},
+        {"POST", "return-change", &VendingApi::handleReturnChange, false, false, high, nullptr, nullptr},
+        {"GET", "coins", &VendingApi::handleCoins, false, false, low, nullptr, nullptr},
+        {"GET", "history", &VendingApi::handleHistory, false, false, low, nullptr, nullptr},
+    };
+    for (MachineRoute& route : routes) {
+        route.defaultMetrics = &registry.route(route.method, std::string("/api/") + route.action);
+        route.fleetMetrics = &registry.route(route.method, std::string("/api/machines/:id/") + route.action);
+    }
+    machinesGet = &registry.route("GET", "/api/machines");
+    machinesPost = &registry.route("POST", "/api/machines");
+    purchasesSucceeded = &registry.counter("vending_purchases_total", "Purchase requests by outcome.",
+                                           {{"result", "success"}});
+    purchasesFailed = &registry.counter("vending_purchases_total", "Purchase requests by outcome.",
+                                        {{"result", "failure"}});
+    shedLow = &registry.counter("vending_http_shed_total", "Requests refused with 503 by admission control.",
+                                {{"priority", "low"}});
+    shedHigh = &registry.counter("vending_http_shed_total", "Requests refused with 503 by admission control.",
+                                 {{"priority", "high"}});
+    registry.gauge("vending_idempotency_keys", "Idempotency keys remembered.", {},
+                   [this] { return static_cast<double>(idempotency.size()); });
+    registry.gauge("vending_idempotency_bytes", "Approximate memory held by remembered responses.", {},
+                   [this] { return static_cast<double>(idempotency.bytes()); });
+    registry.counter("vending_idempotency_evictions_total", "Idempotency keys evicted to stay within memory.", {},
+                     [this] { return static_cast<double>(idempotency.evictions()); });
+    registry.gauge("vending_http_in_flight", "Requests inside a handler.", {},
+                   [this] { return static_cast<double>(admission.inFlightCount()); });
+    registry.gauge("vending_http_overloaded", "1 while queueing delay has stayed above the admission target.", {},
+                   [this] { return admission.isOverloaded() ? 1.0 : 0.0; });
+}
+
+MetricsRegistry& VendingApi::metrics() {
+    return registry;
+}
+
+void VendingApi::handle(const ApiRequest& request, ApiResponse& response) {
+    response.headers.emplace_back("Access-Control-Allow-Origin", "*");
+    response.headers.emplace_back("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+    response.headers.emplace_back("Access-Control-Allow-Headers", "Content-Type, X-Session-Id, If-None-Match, Idempotency-Key");
+    response.headers.emplace_back("Access-Control-Expose-Headers", "ETag, Retry-After, Idempotent-Replayed");
+    if (request.method() == "OPTIONS") {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    RouteMetrics* timedAs = nullptr;
+    bool purchase = false;
+    dispatch(request, response, timedAs, purchase);
+    if (timedAs) {
+        timedAs->observe(response.status, std::chrono::steady_clock::now() - start);
+    }
+    if (purchase) {
+        (response.status / 100 == 2 ? purchasesSucceeded : purchasesFailed)->add();
+    }
+}
+
+void VendingApi::dispatch(const ApiRequest& request, ApiResponse& response, RouteMetrics*& timedAs,
+                          bool& purchase) {
+    const std::string_view method = request.method();
+    std::string_view path = request.path();
+    if (path == "/metrics" && method == "GET") {
+        response.set(200, registry.render(), "text/plain; version=0.0.4");
+        return;
+    }
+    constexpr std::string_view kApi = "/api/";
+    constexpr std::string_view kMachines = "/api/machines";
+    if (path.substr(0, kMachines.size()) == kMachines) {
+        path.remove_prefix(kMachines.size());
+        if (path.empty() && method == "GET") {
+            timedAs = machinesGet;
+            const auto ticket = admit(AdmissionController::Priority::Low, request, response);
+            if (!ticket) {
+                return;
+            }
+            response.set(200, json({{"count", fleet.size()}}).dump(), "application/json");
+            return;
+        }
+        if (path.empty() && method == "POST") {
+            timedAs = machinesPost;
+            const auto ticket = admit(AdmissionController::Priority::Low, request, response);
+            if (!ticket) {
+                return;
+            }
+            handleCreateMachine(request, response);
+            return;
+        }
+        // /<id>/<action>
+        const std::size_t slash = path.find('/', 1);
+        if (path.size() > 1 && path[0] == '/' && slash != std::string_view::npos) {
+            if (const MachineRoute* route = findRoute(method, path.substr(slash + 1))) {
+                timedAs = route->fleetMetrics;
+                const auto ticket = admit(route->priority, request, response);
+                if (!ticket) {
+                    return;
+                }
+                purchase = route->purchase;
+                const std::string machineId(path.substr(1, slash - 1));
+                auto machine = fleet.handle(machineId);
+                if (!machine) {
+                    response.set(404, "Unknown machine");
+                    return;
+                }
+                runRoute(*route, *machine, machineId, request, response);
+                return;
+            }
+        }
+    } else if (path.substr(0, kApi.size()) == kApi) {
+        if (const MachineRoute* route = findRoute(method, path.substr(kApi.size()))) {
+            timedAs = route->defaultMetrics;
+            const auto ticket = admit(route->priority, request, response);
+            if (!ticket) {
+                return;
+            }
+            purchase = route->purchase;
+            runRoute(*route, defaultMachine, "default", request, response);
+            return;
+        }
+    }
+    response.set(404, "Not Found");
+}
+
+const VendingApi::MachineRoute* VendingApi::findRoute(std::string_view method, std::string_view action) const {
+    for (const MachineRoute& route : routes) {
+        if (action == route.action && method == route.method) {
+            return &route;
+        }
+    }
+    return nullptr;
+}
+
+void VendingApi::runRoute(const MachineRoute& route, MachineHandle machine, const std::string& machineId,
+                          const ApiRequest& request, ApiResponse& response) {
+    const std::string clientKey = route.idempotent ? request.header("Idempotency-Key") : std::string();
+    if (clientKey.empty()) {
+        runHandler(route, machine, request, response);
+        return;
+    }
+    if (clientKey.size() > 255) {
+        response.set(400, "Invalid request: Idempotency-Key longer than 255 characters");
+        return;
+    }
+    // A key only means something to the customer who sent it, on one route
+    // of one machine.
+    const std::string key = machineId + '\n' + route.action + '\n' + sessionIdFor(request) + '\n' + clientKey;
+    std::shared_ptr<const ApiResponse> replay;
+    switch (idempotency.begin(key, std::hash<std::string>()(request.body()), replay)) {
+    case IdempotencyCache::Outcome::Replayed:
+        response.status = replay->status;
+        response.contentType = replay->contentType;
+        response.body = replay->body;
+        response.headers.insert(response.headers.end(), replay->headers.begin(), replay->headers.end());
+        response.headers.emplace_back("Idempotent-Replayed", "true");
+        return;
+    case IdempotencyCache::Outcome::InProgress:
+        response.set(409, "A request with this Idempotency-Key is still in progress");
+        return;
+    case IdempotencyCache::Outcome::Mismatch:
+        response.set(422, "Idempotency-Key was already used for a different request");
+        return;
+    case IdempotencyCache::Outcome::Full:
+        response.headers.emplace_back("Retry-After", "1");
+        response.set(503, "Too many requests with an Idempotency-Key in progress, retry later");
+        return;
+    case IdempotencyCache::Outcome::Started:
+        break;
+    }
+    // Only what the handler adds is stored; every response carries the
+    // headers set before it.
+    const std::size_t commonHeaders = response.headers.size();
+    try {
+        runHandler(route, machine, request, response);
+    } catch (...) {
+        idempotency.abandon(key);
+        throw;
+    }
+    // Only outcomes are stored: a success, or a 409 conflict with the
+    // machine's state. A retry after a rejected request or a server error
+    // runs it again; neither changed anything worth replaying.
+    if ((response.status < 200 || response.status >= 300) && response.status != 409) {
+        idempotency.abandon(key);
+    } else {
+        auto stored = std::make_shared<ApiResponse>();
+        stored->status = response.status;
+        stored->contentType = response.contentType;
+        stored->body = response.body;
+        stored->headers.assign(response.headers.begin() + commonHeaders, response.headers.end());
+        idempotency.complete(key, std::move(stored));
+    }
+}
+
+// A machine whose journal failed holds changes a restart will lose, so it
+// answers nothing until then. Requests running when the journal failed get
+// 500 whatever the handler said: their change may be in memory only.
+void VendingApi::runHandler(const MachineRoute& route, MachineHandle machine, const ApiRequest& request,
+                            ApiResponse& response) {
+    if (machine.machine().halted()) {
+        response.set(503, "Machine halted after a journal failure; restart required");
+        return;
+    }
+    try {
+        (this->*route.handler)(machine, request, response);
+    } catch (const JournalFailure&) {
+    }
+    if (machine.machine().halted()) {
+        response.set(500, "Journal write failed; the change was not saved and is lost on restart");
+    }
+}
+
+AdmissionController::Ticket VendingApi::admit(AdmissionController::Priority priority, const ApiRequest& request,
+                                              ApiResponse& response) {
+    const auto now = std::chrono::steady_clock::now();
+    std::optional<std::chrono::nanoseconds> sojourn;
+    if (const auto since = request.queuedSince()) {
+        sojourn = now - *since;
+    }
+    auto ticket = admission.admit(priority, sojourn, now);
+    if (!ticket) {
+        (priority == AdmissionController::Priority::High ? shedHigh : shedLow)->add();
+        response.headers.emplace_back("Retry-After", std::to_string(admission.retryAfterSeconds()));
+        response.set(503, "Server busy, retry later");
+    }
+    return ticket;
+}
+
+// Customers are told apart by an X-Session-Id header, falling back to a
+// session_id cookie. Requests with neither share the anonymous balance.
+std::string VendingApi::sessionIdFor(const ApiRequest& request) {
+    std::string sessionId = request.header("X-Session-Id");
+    if (!sessionId.empty()) {
+        return sessionId;
+    }
+    const std::string cookies = request.header("Cookie");
+    const std::string key = "session_id=";
+    std::size_t pos = 0;
+    while ((pos = cookies.find(key, pos)) != std::string::npos) {
+        if (pos == 0 || cookies[pos - 1] == ' ' || cookies[pos - 1] == ';') {
+            std::size_t start = pos + key.size();
+            return cookies.substr(start, cookies.find(';', start) - start);
+        }
+        pos += key.size();
+    }
+    return std::string();
+}
+
+void VendingApi::handleItems(MachineHandle handle, const ApiRequest& request, ApiResponse& response) {
+    // Expired holds go back on sale before the catalog is read. That is a
+    // change, so it goes through the actor; the read itself does not (see
+    // MachineHandle::machine()).
+    if (handle.machine().getHoldCount() > 0) {
+        handle.call([](VendingMachine& m) { m.expireHolds(); });
+    }
+    const VendingMachine& machine = handle.machine();
+    std::string etag;
+    std::string body;
+    if (&machine == &defaultMachine.machine()) {
+        auto entry = catalogCache.get();
+        etag = entry->etag;
+        if (request.header("If-None-Match") != etag) {
+            body = entry->body;
+        }
+    } else {
+        etag = "\"" + std::to_string(machine.getCatalogVersion()) + "\"";
+        if (request.header("If-None-Match") != etag) {
+            body = CatalogCache::serialize(machine);
+        }
+    }
+    response.headers.emplace_back("ETag", etag);
+    if (body.empty()) {
+        response.status = 304;
+        return;
+    }
+    response.set(200, std::move(body), "application/json");
+}
+
+void VendingApi::handleInsertMoney(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("amount")) {
+            response.set(400, "Invalid request: missing amount");
+            return;
+        }
+        const Money amount = data["amount"].get<Money>();
+        machine.call([&](VendingMachine& m) { m.insertMoney(sessionIdFor(request), amount); });
+        response.set(200, "Money inserted successfully");
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+void VendingApi::handlePurchase(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("item")) {
+            response.set(400, "Invalid request: missing item");
+            return;
+        }
+        // Names are resolved to SKU ids here, once; everything past this
+        // point is keyed by the id.
+        const std::uint32_t sku = SkuTable::global().find(data["item"].get<std::string>());
+        if (sku != SkuTable::kNone &&
+            machine.call([&](VendingMachine& m) { return m.purchaseItem(sessionIdFor(request), sku); })) {
+            response.set(200, "Purchase successful");
+        } else {
+            response.set(400, "Purchase failed");
+        }
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+// Body: {"items": [{"item": "Coke", "quantity": 2}, ...]}; quantity
+// defaults to 1. The whole cart is bought or none of it.
+void VendingApi::handlePurchaseBatch(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("items") || !data["items"].is_array() || data["items"].empty()) {
+            response.set(400, "Invalid request: missing items");
+            return;
+        }
+        std::vector<CartLine> cart;
+        cart.reserve(data["items"].size());
+        for (const auto& line : data["items"]) {
+            if (!line.contains("item")) {
+                response.set(400, "Invalid request: missing item");
+                return;
+            }
+            int quantity = 0;
+            if (!readCount(line, "quantity", 1, kMaxQuantity, quantity)) {
+                response.set(400, countError("quantity", kMaxQuantity));
+                return;
+            }
+            cart.push_back({line["item"].get<std::string>(), quantity});
+        }
+        if (machine.call([&](VendingMachine& m) { return m.purchaseItems(sessionIdFor(request), cart); })) {
+            response.set(200, "Purchase successful");
+        } else {
+            response.set(400, "Purchase failed");
+        }
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+// Body: {"item": "Coke", "quantity": 1, "ttl": 120}; quantity defaults to
+// 1 and ttl, in seconds, to two minutes. Answers 201 with {"hold": id,
+// "ttl": seconds}, or 409 when the item is short.
+void VendingApi::handleReserve(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    constexpr int kDefaultTtlSeconds = 120;
+    constexpr int kMaxTtlSeconds = 3600;
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("item")) {
+            response.set(400, "Invalid request: missing item");
+            return;
+        }
+        const std::uint32_t sku = SkuTable::global().find(data["item"].get<std::string>());
+        int quantity = 0;
+        int ttl = 0;
+        if (!readCount(data, "quantity", 1, kMaxQuantity, quantity)) {
+            response.set(400, countError("quantity", kMaxQuantity));
+            return;
+        }
+        if (!readCount(data, "ttl", kDefaultTtlSeconds, kMaxTtlSeconds, ttl)) {
+            response.set(400, countError("ttl", kMaxTtlSeconds));
+            return;
+        }
+        const std::uint64_t hold = sku == SkuTable::kNone ? 0 : machine.call([&](VendingMachine& m) {
+            return m.reserveItem(sessionIdFor(request), sku, quantity, std::chrono::seconds(ttl));
+        });
+        if (hold == 0) {
+            response.set(409, "Item unavailable");
+            return;
+        }
+        response.set(201, json({{"hold", hold}, {"ttl", ttl}}).dump(), "application/json");
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+// Body: {"hold": id}. Pays for the held units from the session's balance.
+void VendingApi::handleConfirmHold(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("hold")) {
+            response.set(400, "Invalid request: missing hold");
+            return;
+        }
+        const std::uint64_t hold = data["hold"].get<std::uint64_t>();
+        if (machine.call([&](VendingMachine& m) { return m.confirmHold(sessionIdFor(request), hold); })) {
+            response.set(200, "Purchase successful");
+        } else {
+            response.set(400, "Purchase failed");
+        }
+    } catch (const std::out_of_range& e) {
+        response.set(404, e.what());
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+// Body: {"hold": id}.
+void VendingApi::handleCancelHold(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("hold")) {
+            response.set(400, "Invalid request: missing hold");
+            return;
+        }
+        const std::uint64_t hold = data["hold"].get<std::uint64_t>();
+        if (machine.call([&](VendingMachine& m) { return m.cancelHold(sessionIdFor(request), hold); })) {
+            response.set(200, "Hold cancelled");
+        } else {
+            response.set(404, "Unknown or expired hold");
+        }
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
+
+// Answers {"change": 1.3, "coins": [{"denomination": 1.0, "count": 1}, ...]},
+// or 409 when the machine cannot make the change exactly. Anything else,
+// such as a journal write failing, is a server error.
+void VendingApi::handleReturnChange(MachineHandle machine, const ApiRequest& request, ApiResponse& response) {
+    try {
+        ChangeBreakdown coins;
+        Money change = machine.call([&](VendingMachine& m) { return m.returnChange(sessionIdFor(request), coins); });
+        response.set(200, json({{"change", change}, {"coins", coinsToJson(coins)}}).dump(), "application/json");
+    } catch (const ChangeUnavailable& e) {
+        response.set(409, e.what());
+    } catch (const std::exception& e) {
+        response.set(500, e.what());
+    }
+}
+
+void VendingApi::handleCoins(MachineHandle machine, const ApiRequest&, ApiResponse& response) {
+    response.set(200, coinsToJson(machine.machine().getCoinStock()).dump(), "application/json");
+}
+
+// Pages through the retained history, oldest first.
+void VendingApi::handleHistory(MachineHandle handle, const ApiRequest& request, ApiResponse& response) {
+    const VendingMachine& machine = handle.machine();
+    constexpr std::size_t kMaxLimit = 1000;
+    std::size_t offset = 0;
+    std::size_t limit = 100;
+    try {
+        if (auto value = request.param("offset")) {
+            offset = std::stoull(*value);
+        }
+        if (auto value = request.param("limit")) {
+            limit = std::min<std::size_t>(std::stoull(*value), kMaxLimit);
+        }
+    } catch (const std::exception&) {
+        response.set(400, "Invalid offset or limit");
+        return;
+    }
+    json transactions = json::array();
+    machine.visitTransactions(offset, limit, [&transactions](const TransactionView& t) {
+        transactions.push_back({
+            {"item", t.itemName},
+            {"price", t.price},
+            {"timestamp", t.timestamp}
+        });
+    });
+    json body = {
+        {"offset", offset},
+        {"retained", machine.getRetainedTransactionCount()},
+        {"total", machine.getTransactionCount()},
+        {"transactions", std::move(transactions)}
+    };
+    response.set(200, body.dump(), "application/json");
+}
+
+// Registers a machine stocked with the default catalog.
+void VendingApi::handleCreateMachine(const ApiRequest& request, ApiResponse& response) {
+    try {
+        auto data = json::parse(request.body());
+        if (!data.contains("id") || !data["id"].is_string() || data["id"].get<std::string>().empty()) {
+            response.set(400, "Invalid request: missing id");
+            return;
+        }
+        auto machine = fleet.createMachine();
+        seedDefaultItems(*machine);
+        fleet.addMachine(data["id"].get<std::string>(), std::move(machine));
+        response.set(201, "Machine created");
+    } catch (const FleetFull& e) {
+        response.set(409, e.what());
+    } catch (const std::invalid_argument& e) {
+        response.set(409, e.what());
+    } catch (const std::exception& e) {
+        response.set(400, e.what());
+    }
+}
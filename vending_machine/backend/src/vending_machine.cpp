@@ -3,94 +3,686 @@
 #include <stdexcept>
 #include <cmath>
 #include <algorithm>
+#include <ctime>
+#include <limits>
+#include "snapshot.hpp"
 
-// Valid coin denominations in dollars
-const std::vector<double> VALID_DENOMINATIONS = {0.01, 0.05, 0.10, 0.25, 0.50, 1.00, 2.00, 5.00, 10.00, 20.00};
+namespace {
+
+// Hold expiry resolution.
+constexpr std::chrono::milliseconds kHoldTick(10);
+
+std::uint64_t holdTick(std::chrono::steady_clock::time_point now) {
+    return static_cast<std::uint64_t>(now.time_since_epoch() / kHoldTick);
+}
+
+// Ids come from the wall clock in microseconds, so they are not reused
+// after a restart and stay exact as JSON numbers.
+std::uint64_t firstHoldId() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+}  // namespace
 
 VendingMachine::VendingMachine(std::unique_ptr<IPaymentMethod> paymentMethod,
                              std::unique_ptr<Inventory> inventory,
-                             std::unique_ptr<TransactionLog> transactionLog)
+                             std::unique_ptr<TransactionLog> transactionLog,
+                             std::unique_ptr<Journal> journal,
+                             std::unique_ptr<SessionStore> sessions,
+                             std::unique_ptr<CoinInventory> coins)
     : paymentMethod(std::move(paymentMethod)),
+      sessions(sessions ? std::move(sessions) : std::make_unique<SessionStore>()),
       inventory(std::move(inventory)),
-      transactionLog(std::move(transactionLog)) {}
+      transactionLog(std::move(transactionLog)),
+      journal(std::move(journal)),
+      coins(std::move(coins)),
+      nextHoldId(firstHoldId()),
+      nextHoldCheck(std::numeric_limits<std::uint64_t>::max()) {}
 
-void VendingMachine::insertMoney(double amount) {
-    if (amount <= 0) {
-        throw std::invalid_argument("Amount must be positive");
+VendingMachine::SessionPayment::SessionPayment(const VendingMachine& machine, const std::string& sessionId,
+                                               bool open)
+    : machine(machine), sessionId(sessionId) {
+    // Checked before anything changes, so the journal never sees a name it
+    // would have to refuse.
+    if (open && sessionId.size() > Journal::kMaxNameBytes) {
+        throw std::invalid_argument("Session id too long");
+    }
+    if (!sessionId.empty()) {
+        account = open ? machine.sessions->account(sessionId) : machine.sessions->find(sessionId);
+    }
+}
+
+VendingMachine::SessionPayment::~SessionPayment() {
+    if (account) {
+        // Dropped first, so release() sees no holder but the store.
+        account.reset();
+        machine.sessions->release(sessionId);
+    }
+}
+
+IPaymentMethod& VendingMachine::SessionPayment::method() const {
+    if (account) {
+        return *account;
+    }
+    return *machine.paymentMethod;
+}
+
+CashPayment* VendingMachine::SessionPayment::cash() const {
+    if (!sessionId.empty()) {
+        return account.get();
+    }
+    return dynamic_cast<CashPayment*>(machine.paymentMethod.get());
+}
+
+std::shared_lock<std::shared_mutex> VendingMachine::mutationGuard() const {
+    if (!journal) {
+        return std::shared_lock<std::shared_mutex>();
+    }
+    return std::shared_lock<std::shared_mutex>(stateMtx);
+}
+
+bool VendingMachine::charge(const std::string& sessionId, const SessionPayment& payment, Money price,
+                            CoinDeltas* deltas) {
+    CashPayment* cashPayment = payment.cash();
+    if (coins && cashPayment) {
+        return coins->charge(sessionId, *cashPayment, price, deltas);
+    }
+    return payment.method().processPayment(price);
+}
+
+std::shared_lock<std::shared_mutex> VendingMachine::commitGuard() const {
+    auto guard = mutationGuard();
+    if (halted()) {
+        throw JournalFailure("Journal failed; no changes are accepted until restart");
     }
-    auto cashPayment = dynamic_cast<CashPayment*>(paymentMethod.get());
-    if (cashPayment) {
-        cashPayment->addMoney(amount);
+    return guard;
+}
+
+bool VendingMachine::halted() const {
+    return journal && journal->failed();
+}
+
+std::uint64_t VendingMachine::journalAppend(JournalRecord record) {
+    if (!journal) {
+        return 0;
+    }
+    record.timestamp = std::time(nullptr);
+    return journal->append(std::move(record));
+}
+
+void VendingMachine::waitDurable(std::uint64_t lsn) {
+    if (journal && lsn != 0) {
+        journal->waitDurable(lsn);
+    }
+}
+
+void VendingMachine::commitDurable(std::uint64_t lsn) {
+    if (deferredLsn) {
+        *deferredLsn = std::max(*deferredLsn, lsn);
     } else {
+        waitDurable(lsn);
+    }
+}
+
+thread_local std::uint64_t* VendingMachine::deferredLsn = nullptr;
+
+VendingMachine::DeferDurability::DeferDurability(std::uint64_t& lsn) : previous(deferredLsn) {
+    deferredLsn = &lsn;
+}
+
+VendingMachine::DeferDurability::~DeferDurability() {
+    deferredLsn = previous;
+}
+
+void VendingMachine::insertMoney(Money amount) {
+    insertMoney(std::string(), amount);
+}
+
+void VendingMachine::insertMoney(const std::string& sessionId, Money amount) {
+    if (amount <= Money()) {
+        throw std::invalid_argument("Amount must be positive");
+    }
+    SessionPayment payment(*this, sessionId);
+    CashPayment* cashPayment = payment.cash();
+    if (!cashPayment) {
         throw std::runtime_error("Only cash payments are supported");
     }
+    std::uint64_t lsn = 0;
+    {
+        auto guard = commitGuard();
+        JournalRecord record;
+        if (coins) {
+            coins->deposit(sessionId, *cashPayment, amount, journal ? &record.coins : nullptr);
+        } else {
+            cashPayment->addMoney(amount);
+        }
+        record.type = JournalRecordType::InsertMoney;
+        record.session = sessionId;
+        record.amount = amount;
+        lsn = journalAppend(std::move(record));
+    }
+    commitDurable(lsn);
+}
+
+Money VendingMachine::getBalance() const {
+    return getBalance(std::string());
 }
 
-double VendingMachine::getBalance() const {
-    auto cashPayment = dynamic_cast<CashPayment*>(paymentMethod.get());
-    if (cashPayment) {
+Money VendingMachine::getBalance(const std::string& sessionId) const {
+    // A session that never paid in has no account, and a read opens none.
+    SessionPayment payment(*this, sessionId, false);
+    if (const CashPayment* cashPayment = payment.cash()) {
         return cashPayment->getBalance();
     }
-    return 0.0;
+    return Money();
 }
 
-double VendingMachine::returnChange() {
-    auto cashPayment = dynamic_cast<CashPayment*>(paymentMethod.get());
-    if (cashPayment) {
-        return cashPayment->returnChange();
-    }
-    return 0.0;
+Money VendingMachine::returnChange() {
+    return returnChange(std::string());
+}
+
+Money VendingMachine::returnChange(const std::string& sessionId) {
+    ChangeBreakdown paidOut;
+    return returnChange(sessionId, paidOut);
 }
 
-std::vector<std::unique_ptr<IItem>> VendingMachine::getAvailableItems() const {
-    auto items = inventory->getItems();
-    std::vector<std::unique_ptr<IItem>> result;
-    
-    for (const auto& [name, details] : items) {
-        // Create appropriate item type based on name or other criteria
-        if (name == "Coke" || name == "Pepsi" || name == "Water" || 
-            name == "Sprite" || name == "Fanta" || name == "Mountain Dew") {
-            result.push_back(std::make_unique<Beverage>(name, details.second, details.first, 330));
+Money VendingMachine::returnChange(const std::string& sessionId, ChangeBreakdown& coinsOut) {
+    coinsOut.clear();
+    SessionPayment payment(*this, sessionId, false);
+    CashPayment* cashPayment = payment.cash();
+    if (!cashPayment) {
+        return Money();
+    }
+    Money change;
+    std::uint64_t lsn = 0;
+    {
+        auto guard = commitGuard();
+        JournalRecord record;
+        if (coins) {
+            coinsOut = coins->payOut(sessionId, *cashPayment, change, journal ? &record.coins : nullptr);
         } else {
-            result.push_back(std::make_unique<Snack>(name, details.second, details.first, 50));
+            change = cashPayment->returnChange();
+            const ChangeMaker& maker = ChangeMaker::standard();
+            std::vector<int> counts(maker.denominationCount());
+            maker.split(change.toCents(), counts.data());
+            coinsOut = CoinInventory::breakdown(maker, counts.data());
+        }
+        if (change > Money() || !record.coins.empty()) {
+            record.type = JournalRecordType::ReturnChange;
+            record.session = sessionId;
+            record.amount = change;
+            lsn = journalAppend(std::move(record));
+        }
+    }
+    commitDurable(lsn);
+    return change;
+}
+
+ChangeBreakdown VendingMachine::getCoinStock() const {
+    return coins ? coins->stock() : ChangeBreakdown();
+}
+
+void VendingMachine::refillCoins(Money denomination, int count) {
+    if (!coins) {
+        throw std::runtime_error("This machine does not track coins");
+    }
+    std::uint64_t lsn = 0;
+    {
+        auto guard = commitGuard();
+        JournalRecord record;
+        coins->refill(denomination, count, journal ? &record.coins : nullptr);
+        if (!record.coins.empty()) {
+            record.type = JournalRecordType::RefillCoins;
+            record.amount = denomination;
+            record.quantity = count;
+            lsn = journalAppend(std::move(record));
         }
     }
-    
+    commitDurable(lsn);
+}
+
+std::vector<Item> VendingMachine::getAvailableItems() const {
+    std::vector<Item> result;
+    result.reserve(inventory->size());
+    inventory->visit([&result](const ItemView& item) {
+        result.push_back({std::string(item.name), item.price, item.quantity, item.type, item.attribute, item.id,
+                          item.reserved});
+    });
+    std::sort(result.begin(), result.end(), [](const Item& a, const Item& b) { return a.name < b.name; });
     return result;
 }
 
+Inventory::StockByType VendingMachine::getStockByType() const {
+    return inventory->stockByType();
+}
+
 bool VendingMachine::purchaseItem(const std::string& itemName) {
-    auto items = inventory->getItems();
-    if (items.find(itemName) == items.end()) {
-        return false;
+    return purchaseItem(std::string(), itemName);
+}
+
+bool VendingMachine::purchaseItem(const std::string& sessionId, const std::string& itemName) {
+    const std::uint32_t sku = SkuTable::global().find(itemName);
+    return sku != SkuTable::kNone && purchaseItem(sessionId, sku);
+}
+
+bool VendingMachine::purchaseItem(const std::string& sessionId, std::uint32_t sku) {
+    expireHolds();
+    // Stock decrement and payment happen against the same inventory slot;
+    // a failed payment restocks that slot, so nothing needs refunding here.
+    SessionPayment payment(*this, sessionId);
+    Money price;
+    CoinDeltas coinDeltas;
+    std::uint64_t lsn = 0;
+    bool purchased = false;
+    {
+        auto guard = commitGuard();
+        purchased = inventory->purchaseItem(sku, [this, &sessionId, &payment, &price, &coinDeltas](Money itemPrice) {
+            price = itemPrice;
+            return charge(sessionId, payment, itemPrice, journal ? &coinDeltas : nullptr);
+        });
+        if (purchased) {
+            transactionLog->logTransaction(sku, price);
+            if (journal) {
+                // The journal outlives this process's ids, so it keeps names.
+                JournalRecord record;
+                record.type = JournalRecordType::Purchase;
+                record.item = SkuTable::global().name(sku);
+                record.session = sessionId;
+                record.amount = price;
+                record.quantity = 1;
+                record.coins = std::move(coinDeltas);
+                lsn = journalAppend(std::move(record));
+            }
+        }
+    }
+    commitDurable(lsn);
+    return purchased;
+}
+
+bool VendingMachine::purchaseItems(const std::string& sessionId, const std::vector<CartLine>& cart) {
+    if (cart.empty()) {
+        throw std::invalid_argument("Cart is empty");
+    }
+    for (const auto& line : cart) {
+        if (line.quantity <= 0) {
+            throw std::invalid_argument("Quantity must be positive");
+        }
+    }
+    expireHolds();
+    SessionPayment payment(*this, sessionId);
+    std::vector<Money> unitPrices;
+    CoinDeltas coinDeltas;
+    std::uint64_t lsn = 0;
+    bool purchased = false;
+    {
+        auto guard = commitGuard();
+        purchased = inventory->purchaseItems(cart, unitPrices, [this, &sessionId, &payment, &coinDeltas](Money total) {
+            return charge(sessionId, payment, total, journal ? &coinDeltas : nullptr);
+        });
+        if (purchased) {
+            const std::time_t now = std::time(nullptr);
+            std::vector<Transaction> group;
+            group.reserve(cart.size());
+            for (std::size_t i = 0; i < cart.size(); ++i) {
+                group.push_back({SkuTable::global().find(cart[i].name), unitPrices[i] * cart[i].quantity, now});
+            }
+            transactionLog->logTransactions(group);
+            if (journal) {
+                std::vector<JournalRecord> records(cart.size());
+                for (std::size_t i = 0; i < cart.size(); ++i) {
+                    records[i].type = JournalRecordType::Purchase;
+                    records[i].timestamp = now;
+                    records[i].item = cart[i].name;
+                    records[i].session = sessionId;
+                    records[i].amount = group[i].price;
+                    records[i].quantity = cart[i].quantity;
+                }
+                // The order was charged as a whole.
+                records[0].coins = std::move(coinDeltas);
+                lsn = journal->append(records);
+            }
+        }
+    }
+    commitDurable(lsn);
+    return purchased;
+}
+
+void VendingMachine::addItem(const Item& item) {
+    if (item.name.size() > Journal::kMaxNameBytes) {
+        throw std::invalid_argument("Item name too long");
+    }
+    std::uint64_t lsn = 0;
+    {
+        auto guard = commitGuard();
+        inventory->addItem(item);
+        JournalRecord record;
+        record.type = JournalRecordType::AddItem;
+        record.item = item.name;
+        record.amount = item.price;
+        record.quantity = item.quantity;
+        record.itemType = item.type;
+        record.attribute = item.attribute;
+        lsn = journalAppend(std::move(record));
+    }
+    commitDurable(lsn);
+}
+
+void VendingMachine::refillItem(const std::string& itemName, int quantity) {
+    if (itemName.size() > Journal::kMaxNameBytes) {
+        throw std::invalid_argument("Item name too long");
+    }
+    std::uint64_t lsn = 0;
+    {
+        auto guard = commitGuard();
+        inventory->refillItem(itemName, quantity);
+        JournalRecord record;
+        record.type = JournalRecordType::RefillItem;
+        record.item = itemName;
+        record.quantity = quantity;
+        lsn = journalAppend(std::move(record));
+    }
+    commitDurable(lsn);
+}
+
+std::uint64_t VendingMachine::reserveItem(const std::string& sessionId, const std::string& itemName, int quantity,
+                                          std::chrono::milliseconds ttl, std::chrono::steady_clock::time_point now) {
+    const std::uint32_t sku = SkuTable::global().find(itemName);
+    if (sku == SkuTable::kNone) {
+        if (quantity <= 0) {
+            throw std::invalid_argument("Quantity must be positive");
+        }
+        return 0;
     }
+    return reserveItem(sessionId, sku, quantity, ttl, now);
+}
+
+std::uint64_t VendingMachine::reserveItem(const std::string& sessionId, std::uint32_t sku, int quantity,
+                                          std::chrono::milliseconds ttl, std::chrono::steady_clock::time_point now) {
+    if (quantity <= 0) {
+        throw std::invalid_argument("Quantity must be positive");
+    }
+    const std::uint64_t tick = holdTick(now);
+    std::lock_guard<std::mutex> lock(holdsMtx);
+    if (!holds) {
+        holds = std::make_unique<Holds>(tick);
+    }
+    expireHoldsLocked(tick);
+    {
+        auto guard = mutationGuard();
+        if (!inventory->reserve(sku, quantity)) {
+            return 0;
+        }
+    }
+    const std::uint64_t id = nextHoldId++;
+    Hold& hold = holds->byId[id];
+    hold.id = id;
+    hold.session = sessionId;
+    hold.sku = sku;
+    hold.quantity = quantity;
+    // Rounded up past the current tick, so a hold never expires early.
+    const std::uint64_t ticks = static_cast<std::uint64_t>(std::max<std::int64_t>(0, ttl.count()) +
+                                                            kHoldTick.count() - 1) / kHoldTick.count();
+    holds->wheel.schedule(hold, tick + 1 + ticks);
+    publishHolds();
+    return id;
+}
 
-    double price = items[itemName].second;
-    if (!paymentMethod->processPayment(price)) {
+bool VendingMachine::confirmHold(const std::string& sessionId, std::uint64_t holdId,
+                                 std::chrono::steady_clock::time_point now) {
+    SessionPayment payment(*this, sessionId);
+    std::uint64_t lsn = 0;
+    bool purchased = false;
+    {
+        std::lock_guard<std::mutex> lock(holdsMtx);
+        if (!holds) {
+            throw std::out_of_range("Unknown or expired hold");
+        }
+        expireHoldsLocked(holdTick(now));
+        auto it = holds->byId.find(holdId);
+        if (it == holds->byId.end() || it->second.session != sessionId) {
+            throw std::out_of_range("Unknown or expired hold");
+        }
+        Hold& hold = it->second;
+        Money total;
+        CoinDeltas coinDeltas;
+        auto guard = commitGuard();
+        auto confirm = [this, &sessionId, &payment, &hold, &total, &coinDeltas](Money unitPrice) {
+            total = unitPrice * hold.quantity;
+            return charge(sessionId, payment, total, journal ? &coinDeltas : nullptr);
+        };
+        purchased = inventory->confirmReserved(hold.sku, hold.quantity, confirm);
+        if (purchased) {
+            transactionLog->logTransaction(hold.sku, total);
+            if (journal) {
+                // Replays as a purchase; the reservation itself was never
+                // journaled.
+                JournalRecord record;
+                record.type = JournalRecordType::Purchase;
+                record.item = SkuTable::global().name(hold.sku);
+                record.session = sessionId;
+                record.amount = total;
+                record.quantity = hold.quantity;
+                record.coins = std::move(coinDeltas);
+                lsn = journalAppend(std::move(record));
+            }
+            holds->wheel.cancel(hold);
+            holds->byId.erase(it);
+            publishHolds();
+        }
+    }
+    commitDurable(lsn);
+    return purchased;
+}
+
+bool VendingMachine::cancelHold(const std::string& sessionId, std::uint64_t holdId,
+                                std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(holdsMtx);
+    if (!holds) {
+        return false;
+    }
+    expireHoldsLocked(holdTick(now));
+    auto it = holds->byId.find(holdId);
+    if (it == holds->byId.end() || it->second.session != sessionId) {
         return false;
     }
+    {
+        auto guard = mutationGuard();
+        inventory->release(it->second.sku, it->second.quantity);
+    }
+    holds->wheel.cancel(it->second);
+    holds->byId.erase(it);
+    publishHolds();
+    return true;
+}
 
-    if (inventory->purchaseItem(itemName)) {
-        transactionLog->logTransaction(itemName, price);
-        return true;
+void VendingMachine::expireHolds(std::chrono::steady_clock::time_point now) {
+    const std::uint64_t tick = holdTick(now);
+    if (tick < nextHoldCheck.load(std::memory_order_acquire)) {
+        return;
     }
+    std::lock_guard<std::mutex> lock(holdsMtx);
+    expireHoldsLocked(tick);
+}
 
-    // If purchase failed, refund the money
-    auto cashPayment = dynamic_cast<CashPayment*>(paymentMethod.get());
-    if (cashPayment) {
-        cashPayment->addMoney(price);
+void VendingMachine::expireHoldsLocked(std::uint64_t tick) {
+    // An empty wheel is still advanced, which costs nothing and keeps it
+    // from having to catch up later.
+    if (holds->wheel.size() > 0 && tick < holds->wheel.nextCheck()) {
+        return;
+    }
+    {
+        auto guard = mutationGuard();
+        holds->wheel.advance(tick, [this](TimerWheel::Timer& timer) {
+            Hold& hold = static_cast<Hold&>(timer);
+            inventory->release(hold.sku, hold.quantity);
+            holds->byId.erase(hold.id);
+        });
     }
-    return false;
+    publishHolds();
 }
 
-void VendingMachine::addItem(std::unique_ptr<IItem> item) {
-    inventory->addItem(item->getName(), item->getQuantity(), item->getPrice());
+void VendingMachine::publishHolds() {
+    nextHoldCheck.store(holds->wheel.nextCheck(), std::memory_order_release);
+    holdCount.store(holds->byId.size(), std::memory_order_relaxed);
 }
 
-void VendingMachine::refillItem(const std::string& itemName, int quantity) {
-    inventory->refillItem(itemName, quantity);
+std::size_t VendingMachine::getHoldCount() const {
+    return holdCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t VendingMachine::getCatalogVersion() const {
+    return inventory->getVersion();
+}
+
+Inventory::LockWaits VendingMachine::getInventoryLockWaits() const {
+    return inventory->lockWaits();
+}
+
+void VendingMachine::enableChangeFeed(std::size_t capacity) {
+    inventory->enableChangeFeed(capacity);
+}
+
+bool VendingMachine::drainItemChanges(std::vector<ItemChange>& out) {
+    return inventory->drainChanges(out);
 }
 
 std::vector<Transaction> VendingMachine::getTransactionHistory() const {
     return transactionLog->getHistory();
-} 
\ No newline at end of file
+} 
+
+std::size_t VendingMachine::getRetainedTransactionCount() const {
+    return transactionLog->retainedCount();
+}
+
+std::size_t VendingMachine::getPendingTransactionCount() const {
+    return transactionLog->pendingCount();
+}
+
+std::uint64_t VendingMachine::getTransactionCount() const {
+    return transactionLog->transactionCount();
+}
+
+Money VendingMachine::getTotalRevenue() const {
+    return transactionLog->totalRevenue();
+}
+
+void VendingMachine::checkpoint(const std::string& snapshotPath) {
+    SnapshotState state;
+    {
+        // Mutations apply and journal under the shared side of this lock,
+        // so the captured state matches the journal exactly up to state.lsn.
+        std::unique_lock<std::shared_mutex> lock(stateMtx);
+        state.lsn = journal ? journal->rotate() : 0;
+        state.items.reserve(inventory->size());
+        inventory->visit([&state](const ItemView& item) {
+            // Holds do not survive a restart, so held units are saved as
+            // stock.
+            state.items.push_back({std::string(item.name), item.price, item.quantity + item.reserved, item.type,
+                                   item.attribute});
+        });
+        CoinInventory::State coinState;
+        if (coins) {
+            coinState = coins->state();
+            state.coinStock = std::move(coinState.stock);
+        }
+        auto setAsideFor = [&coinState](const std::string& id) {
+            auto it = coinState.setAside.find(id);
+            return it == coinState.setAside.end() ? std::vector<int>() : std::move(it->second);
+        };
+        if (auto anonymous = dynamic_cast<const CashPayment*>(paymentMethod.get())) {
+            state.sessions.push_back({std::string(), anonymous->getBalance(), setAsideFor(std::string())});
+        }
+        sessions->forEach([&state, &setAsideFor](const std::string& id, const CashPayment& account) {
+            state.sessions.push_back({id, account.getBalance(), setAsideFor(id)});
+        });
+        state.transactionCount = transactionLog->transactionCount();
+        state.revenue = transactionLog->totalRevenue();
+    }
+    Snapshot::write(snapshotPath, state);
+    if (journal) {
+        journal->removeSegmentsThrough(state.lsn);
+    }
+}
+
+bool VendingMachine::recover(const std::string& snapshotPath) {
+    Snapshot snapshot(snapshotPath);
+    inventory->load(snapshot.itemCount(), [&snapshot](std::size_t i) {
+        return snapshot.item(i);
+    });
+    // Coins come back only when the snapshot has them for this machine's
+    // denominations; otherwise the machine keeps its float.
+    const std::size_t denominations = snapshot.coinDenominations();
+    const bool restoreCoins = coins && denominations == coins->changeMaker().denominationCount();
+    CoinInventory::State coinState;
+    if (restoreCoins) {
+        coinState.stock.assign(snapshot.coinStock(), snapshot.coinStock() + denominations);
+    }
+    for (std::size_t i = 0; i < snapshot.sessionCount(); ++i) {
+        Snapshot::SessionView session = snapshot.session(i);
+        adjustBalance(std::string(session.id), session.balance);
+        if (restoreCoins && std::any_of(session.setAside, session.setAside + denominations,
+                                        [](std::int32_t count) { return count != 0; })) {
+            coinState.setAside.emplace(std::string(session.id),
+                                       std::vector<int>(session.setAside, session.setAside + denominations));
+        }
+    }
+    if (restoreCoins) {
+        coins->restore(std::move(coinState));
+    }
+    transactionLog->setBaseline(snapshot.transactionCount(), snapshot.revenue());
+
+    bool restored = !snapshot.empty();
+    if (journal) {
+        const std::uint64_t snapshotLsn = snapshot.lsn();
+        Journal::read(journal->path(), [this, snapshotLsn, &restored](const JournalRecord& record) {
+            if (record.lsn > snapshotLsn) {
+                replay(record);
+                restored = true;
+            }
+        });
+        journal->advancePast(snapshotLsn);
+    }
+    return restored;
+}
+
+void VendingMachine::adjustBalance(const std::string& sessionId, Money delta) {
+    SessionPayment payment(*this, sessionId);
+    if (CashPayment* cashPayment = payment.cash()) {
+        cashPayment->adjustBalance(delta);
+    }
+}
+
+void VendingMachine::replay(const JournalRecord& record) {
+    // Records are re-applied as deltas without the checks the live path made;
+    // those already passed before the record was written.
+    if (coins && !record.coins.empty()) {
+        coins->apply(record.session, record.coins);
+    }
+    switch (record.type) {
+    case JournalRecordType::Purchase:
+        inventory->refillItem(record.item, -record.quantity);
+        adjustBalance(record.session, -record.amount);
+        transactionLog->logTransaction(record.item, record.amount,
+                                       static_cast<std::time_t>(record.timestamp));
+        break;
+    case JournalRecordType::AddItem:
+        inventory->addItem(Item{record.item, record.amount, record.quantity, record.itemType, record.attribute});
+        break;
+    case JournalRecordType::RefillItem:
+        inventory->refillItem(record.item, record.quantity);
+        break;
+    case JournalRecordType::InsertMoney:
+        adjustBalance(record.session, record.amount);
+        break;
+    case JournalRecordType::ReturnChange:
+        adjustBalance(record.session, -record.amount);
+        break;
+    case JournalRecordType::RefillCoins:
+        // Only the coin deltas, applied above.
+        break;
+    case JournalRecordType::Group:
+        // Journal::read() consumes group markers.
+        break;
+    }
+}
@@ -31,6 +31,12 @@ import ShoppingCartIcon from '@mui/icons-material/ShoppingCart';
 
 const API_BASE_URL = 'http://localhost:8080/api';
 
+// Each browser tab is its own customer: the backend keeps a separate balance
+// per session id.
+const SESSION_ID = sessionStorage.getItem('sessionId') || crypto.randomUUID();
+sessionStorage.setItem('sessionId', SESSION_ID);
+axios.defaults.headers.common['X-Session-Id'] = SESSION_ID;
+
 // Enhanced dark theme with better contrast
 const darkTheme = createTheme({
   palette: {
@@ -191,8 +197,31 @@ function App() {
   const [selectedItems, setSelectedItems] = useState([]);
   const [totalPrice, setTotalPrice] = useState(0);
 
+  // The catalog is fetched once on mount, so it loads even where the
+  // stream is missing (crow and epoll front ends) or refused. The stream
+  // starts with a resync event, which re-reads it; after that only stock
+  // deltas ([id, quantity] pairs) arrive.
   useEffect(() => {
     fetchItems();
+    if (typeof EventSource === 'undefined') {
+      return undefined;
+    }
+    const stream = new EventSource(`${API_BASE_URL}/items/stream`);
+    stream.addEventListener('resync', () => fetchItems());
+    stream.addEventListener('delta', (event) => {
+      const stock = new Map(JSON.parse(event.data).items);
+      setItems(prevItems => prevItems.map(item =>
+        stock.has(item.id) ? { ...item, quantity: stock.get(item.id) } : item
+      ));
+    });
+    // A 404 or 503 closes the stream for good; EventSource retries other
+    // failures itself. Either way stock may have moved meanwhile.
+    stream.onerror = () => {
+      if (stream.readyState === EventSource.CLOSED) {
+        fetchItems();
+      }
+    };
+    return () => stream.close();
   }, []);
 
   const fetchItems = async () => {
@@ -276,7 +305,6 @@ function App() {
         }, 7000);
       }, 5000);
       
-      await fetchItems();
       showMessage('Purchase successful', 'success');
     } catch (error) {
       setError(error.response?.data || 'Error purchasing items');